@@ -0,0 +1,430 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "font_cache.h"
+#include "font_lock.h"
+
+#if FONT_RENDER_THREAD_SAFE
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+
+static const char *TAG = "font_cache";
+
+
+#ifndef FONT_CACHE_ALLOC
+#define FONT_CACHE_ALLOC MALLOC_CAP_DEFAULT
+#endif
+
+#ifndef FONT_CACHE_BUDGET
+#define FONT_CACHE_BUDGET 32768
+#endif
+
+// Power of two
+#ifndef FONT_CACHE_BUCKETS
+#define FONT_CACHE_BUCKETS 256
+#endif
+
+
+// Glyphs are packed to single arena of budget size, arena is sequence of
+// used and free blocks starting with block size
+#define FONT_CACHE_ALIGN __alignof__(glyph_cache_record_t)
+#define FONT_CACHE_BLOCK_FREE 0x01
+
+typedef struct font_cache_block {
+	size_t size;
+} font_cache_block_t;
+
+
+static glyph_cache_record_t *cache_buckets[FONT_CACHE_BUCKETS] = {NULL};
+static glyph_cache_record_t *lru_head = NULL; // most recently used
+static glyph_cache_record_t *lru_tail = NULL; // least recently used
+static size_t cache_budget = FONT_CACHE_BUDGET;
+static size_t cache_used = 0;
+static uint8_t *cache_arena = NULL;
+static size_t cache_arena_size = 0;
+static uint32_t cache_clock = 0; // stamps of records, LRU list is sorted by them
+static uint32_t cache_evictions = 0;
+
+
+static inline size_t font_cache_bucket(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode) {
+	uint32_t hash = utf_code * 2654435761u;
+	hash ^= ((uint32_t)pixel_size << 8) ^ ((uint32_t)mode << 4) ^ (uint32_t)((uintptr_t)face >> 3);
+	hash *= 2246822519u;
+	return (hash >> 16) & (FONT_CACHE_BUCKETS - 1);
+}
+
+
+static void font_cache_lru_unlink(glyph_cache_record_t *record) {
+	if (record->lru_prev) {
+		record->lru_prev->lru_next = record->lru_next;
+	}
+	else {
+		lru_head = record->lru_next;
+	}
+	if (record->lru_next) {
+		record->lru_next->lru_prev = record->lru_prev;
+	}
+	else {
+		lru_tail = record->lru_prev;
+	}
+}
+
+
+static void font_cache_lru_push_front(glyph_cache_record_t *record) {
+	record->lru_prev = NULL;
+	record->lru_next = lru_head;
+	if (lru_head) {
+		lru_head->lru_prev = record;
+	}
+	else {
+		lru_tail = record;
+	}
+	lru_head = record;
+}
+
+
+static glyph_cache_record_t **font_cache_hash_link(glyph_cache_record_t *record) {
+	glyph_cache_record_t **link = &cache_buckets[font_cache_bucket(record->face, record->pixel_size, record->utf_code, record->mode)];
+	while (*link != record) {
+		link = &(*link)->hash_next;
+	}
+	return link;
+}
+
+
+static void font_cache_free(glyph_cache_record_t *record) {
+	glyph_cache_record_t **link = font_cache_hash_link(record);
+	*link = record->hash_next;
+	font_cache_lru_unlink(record);
+	cache_used -= record->size;
+	record->size |= FONT_CACHE_BLOCK_FREE;
+}
+
+
+// Evicts least recently used unpinned glyph
+static bool font_cache_evict_one() {
+	glyph_cache_record_t *record = lru_tail;
+	while (record && record->pin_count > 0) {
+		record = record->lru_prev;
+	}
+	if (!record) {
+		return false;
+	}
+	font_cache_free(record);
+	return true;
+}
+
+
+// First fit, adjacent free blocks are merged while searching
+static glyph_cache_record_t *font_cache_alloc(size_t size) {
+	uint8_t *pos = cache_arena;
+	uint8_t *end = cache_arena + cache_arena_size;
+	while (pos < end) {
+		font_cache_block_t *block = (font_cache_block_t *)pos;
+		size_t block_size = block->size & ~FONT_CACHE_BLOCK_FREE;
+		if (block->size & FONT_CACHE_BLOCK_FREE) {
+			while (pos + block_size < end && (((font_cache_block_t *)(pos + block_size))->size & FONT_CACHE_BLOCK_FREE)) {
+				block_size += ((font_cache_block_t *)(pos + block_size))->size & ~FONT_CACHE_BLOCK_FREE;
+			}
+			block->size = block_size | FONT_CACHE_BLOCK_FREE;
+			if (block_size >= size) {
+				if (block_size > size) {
+					((font_cache_block_t *)(pos + size))->size = (block_size - size) | FONT_CACHE_BLOCK_FREE;
+				}
+				block->size = size;
+				return (glyph_cache_record_t *)pos;
+			}
+		}
+		pos += block_size;
+	}
+	return NULL;
+}
+
+
+static void font_cache_move(glyph_cache_record_t *record, uint8_t *target) {
+	glyph_cache_record_t *moved = (glyph_cache_record_t *)target;
+	*font_cache_hash_link(record) = moved;
+	if (record->lru_prev) {
+		record->lru_prev->lru_next = moved;
+	}
+	else {
+		lru_head = moved;
+	}
+	if (record->lru_next) {
+		record->lru_next->lru_prev = moved;
+	}
+	else {
+		lru_tail = moved;
+	}
+	memmove(target, record, record->size);
+}
+
+
+// Slides unpinned glyphs to start of arena, pinned glyphs are referenced by
+// renders and stay in place
+static void font_cache_compact() {
+	uint8_t *pos = cache_arena;
+	uint8_t *write = cache_arena;
+	uint8_t *end = cache_arena + cache_arena_size;
+	while (pos < end) {
+		const size_t block_size = ((font_cache_block_t *)pos)->size & ~FONT_CACHE_BLOCK_FREE;
+		if (!(((font_cache_block_t *)pos)->size & FONT_CACHE_BLOCK_FREE)) {
+			glyph_cache_record_t *record = (glyph_cache_record_t *)pos;
+			if (record->pin_count > 0) {
+				if (write < pos) {
+					((font_cache_block_t *)write)->size = (pos - write) | FONT_CACHE_BLOCK_FREE;
+				}
+				write = pos + block_size;
+			}
+			else {
+				if (write < pos) {
+					font_cache_move(record, write);
+				}
+				write += block_size;
+			}
+		}
+		pos += block_size;
+	}
+	if (write < end) {
+		((font_cache_block_t *)write)->size = (end - write) | FONT_CACHE_BLOCK_FREE;
+	}
+}
+
+
+// Records being written by other task are skipped unless pending is set
+static glyph_cache_record_t *font_cache_lookup(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode, bool pending) {
+	glyph_cache_record_t *record = cache_buckets[font_cache_bucket(face, pixel_size, utf_code, mode)];
+	while (record) {
+		if (record->utf_code == utf_code && record->face == face && record->pixel_size == pixel_size && record->mode == mode && (pending || !record->pending)) {
+			record->last_used = ++cache_clock;
+			if (record != lru_head) {
+				font_cache_lru_unlink(record);
+				font_cache_lru_push_front(record);
+			}
+			return record;
+		}
+		record = record->hash_next;
+	}
+	return NULL;
+}
+
+
+glyph_cache_record_t *font_cache_find(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode) {
+	font_cache_lock();
+	glyph_cache_record_t *record = font_cache_lookup(face, pixel_size, utf_code, mode, false);
+	font_cache_unlock();
+	return record;
+}
+
+
+glyph_cache_record_t *font_cache_find_loading(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode) {
+	font_cache_lock();
+	glyph_cache_record_t *record = font_cache_lookup(face, pixel_size, utf_code, mode, true);
+	font_cache_unlock();
+	return record;
+}
+
+
+void font_cache_wait(const glyph_cache_record_t *record) {
+#if FONT_RENDER_THREAD_SAFE
+	for (;;) {
+		font_cache_lock();
+		const bool pending = record->pending;
+		font_cache_unlock();
+		if (!pending) {
+			return;
+		}
+		vTaskDelay(1);
+	}
+#endif
+}
+
+
+glyph_cache_record_t *font_cache_acquire(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode) {
+	font_cache_lock();
+	glyph_cache_record_t *record = font_cache_lookup(face, pixel_size, utf_code, mode, false);
+	if (record) {
+		record->pin_count++;
+	}
+	font_cache_unlock();
+	return record;
+}
+
+
+static glyph_cache_record_t *font_cache_allocate(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode, size_t bitmap_size) {
+	const size_t size = (sizeof(glyph_cache_record_t) + bitmap_size + FONT_CACHE_ALIGN - 1) & ~(FONT_CACHE_ALIGN - 1);
+
+	if (!cache_arena) {
+		cache_arena_size = cache_budget & ~(FONT_CACHE_ALIGN - 1);
+		cache_arena = (uint8_t *)heap_caps_malloc(cache_arena_size, FONT_CACHE_ALLOC);
+		if (!cache_arena) {
+			ESP_LOGE(TAG, "Glyph cache not allocated");
+			cache_arena_size = 0;
+			return NULL;
+		}
+		((font_cache_block_t *)cache_arena)->size = cache_arena_size | FONT_CACHE_BLOCK_FREE;
+	}
+	if (size > cache_arena_size) {
+		ESP_LOGE(TAG, "Glyph size %d exceeds cache budget", (int)size);
+		return NULL;
+	}
+
+	glyph_cache_record_t *record = font_cache_alloc(size);
+	while (!record) {
+		// Free space may be fragmented, compact it before evicting more
+		if (cache_arena_size - cache_used >= size) {
+			font_cache_compact();
+			record = font_cache_alloc(size);
+			if (record) {
+				break;
+			}
+		}
+		if (!font_cache_evict_one()) {
+			ESP_LOGE(TAG, "Glyph cache full of pinned glyphs");
+			return NULL;
+		}
+		cache_evictions++;
+		record = font_cache_alloc(size);
+	}
+
+	memset(record, 0, sizeof(glyph_cache_record_t));
+	record->size = size;
+	record->face = face;
+	record->pixel_size = pixel_size;
+	record->utf_code = utf_code;
+	record->mode = mode;
+	record->pending = true;
+	record->last_used = ++cache_clock;
+	cache_used += size;
+
+	const size_t bucket = font_cache_bucket(face, pixel_size, utf_code, mode);
+	record->hash_next = cache_buckets[bucket];
+	cache_buckets[bucket] = record;
+	font_cache_lru_push_front(record);
+
+	return record;
+}
+
+
+glyph_cache_record_t *font_cache_insert(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode, size_t bitmap_size) {
+	font_cache_lock();
+	glyph_cache_record_t *record = font_cache_allocate(face, pixel_size, utf_code, mode, bitmap_size);
+	font_cache_unlock();
+	return record;
+}
+
+
+void font_cache_publish(glyph_cache_record_t *record) {
+	font_cache_lock();
+	record->pending = false;
+	font_cache_unlock();
+}
+
+
+void font_cache_pin(glyph_cache_record_t *record) {
+	font_cache_lock();
+	record->pin_count++;
+	font_cache_unlock();
+}
+
+
+void font_cache_unpin(glyph_cache_record_t *record) {
+	font_cache_lock();
+	record->pin_count--;
+	font_cache_unlock();
+}
+
+
+esp_err_t font_cache_remove_face(const font_face_t *face) {
+	font_cache_lock();
+	for (glyph_cache_record_t *record = lru_head; record; record = record->lru_next) {
+		if (record->face == face && record->pin_count > 0) {
+			font_cache_unlock();
+			ESP_LOGE(TAG, "Face not removed, its glyphs are pinned");
+			return ESP_ERR_INVALID_STATE;
+		}
+	}
+	glyph_cache_record_t *record = lru_head;
+	while (record) {
+		glyph_cache_record_t *next = record->lru_next;
+		if (record->face == face) {
+			font_cache_free(record);
+		}
+		record = next;
+	}
+	font_cache_unlock();
+	return ESP_OK;
+}
+
+
+// Tasks loading glyphs use unpinned records, they are evicted only by lock holder
+esp_err_t font_cache_set_budget(size_t budget) {
+	if (font_lock_init() != ESP_OK) {
+		return ESP_ERR_NO_MEM;
+	}
+	font_freetype_lock();
+	font_cache_lock();
+	while (font_cache_evict_one());
+	if (cache_used > 0) {
+		font_cache_unlock();
+		font_freetype_unlock();
+		ESP_LOGE(TAG, "Budget not changed, glyphs are pinned");
+		return ESP_FAIL;
+	}
+	heap_caps_free(cache_arena);
+	cache_arena = NULL;
+	cache_arena_size = 0;
+	cache_budget = budget;
+	font_cache_unlock();
+	font_freetype_unlock();
+	return ESP_OK;
+}
+
+
+uint32_t font_cache_clock(void) {
+	font_cache_lock();
+	const uint32_t clock = cache_clock;
+	font_cache_unlock();
+	return clock;
+}
+
+
+// Records used after since are at front of LRU list
+size_t font_cache_working_set(uint32_t since, size_t *bytes) {
+	size_t count = 0;
+	size_t size = 0;
+	font_cache_lock();
+	for (const glyph_cache_record_t *record = lru_head; record && (int32_t)(record->last_used - since) > 0; record = record->lru_next) {
+		count++;
+		size += record->size;
+	}
+	font_cache_unlock();
+	if (bytes) {
+		*bytes = size;
+	}
+	return count;
+}
+
+
+void font_cache_usage(size_t *used, size_t *budget) {
+	font_cache_lock();
+	*used = cache_used;
+	*budget = cache_budget;
+	font_cache_unlock();
+}
+
+
+uint32_t font_cache_evictions(void) {
+	font_cache_lock();
+	const uint32_t evictions = cache_evictions;
+	font_cache_unlock();
+	return evictions;
+}
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "font_render.h"
+
+
+// Returns cached glyph and marks it as recently used, unpinned glyph may only
+// be used with FreeType lock held, which every insert takes
+glyph_cache_record_t *font_cache_find(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode);
+// Same as font_cache_find, but glyph still written by other task is returned
+// too, loaders call it with FreeType lock held, so they don't insert and
+// compute it again
+glyph_cache_record_t *font_cache_find_loading(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode);
+// Waits until pinned glyph found by font_cache_find_loading is published
+void font_cache_wait(const glyph_cache_record_t *record);
+// Found glyph is pinned before any other task can evict or move it
+glyph_cache_record_t *font_cache_acquire(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode);
+// Allocates new entry for bitmap_size bytes in cache arena, least recently used
+// unpinned entries are evicted to make space, entry is hidden from lookups
+// until font_cache_publish
+glyph_cache_record_t *font_cache_insert(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code, uint8_t mode, size_t bitmap_size);
+void font_cache_publish(glyph_cache_record_t *record);
+void font_cache_pin(glyph_cache_record_t *record);
+void font_cache_unpin(glyph_cache_record_t *record);
+// Drops all glyphs of face, nothing is dropped while any of them is pinned
+esp_err_t font_cache_remove_face(const font_face_t *face);
+// Clock advanced by every lookup and insert
+uint32_t font_cache_clock(void);
+// Number and bytes of glyphs used since clock value
+size_t font_cache_working_set(uint32_t since, size_t *bytes);
+void font_cache_usage(size_t *used, size_t *budget);
+// Glyphs evicted to make space since start
+uint32_t font_cache_evictions(void);
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+
+#include "font_lock.h"
+
+#if FONT_RENDER_THREAD_SAFE
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+
+
+static const char *TAG = "font_lock";
+static SemaphoreHandle_t freetype_mutex = NULL;
+static SemaphoreHandle_t cache_mutex = NULL;
+
+
+esp_err_t font_lock_init(void) {
+	if (!freetype_mutex) {
+		freetype_mutex = xSemaphoreCreateRecursiveMutex();
+	}
+	if (!cache_mutex) {
+		cache_mutex = xSemaphoreCreateMutex();
+	}
+	if (!freetype_mutex || !cache_mutex) {
+		ESP_LOGE(TAG, "Locks not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+
+void font_freetype_lock(void) {
+	xSemaphoreTakeRecursive(freetype_mutex, portMAX_DELAY);
+}
+
+
+void font_freetype_unlock(void) {
+	xSemaphoreGiveRecursive(freetype_mutex);
+}
+
+
+void font_cache_lock(void) {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+}
+
+
+void font_cache_unlock(void) {
+	xSemaphoreGive(cache_mutex);
+}
+
+#endif
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+
+// Renders may be used from several tasks, FreeType face and scratch buffers
+// are guarded by one recursive lock and shared glyph cache by short one
+#ifndef FONT_RENDER_THREAD_SAFE
+#define FONT_RENDER_THREAD_SAFE 1
+#endif
+
+
+#if FONT_RENDER_THREAD_SAFE
+
+// Creates locks, called by face init, cache budget and prefetch start before
+// renders are shared with other tasks, lock functions expect created locks
+esp_err_t font_lock_init(void);
+// Held while FreeType loads, rasterizes or resizes glyphs, may be taken
+// again by same task
+void font_freetype_lock(void);
+void font_freetype_unlock(void);
+// Held only while cache index is searched or modified
+void font_cache_lock(void);
+void font_cache_unlock(void);
+
+#else
+
+static inline esp_err_t font_lock_init(void) { return ESP_OK; }
+static inline void font_freetype_lock(void) {}
+static inline void font_freetype_unlock(void) {}
+static inline void font_cache_lock(void) {}
+static inline void font_cache_unlock(void) {}
+
+#endif
@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_log.h"
+
+#include "font_lock.h"
+#include "font_prefetch.h"
+
+
+#if FONT_RENDER_THREAD_SAFE
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+
+static const char *TAG = "font_prefetch";
+
+
+#ifndef FONT_PREFETCH_QUEUE_LENGTH
+#define FONT_PREFETCH_QUEUE_LENGTH 32
+#endif
+// FreeType loading and rasterization run on worker stack
+#ifndef FONT_PREFETCH_STACK_SIZE
+#define FONT_PREFETCH_STACK_SIZE 8192
+#endif
+#ifndef FONT_PREFETCH_PRIORITY
+#define FONT_PREFETCH_PRIORITY 1
+#endif
+// Slots of glyphs queued by placeholder misses, power of two
+#ifndef FONT_PREFETCH_PENDING_SIZE
+#define FONT_PREFETCH_PENDING_SIZE 64
+#endif
+
+
+// Glyph range with parameters of requesting render, face NULL stops worker
+typedef struct font_prefetch_request {
+	font_face_t *face;
+	font_size_t pixel_size;
+	font_bitmap_format_t format;
+	font_hinting_t hinting;
+	bool size_changed;
+	uint32_t first;
+	uint32_t last;
+	uint32_t epoch;
+} font_prefetch_request_t;
+
+
+// Glyph queued and not yet rendered by worker, face NULL in free slot
+typedef struct font_prefetch_glyph {
+	const font_face_t *face;
+	font_size_t pixel_size;
+	font_bitmap_format_t format;
+	font_hinting_t hinting;
+	uint32_t utf_code;
+} font_prefetch_glyph_t;
+
+
+static QueueHandle_t prefetch_queue = NULL;
+static TaskHandle_t prefetch_task = NULL;
+// Requests older than epoch are dropped, incremented with FreeType lock held
+// when face is destroyed
+static volatile uint32_t prefetch_epoch = 0;
+static uint32_t prefetch_pending = 0;
+// Worker render follows parameters of requests, prepared with FreeType lock
+// held and used by worker alone while it's busy
+static font_render_t prefetch_render;
+static bool prefetch_render_valid = false;
+// Set with FreeType lock held when request passed epoch check, face removal
+// waits until glyph of old epoch is finished
+static bool prefetch_busy = false;
+// Misses of glyph already queued are not queued again, slot is overwritten by
+// colliding glyph, used with cache lock held
+static font_prefetch_glyph_t prefetch_glyphs[FONT_PREFETCH_PENDING_SIZE];
+
+
+static font_prefetch_glyph_t *font_prefetch_glyph_slot(const font_face_t *face, font_size_t pixel_size, uint32_t utf_code) {
+	const uint32_t hash = utf_code * 31 + pixel_size + (uint32_t)((uintptr_t)face >> 4);
+	return &prefetch_glyphs[hash & (FONT_PREFETCH_PENDING_SIZE - 1)];
+}
+
+
+static bool font_prefetch_glyph_equal(const font_prefetch_glyph_t *glyph, const font_prefetch_request_t *request, uint32_t utf_code) {
+	return glyph->face == request->face && glyph->pixel_size == request->pixel_size && glyph->format == request->format && glyph->hinting == request->hinting && glyph->utf_code == utf_code;
+}
+
+
+// Glyph rendered or dropped, next miss queues it again
+static void font_prefetch_glyph_done(const font_prefetch_request_t *request, uint32_t utf_code) {
+	font_cache_lock();
+	font_prefetch_glyph_t *glyph = font_prefetch_glyph_slot(request->face, request->pixel_size, utf_code);
+	if (font_prefetch_glyph_equal(glyph, request, utf_code)) {
+		glyph->face = NULL;
+	}
+	font_cache_unlock();
+}
+
+
+static esp_err_t font_prefetch_prepare(const font_prefetch_request_t *request) {
+	font_render_t *render = &prefetch_render;
+	if (prefetch_render_valid && render->font_face != request->face) {
+		font_render_destroy(render);
+		prefetch_render_valid = false;
+	}
+	if (!prefetch_render_valid) {
+		if (font_render_init(render, request->face, request->pixel_size) != ESP_OK) {
+			return ESP_FAIL;
+		}
+		prefetch_render_valid = true;
+	}
+	else if (font_render_set_pixel_size(render, request->pixel_size) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	render->format = request->format;
+	render->hinting = request->hinting;
+	// Outlines are kept like by requesting render, not after every request
+	render->size_changed = request->size_changed;
+	return ESP_OK;
+}
+
+
+// Lock is held only while render is prepared, font_render_glyph takes it
+// again just for loading, so distance fields are computed without it and
+// strip callbacks wait at most for one rasterization
+static void font_prefetch_range_task(const font_prefetch_request_t *request) {
+	for (uint32_t utf_code = request->first; utf_code <= request->last; ++utf_code) {
+		font_freetype_lock();
+		const bool valid = request->epoch == prefetch_epoch && font_prefetch_prepare(request) == ESP_OK;
+		if (valid) {
+			__atomic_store_n(&prefetch_busy, true, __ATOMIC_RELAXED);
+		}
+		font_freetype_unlock();
+		if (valid) {
+			font_render_glyph(&prefetch_render, utf_code);
+			__atomic_store_n(&prefetch_busy, false, __ATOMIC_RELEASE);
+		}
+		font_prefetch_glyph_done(request, utf_code);
+		if (!valid || utf_code == UINT32_MAX) {
+			break;
+		}
+	}
+}
+
+
+static void font_prefetch_task(void *arg) {
+	font_prefetch_request_t request;
+	while (xQueueReceive(prefetch_queue, &request, portMAX_DELAY) == pdTRUE) {
+		if (!request.face) {
+			break;
+		}
+		font_prefetch_range_task(&request);
+		__atomic_sub_fetch(&prefetch_pending, 1, __ATOMIC_RELEASE);
+	}
+
+	font_freetype_lock();
+	if (prefetch_render_valid) {
+		font_render_destroy(&prefetch_render);
+		prefetch_render_valid = false;
+	}
+	font_freetype_unlock();
+	__atomic_store_n(&prefetch_task, NULL, __ATOMIC_RELEASE);
+	vTaskDelete(NULL);
+}
+
+
+esp_err_t font_prefetch_start(int core_id) {
+	if (prefetch_task) {
+		return ESP_OK;
+	}
+	if (font_lock_init() != ESP_OK) {
+		return ESP_ERR_NO_MEM;
+	}
+	if (!prefetch_queue) {
+		prefetch_queue = xQueueCreate(FONT_PREFETCH_QUEUE_LENGTH, sizeof(font_prefetch_request_t));
+		if (!prefetch_queue) {
+			ESP_LOGE(TAG, "Queue not allocated");
+			return ESP_ERR_NO_MEM;
+		}
+	}
+	TaskHandle_t task = NULL;
+	if (xTaskCreatePinnedToCore(font_prefetch_task, "font_prefetch", FONT_PREFETCH_STACK_SIZE, NULL, FONT_PREFETCH_PRIORITY, &task, core_id) != pdPASS) {
+		ESP_LOGE(TAG, "Task not created");
+		return ESP_ERR_NO_MEM;
+	}
+	prefetch_task = task;
+	return ESP_OK;
+}
+
+
+void font_prefetch_stop(void) {
+	if (!prefetch_task) {
+		return;
+	}
+	const font_prefetch_request_t request = {.face = NULL};
+	xQueueSend(prefetch_queue, &request, portMAX_DELAY);
+	while (__atomic_load_n(&prefetch_task, __ATOMIC_ACQUIRE)) {
+		vTaskDelay(1);
+	}
+}
+
+
+static esp_err_t font_prefetch_send(const font_prefetch_request_t *request) {
+	__atomic_add_fetch(&prefetch_pending, 1, __ATOMIC_RELAXED);
+	if (xQueueSend(prefetch_queue, request, 0) != pdTRUE) {
+		__atomic_sub_fetch(&prefetch_pending, 1, __ATOMIC_RELAXED);
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+
+static void font_prefetch_request_init(font_prefetch_request_t *request, const font_render_t *render, uint32_t first, uint32_t last) {
+	request->face = render->font_face;
+	request->pixel_size = render->pixel_size;
+	request->format = render->format;
+	request->hinting = render->hinting;
+	request->size_changed = render->size_changed;
+	request->first = first;
+	request->last = last;
+	request->epoch = prefetch_epoch;
+}
+
+
+esp_err_t font_prefetch_range(const font_render_t *render, uint32_t first, uint32_t last) {
+	if (!prefetch_task) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	// Prerendered faces have nothing to rasterize
+	if (render->prerendered || first > last) {
+		return ESP_OK;
+	}
+	font_prefetch_request_t request;
+	font_prefetch_request_init(&request, render, first, last);
+	return font_prefetch_send(&request);
+}
+
+
+esp_err_t font_prefetch_miss(const font_render_t *render, uint32_t utf_code) {
+	if (!prefetch_task) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (render->prerendered) {
+		return ESP_OK;
+	}
+	font_prefetch_request_t request;
+	font_prefetch_request_init(&request, render, utf_code, utf_code);
+
+	font_cache_lock();
+	font_prefetch_glyph_t *glyph = font_prefetch_glyph_slot(request.face, request.pixel_size, utf_code);
+	if (font_prefetch_glyph_equal(glyph, &request, utf_code)) {
+		font_cache_unlock();
+		return ESP_OK;
+	}
+	glyph->face = request.face;
+	glyph->pixel_size = request.pixel_size;
+	glyph->format = request.format;
+	glyph->hinting = request.hinting;
+	glyph->utf_code = utf_code;
+	font_cache_unlock();
+
+	const esp_err_t ret = font_prefetch_send(&request);
+	if (ret != ESP_OK) {
+		font_prefetch_glyph_done(&request, utf_code);
+	}
+	return ret;
+}
+
+
+esp_err_t font_prefetch_glyphs(const font_render_t *render, const uint32_t *codes, size_t count) {
+	size_t start = 0;
+	while (start < count) {
+		size_t end = start + 1;
+		while (end < count && codes[end] == codes[end - 1] + 1) {
+			end++;
+		}
+		const esp_err_t ret = font_prefetch_range(render, codes[start], codes[end - 1]);
+		if (ret != ESP_OK) {
+			return ret;
+		}
+		start = end;
+	}
+	return ESP_OK;
+}
+
+
+void font_prefetch_wait(void) {
+	while (__atomic_load_n(&prefetch_pending, __ATOMIC_ACQUIRE) > 0) {
+		vTaskDelay(1);
+	}
+}
+
+
+void font_prefetch_remove_face(const font_face_t *face) {
+	font_freetype_lock();
+	prefetch_epoch++;
+	font_freetype_unlock();
+	// Worker needs FreeType lock to finish glyph it started before epoch change
+	while (__atomic_load_n(&prefetch_busy, __ATOMIC_ACQUIRE)) {
+		vTaskDelay(1);
+	}
+
+	font_freetype_lock();
+	if (prefetch_render_valid && prefetch_render.font_face == face) {
+		font_render_destroy(&prefetch_render);
+		prefetch_render_valid = false;
+	}
+	// Dropped requests don't clear their slots, new face may get same address
+	font_cache_lock();
+	for (size_t i = 0; i < FONT_PREFETCH_PENDING_SIZE; ++i) {
+		if (prefetch_glyphs[i].face == face) {
+			prefetch_glyphs[i].face = NULL;
+		}
+	}
+	font_cache_unlock();
+	font_freetype_unlock();
+}
+
+#else
+
+// Single task build, glyphs are always rendered by caller
+
+esp_err_t font_prefetch_start(int core_id) {
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+
+void font_prefetch_stop(void) {
+}
+
+
+esp_err_t font_prefetch_range(const font_render_t *render, uint32_t first, uint32_t last) {
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+
+esp_err_t font_prefetch_glyphs(const font_render_t *render, const uint32_t *codes, size_t count) {
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+
+esp_err_t font_prefetch_miss(const font_render_t *render, uint32_t utf_code) {
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+
+void font_prefetch_wait(void) {
+}
+
+
+void font_prefetch_remove_face(const font_face_t *face) {
+}
+
+#endif
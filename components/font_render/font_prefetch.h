@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "font_render.h"
+
+
+// Drops worker render of face and requests queued before, called before face
+// is destroyed and without FreeType lock, worker may need it to finish glyph
+void font_prefetch_remove_face(const font_face_t *face);
+// Queues glyph of placeholder miss unless it's already queued, ESP_ERR_NO_MEM
+// when queue is full and glyph has to be requested again by later miss
+esp_err_t font_prefetch_miss(const font_render_t *render, uint32_t utf_code);
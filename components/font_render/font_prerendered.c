@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: MIT
+
+#include "font_prerendered.h"
+#include "font_render.h"
+
+
+static inline const font_prerendered_size_t *font_prerendered_sizes(const uint8_t *data) {
+	return (const font_prerendered_size_t *)(data + sizeof(font_prerendered_header_t));
+}
+
+
+static inline const font_prerendered_glyph_t *font_prerendered_glyphs(const uint8_t *data, const font_prerendered_size_t *size) {
+	return (const font_prerendered_glyph_t *)(data + size->glyphs_offset);
+}
+
+
+// Walks span rows, every run must lie inside data and rows must end at width
+static bool font_prerendered_spans_valid(const uint8_t *bitmap, size_t size, uint16_t width, uint16_t height) {
+	if ((size_t)height * 2 > size) {
+		return false;
+	}
+	for (size_t y = 0; y < height; ++y) {
+		size_t pos = bitmap[y * 2] | (bitmap[y * 2 + 1] << 8);
+		size_t x = 0;
+		while (x < width) {
+			if (pos >= size) {
+				return false;
+			}
+			const uint8_t header = bitmap[pos++];
+			const size_t length = (header & (FONT_SPAN_MAX_LENGTH - 1)) + 1;
+			if ((header >> 6) == FONT_SPAN_PARTIAL) {
+				pos += (length + 3) >> 2;
+			}
+			else if ((header >> 6) != FONT_SPAN_TRANSPARENT && (header >> 6) != FONT_SPAN_SOLID) {
+				return false;
+			}
+			x += length;
+		}
+		if (x != width || pos > size) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static bool font_prerendered_bitmap_valid(const uint8_t *data, size_t size, const font_prerendered_glyph_t *glyph) {
+	if (glyph->bitmap_offset > size) {
+		return false;
+	}
+	const size_t available = size - glyph->bitmap_offset;
+	if (glyph->bitmap_format == FONT_BITMAP_GRAY2_SPANS) {
+		return font_prerendered_spans_valid(data + glyph->bitmap_offset, available, glyph->bitmap_width, glyph->bitmap_height);
+	}
+	const uint8_t bits = font_bitmap_bits(glyph->bitmap_format);
+	if (bits == 0) {
+		return false;
+	}
+	return ((size_t)glyph->bitmap_width * glyph->bitmap_height * bits + 7) >> 3 <= available;
+}
+
+
+bool font_prerendered_valid(const uint8_t *data, size_t size) {
+	const font_prerendered_header_t *header = (const font_prerendered_header_t *)data;
+	if (((uintptr_t)data & (__alignof__(font_prerendered_glyph_t) - 1)) != 0 || size < sizeof(font_prerendered_header_t)) {
+		return false;
+	}
+	if (header->magic != FONT_PRERENDERED_MAGIC || header->version != FONT_PRERENDERED_VERSION) {
+		return false;
+	}
+	if (sizeof(font_prerendered_header_t) + header->size_count * sizeof(font_prerendered_size_t) > size) {
+		return false;
+	}
+
+	const font_prerendered_size_t *sizes = font_prerendered_sizes(data);
+	for (size_t i = 0; i < header->size_count; ++i) {
+		if (sizes[i].glyphs_offset % __alignof__(font_prerendered_glyph_t) != 0 || sizes[i].glyphs_offset > size || (size - sizes[i].glyphs_offset) / sizeof(font_prerendered_glyph_t) < sizes[i].glyph_count) {
+			return false;
+		}
+		const font_prerendered_glyph_t *glyphs = font_prerendered_glyphs(data, &sizes[i]);
+		for (size_t j = 0; j < sizes[i].glyph_count; ++j) {
+			if (!font_prerendered_bitmap_valid(data, size, &glyphs[j])) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+const font_prerendered_size_t *font_prerendered_find_size(const uint8_t *data, uint16_t pixel_size) {
+	const font_prerendered_header_t *header = (const font_prerendered_header_t *)data;
+	const font_prerendered_size_t *sizes = font_prerendered_sizes(data);
+	for (size_t i = 0; i < header->size_count; ++i) {
+		if (sizes[i].pixel_size == pixel_size) {
+			return &sizes[i];
+		}
+	}
+	return NULL;
+}
+
+
+const font_prerendered_glyph_t *font_prerendered_find_glyph(const uint8_t *data, const font_prerendered_size_t *size, uint32_t utf_code) {
+	const font_prerendered_glyph_t *glyphs = font_prerendered_glyphs(data, size);
+	size_t low = 0;
+	size_t high = size->glyph_count;
+	while (low < high) {
+		const size_t middle = (low + high) >> 1;
+		if (glyphs[middle].utf_code < utf_code) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	if (low < size->glyph_count && glyphs[low].utf_code == utf_code) {
+		return &glyphs[low];
+	}
+	return NULL;
+}
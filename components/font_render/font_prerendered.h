@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Glyphs rasterized at build time by host/font_prerender, all values little
+// endian and naturally aligned, offsets are from start of data. Header is
+// followed by size table, glyph tables sorted by code and bitmaps.
+#define FONT_PRERENDERED_MAGIC 0x52504646 // "FFPR"
+#define FONT_PRERENDERED_VERSION 2
+
+// FONT_BITMAP_GRAY2_SPANS bitmaps start with 16 bit row offsets, rows are runs
+// with header (type << 6) | (length - 1), partial runs continue with gray2
+// coverage
+#define FONT_SPAN_TRANSPARENT 0
+#define FONT_SPAN_SOLID 1
+#define FONT_SPAN_PARTIAL 2
+#define FONT_SPAN_MAX_LENGTH 64
+
+typedef struct font_prerendered_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t size_count;
+	uint32_t font_id; // font_id of source font face
+} font_prerendered_header_t;
+
+typedef struct font_prerendered_size {
+	uint16_t pixel_size;
+	uint16_t max_pixel_width;
+	uint16_t max_pixel_height;
+	uint16_t origin;
+	uint32_t glyph_count;
+	uint32_t glyphs_offset;
+} font_prerendered_size_t;
+
+typedef struct font_prerendered_glyph {
+	uint32_t utf_code;
+	uint32_t bitmap_offset;
+	uint16_t bitmap_width;
+	uint16_t bitmap_height;
+	int16_t bitmap_left;
+	int16_t bitmap_top;
+	int16_t advance;
+	uint8_t bitmap_format; // coverage bitmap or FONT_BITMAP_GRAY2_SPANS
+	uint8_t reserved;
+	// Horizontal metrics in 26.6 pixels
+	int32_t width;
+	int32_t height;
+	int32_t hori_bearing_x;
+	int32_t hori_bearing_y;
+	int32_t hori_advance;
+} font_prerendered_glyph_t;
+
+
+// Checks header and that all tables and glyph bitmaps lie inside data
+bool font_prerendered_valid(const uint8_t *data, size_t size);
+const font_prerendered_size_t *font_prerendered_find_size(const uint8_t *data, uint16_t pixel_size);
+// Binary search in glyph table of size
+const font_prerendered_glyph_t *font_prerendered_find_glyph(const uint8_t *data, const font_prerendered_size_t *size, uint32_t utf_code);
@@ -1,60 +1,297 @@
 // SPDX-License-Identifier: MIT
 
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "soc/cpu.h"
 
 #include "font_render.h"
+#include "font_cache.h"
+#include "font_lock.h"
+#include "font_prefetch.h"
+#include "font_prerendered.h"
+
+#include FT_ADVANCES_H
+#include FT_OUTLINE_H
+#include FT_TRUETYPE_TABLES_H
 
 
 static FT_Library ft_library = NULL;
 static const char *TAG = "font_render";
 
 
-#ifndef FONT_CACHE_ALLOC
-#define FONT_CACHE_ALLOC MALLOC_CAP_DEFAULT
+// Shorter uniform runs are merged into partial runs
+#define FONT_SPAN_MIN_UNIFORM 4
+
+// Cache key of glyph bitmaps, unscaled outlines are stored with pixel size 0
+#define FONT_CACHE_MODE(render) ((render)->format | ((render)->hinting << 4))
+#define FONT_CACHE_MODE_OUTLINE 0xff
+
+// Direct mapped advances of one render, printable ASCII never collides
+#ifndef FONT_ADVANCE_TABLE_SIZE
+#define FONT_ADVANCE_TABLE_SIZE 128
 #endif
+#define FONT_ADVANCE_EMPTY UINT32_MAX
+#define FONT_ADVANCE_MISSING INT16_MIN
+
+
+typedef struct font_advance_entry {
+	uint32_t utf_code;
+	int16_t advance;
+} font_advance_entry_t;
 
+// Entries are valid for size and mode they were loaded with
+struct font_advance_table {
+	font_size_t pixel_size;
+	uint8_t mode;
+	font_advance_entry_t entries[FONT_ADVANCE_TABLE_SIZE];
+};
 
-static void font_cache_destroy(font_render_t *render) {
-	if (render->glyph_cache_records) {
-		heap_caps_free(render->glyph_cache_records);
-		render->glyph_cache_records = NULL;
+
+// Length of transparent or solid run starting at x
+static size_t font_uniform_length(const uint8_t *row, size_t x, size_t width) {
+	const uint8_t level = row[x] >> 6;
+	if (level != 0 && level != 3) {
+		return 0;
 	}
-	if (render->glyph_cache) {
-		heap_caps_free(render->glyph_cache);
-		render->glyph_cache = NULL;
+	size_t length = 1;
+	while (x + length < width && length < FONT_SPAN_MAX_LENGTH && (row[x + length] >> 6) == level) {
+		length++;
 	}
+	return length;
 }
 
 
-static esp_err_t font_cache_init(font_render_t *render) {
-	font_cache_destroy(render);
+// Returns encoded size or 0 if spans don't fit to target buffer, without
+// target only size is computed
+static size_t font_encode_spans(const FT_Bitmap *bitmap, uint8_t *target, size_t target_size) {
+	size_t pos = bitmap->rows * 2;
+	if (pos > target_size) {
+		return 0;
+	}
+
+	for (size_t y = 0; y < bitmap->rows; ++y) {
+		const uint8_t *row = bitmap->buffer + y * bitmap->pitch;
+		if (pos > 0xffff) {
+			return 0;
+		}
+		if (target) {
+			target[y * 2] = pos & 0xff;
+			target[y * 2 + 1] = pos >> 8;
+		}
 
-	render->max_pixel_width = (render->pixel_size * (render->font_face->ft_face->bbox.xMax - render->font_face->ft_face->bbox.xMin)) / render->font_face->ft_face->units_per_EM + 1;
-	render->max_pixel_height = (render->pixel_size * (render->font_face->ft_face->bbox.yMax - render->font_face->ft_face->bbox.yMin)) / render->font_face->ft_face->units_per_EM + 1;
-	render->origin = (render->pixel_size * (-render->font_face->ft_face->bbox.yMin)) / render->font_face->ft_face->units_per_EM;
-	render->bytes_per_glyph = (size_t)render->max_pixel_width * (size_t)render->max_pixel_height * 2;
-	render->bytes_per_glyph = (render->bytes_per_glyph >> 3) + (render->bytes_per_glyph & 0x07 ? 1 : 0);
+		size_t x = 0;
+		while (x < bitmap->width) {
+			size_t length = font_uniform_length(row, x, bitmap->width);
+			if (length >= FONT_SPAN_MIN_UNIFORM) {
+				if (pos + 1 > target_size) {
+					return 0;
+				}
+				if (target) {
+					target[pos] = (((row[x] >> 6) ? FONT_SPAN_SOLID : FONT_SPAN_TRANSPARENT) << 6) | (length - 1);
+				}
+				pos++;
+			}
+			else {
+				length = 1;
+				while (x + length < bitmap->width && length < FONT_SPAN_MAX_LENGTH && font_uniform_length(row, x + length, bitmap->width) < FONT_SPAN_MIN_UNIFORM) {
+					length++;
+				}
+				const size_t coverage_size = (length + 3) >> 2;
+				if (pos + 1 + coverage_size > target_size) {
+					return 0;
+				}
+				if (target) {
+					target[pos] = (FONT_SPAN_PARTIAL << 6) | (length - 1);
+					memset(target + pos + 1, 0, coverage_size);
+					for (size_t i = 0; i < length; ++i) {
+						target[pos + 1 + (i >> 2)] |= (row[x + i] >> 6) << ((i & 0x03) << 1);
+					}
+				}
+				pos += 1 + coverage_size;
+			}
+			x += length;
+		}
+	}
+
+	return pos;
+}
+
+
+static size_t font_coverage_size(size_t width, size_t height, uint8_t bits) {
+	return (width * height * bits + 7) >> 3;
+}
 
-	render->glyph_cache = (uint8_t *)heap_caps_malloc(render->bytes_per_glyph * render->cache_size, FONT_CACHE_ALLOC);
-	render->glyph_cache_records = (glyph_cache_record_t *)heap_caps_malloc(sizeof(glyph_cache_record_t) * render->cache_size, FONT_CACHE_ALLOC);
 
-	if (!render->glyph_cache || !render->glyph_cache_records) {
-		ESP_LOGE(TAG, "Glyph cache not allocated");
-		if (render->glyph_cache_records) {
-			heap_caps_free(render->glyph_cache_records);
-			render->glyph_cache_records = NULL;
+// Pixels are packed continuously across rows from least significant bits
+static void font_encode_coverage(const FT_Bitmap *bitmap, uint8_t *target, uint8_t bits) {
+	memset(target, 0, font_coverage_size(bitmap->width, bitmap->rows, bits));
+	const size_t pixels_per_byte = 8 / bits;
+	size_t pos = 0;
+	for (size_t y = 0; y < bitmap->rows; ++y) {
+		for (size_t x = 0; x < bitmap->width; ++x) {
+			uint8_t color = bitmap->buffer[y * bitmap->pitch + x];
+			target[pos / pixels_per_byte] |= ((color >> (8 - bits)) << ((pos % pixels_per_byte) * bits));
+			pos++;
 		}
-		if (render->glyph_cache) {
-			heap_caps_free(render->glyph_cache);
-			render->glyph_cache = NULL;
+	}
+}
+
+
+// Outline flattened to line segments in distance field coordinates
+typedef struct font_sdf_outline {
+	float *segments; // x0, y0, x1, y1, only counted when NULL
+	size_t count;
+	float origin_x;
+	float origin_y;
+	float x;
+	float y;
+	glyph_cache_record_t *record; // pending record of field, written after FreeType lock is released
+} font_sdf_outline_t;
+
+#define FONT_SDF_CURVE_STEPS 6
+
+
+static void font_sdf_line(font_sdf_outline_t *outline, float x, float y) {
+	if (outline->segments) {
+		float *segment = outline->segments + outline->count * 4;
+		segment[0] = outline->x;
+		segment[1] = outline->y;
+		segment[2] = x;
+		segment[3] = y;
+	}
+	outline->count++;
+	outline->x = x;
+	outline->y = y;
+}
+
+
+static int font_sdf_move_to(const FT_Vector *to, void *user) {
+	font_sdf_outline_t *outline = (font_sdf_outline_t *)user;
+	outline->x = to->x / 64.0f - outline->origin_x;
+	outline->y = outline->origin_y - to->y / 64.0f;
+	return 0;
+}
+
+
+static int font_sdf_line_to(const FT_Vector *to, void *user) {
+	font_sdf_outline_t *outline = (font_sdf_outline_t *)user;
+	font_sdf_line(outline, to->x / 64.0f - outline->origin_x, outline->origin_y - to->y / 64.0f);
+	return 0;
+}
+
+
+static int font_sdf_conic_to(const FT_Vector *control, const FT_Vector *to, void *user) {
+	font_sdf_outline_t *outline = (font_sdf_outline_t *)user;
+	const float x0 = outline->x;
+	const float y0 = outline->y;
+	const float x1 = control->x / 64.0f - outline->origin_x;
+	const float y1 = outline->origin_y - control->y / 64.0f;
+	const float x2 = to->x / 64.0f - outline->origin_x;
+	const float y2 = outline->origin_y - to->y / 64.0f;
+	for (int i = 1; i <= FONT_SDF_CURVE_STEPS; ++i) {
+		const float t = (float)i / FONT_SDF_CURVE_STEPS;
+		const float u = 1.0f - t;
+		font_sdf_line(outline, u * u * x0 + 2 * u * t * x1 + t * t * x2, u * u * y0 + 2 * u * t * y1 + t * t * y2);
+	}
+	return 0;
+}
+
+
+static int font_sdf_cubic_to(const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user) {
+	font_sdf_outline_t *outline = (font_sdf_outline_t *)user;
+	const float x0 = outline->x;
+	const float y0 = outline->y;
+	const float x1 = control1->x / 64.0f - outline->origin_x;
+	const float y1 = outline->origin_y - control1->y / 64.0f;
+	const float x2 = control2->x / 64.0f - outline->origin_x;
+	const float y2 = outline->origin_y - control2->y / 64.0f;
+	const float x3 = to->x / 64.0f - outline->origin_x;
+	const float y3 = outline->origin_y - to->y / 64.0f;
+	for (int i = 1; i <= FONT_SDF_CURVE_STEPS; ++i) {
+		const float t = (float)i / FONT_SDF_CURVE_STEPS;
+		const float u = 1.0f - t;
+		font_sdf_line(outline, u * u * u * x0 + 3 * u * u * t * x1 + 3 * u * t * t * x2 + t * t * t * x3, u * u * u * y0 + 3 * u * u * t * y1 + 3 * u * t * t * y2 + t * t * t * y3);
+	}
+	return 0;
+}
+
+
+static const FT_Outline_Funcs font_sdf_outline_funcs = {
+	.move_to = font_sdf_move_to,
+	.line_to = font_sdf_line_to,
+	.conic_to = font_sdf_conic_to,
+	.cubic_to = font_sdf_cubic_to,
+	.shift = 0,
+	.delta = 0,
+};
+
+
+// Distance field of flattened outline, 128 is the outline and FONT_SDF_SPREAD
+// pixels map to 127 steps, inside uses nonzero winding like rasterizer
+static void font_encode_sdf(const font_sdf_outline_t *outline, uint8_t *target, int width, int height) {
+	const float limit = (FONT_SDF_SPREAD + 1) * (FONT_SDF_SPREAD + 1);
+	for (int y = 0; y < height; ++y) {
+		const float center_y = y + 0.5f;
+		for (int x = 0; x < width; ++x) {
+			const float center_x = x + 0.5f;
+			float nearest = limit;
+			int winding = 0;
+			for (size_t i = 0; i < outline->count; ++i) {
+				const float *segment = outline->segments + i * 4;
+				const float dx = segment[2] - segment[0];
+				const float dy = segment[3] - segment[1];
+				const float length = dx * dx + dy * dy;
+				float t = length > 0.0f ? ((center_x - segment[0]) * dx + (center_y - segment[1]) * dy) / length : 0.0f;
+				t = MAX(MIN(t, 1.0f), 0.0f);
+				const float ex = segment[0] + t * dx - center_x;
+				const float ey = segment[1] + t * dy - center_y;
+				nearest = MIN(nearest, ex * ex + ey * ey);
+
+				// Crossings of ray to the right of pixel center
+				if ((segment[1] <= center_y) != (segment[3] <= center_y)) {
+					if (segment[0] + (center_y - segment[1]) * dx / dy > center_x) {
+						winding += dy > 0.0f ? 1 : -1;
+					}
+				}
+			}
+			float distance = sqrtf(nearest);
+			if (winding == 0) {
+				distance = -distance;
+			}
+			const int value = 128 + (int)lroundf(distance * 127.0f / FONT_SDF_SPREAD);
+			target[y * width + x] = MAX(MIN(value, 255), 0);
 		}
-		return ESP_FAIL;
 	}
+}
 
-	memset(render->glyph_cache_records, 0, sizeof(glyph_cache_record_t) * render->cache_size);
 
-	return ESP_OK;
+static void font_render_update_size(font_render_t *render) {
+	const FT_Face ft_face = render->font_face->ft_face;
+	render->max_pixel_width = (render->pixel_size * (ft_face->bbox.xMax - ft_face->bbox.xMin)) / ft_face->units_per_EM + 1;
+	render->max_pixel_height = (render->pixel_size * (ft_face->bbox.yMax - ft_face->bbox.yMin)) / ft_face->units_per_EM + 1;
+	render->origin = (render->pixel_size * (-ft_face->bbox.yMin)) / ft_face->units_per_EM;
+	render->sdf_scale = ((uint32_t)render->pixel_size << 16) / FONT_SDF_PIXEL_SIZE;
+}
+
+
+// Checksum adjustment of head table covers whole sfnt file, other fonts are
+// hashed
+static uint32_t font_face_checksum(FT_Face ft_face, const font_data_t *data, font_data_size_t size) {
+	const TT_Header *head = (const TT_Header *)FT_Get_Sfnt_Table(ft_face, FT_SFNT_HEAD);
+	if (head) {
+		return head->CheckSum_Adjust;
+	}
+	uint32_t hash = 2166136261u;
+	for (font_data_size_t i = 0; i < size; ++i) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
 }
 
 
@@ -62,164 +299,974 @@ esp_err_t font_face_init(font_face_t *face, const font_data_t *data, font_data_s
 	FT_Error err;
 
 	face->pixel_size = 0;
+	face->prerendered = NULL;
 
+	if (font_lock_init() != ESP_OK) {
+		return ESP_ERR_NO_MEM;
+	}
+	font_freetype_lock();
 	if (ft_library == NULL) {
 		err = FT_Init_FreeType(&ft_library);
 		if (err) {
+			font_freetype_unlock();
 			ESP_LOGE(TAG, "Freetype not loaded: %d", err);
 			return ESP_FAIL;
 		}
 	}
 
 	err = FT_New_Memory_Face(ft_library, data, size, 0, &face->ft_face);
+	font_freetype_unlock();
 	if (err) {
 		ESP_LOGE(TAG, "New face failed: %d", err);
 		return ESP_FAIL;
 	}
+	face->ft_size = face->ft_face->size;
+	face->font_id = font_face_checksum(face->ft_face, data, size);
 
 	return ESP_OK;
 }
 
-void font_face_destroy(font_face_t *face) {
+esp_err_t font_face_init_prerendered(font_face_t *face, const uint8_t *data, size_t size) {
+	face->ft_face = NULL;
+	face->ft_size = NULL;
+	face->pixel_size = 0;
+	face->prerendered = NULL;
+
+	if (!font_prerendered_valid(data, size)) {
+		ESP_LOGE(TAG, "Invalid prerendered font");
+		return ESP_FAIL;
+	}
+	face->prerendered = data;
+	face->font_id = ((const font_prerendered_header_t *)data)->font_id;
+
+	return ESP_OK;
+}
+
+esp_err_t font_face_destroy(font_face_t *face) {
+	if (face->prerendered) {
+		face->prerendered = NULL;
+		return ESP_OK;
+	}
+	// Worker drops its render and requests queued for face
+	font_prefetch_remove_face(face);
+	font_freetype_lock();
+	// Sizes of renders are freed with face, renders must be gone already
+	if (font_cache_remove_face(face) != ESP_OK) {
+		font_freetype_unlock();
+		return ESP_ERR_INVALID_STATE;
+	}
 	FT_Done_Face(face->ft_face);
+	font_freetype_unlock();
+	return ESP_OK;
 }
 
 
-esp_err_t font_face_set_pixel_size(font_face_t *face, font_size_t pixel_size) {
+static esp_err_t font_face_activate_pixel_size(font_face_t *face, font_size_t pixel_size) {
+	if (face->ft_face->size != face->ft_size) {
+		FT_Activate_Size(face->ft_size);
+	}
 	if (face->pixel_size != pixel_size) {
 		FT_Error err = FT_Set_Pixel_Sizes(face->ft_face, 0, pixel_size);
 		if (err) {
 			ESP_LOGE(TAG, "Set font size failed: %d", err);
 			return ESP_FAIL;
 		}
+		face->pixel_size = pixel_size;
 	}
 	return ESP_OK;
 }
 
 
-esp_err_t font_render_init(font_render_t *render, font_face_t *face, font_size_t pixel_size, uint16_t cache_size) {
+esp_err_t font_face_set_pixel_size(font_face_t *face, font_size_t pixel_size) {
+	if (face->prerendered) {
+		ESP_LOGE(TAG, "Prerendered face has no outlines");
+		return ESP_FAIL;
+	}
+	font_freetype_lock();
+	const esp_err_t ret = font_face_activate_pixel_size(face, pixel_size);
+	font_freetype_unlock();
+	return ret;
+}
+
+
+// Switching between renders only swaps active size of face
+static inline esp_err_t font_render_activate_size(font_render_t *render) {
+	if (render->font_face->ft_face->size != render->ft_size) {
+		FT_Error err = FT_Activate_Size(render->ft_size);
+		if (err) {
+			ESP_LOGE(TAG, "Activate font size failed: %d", err);
+			return ESP_FAIL;
+		}
+	}
+	return ESP_OK;
+}
+
+
+// Size table entry replaces FT_Size, prerendered renders never call FreeType
+static esp_err_t font_render_set_prerendered_size(font_render_t *render, font_size_t pixel_size) {
+	const font_prerendered_size_t *size = font_prerendered_find_size(render->font_face->prerendered, pixel_size);
+	if (!size) {
+		ESP_LOGE(TAG, "Size %d not prerendered", pixel_size);
+		return ESP_FAIL;
+	}
+	render->prerendered = size;
+	render->pixel_size = pixel_size;
+	render->max_pixel_width = size->max_pixel_width;
+	render->max_pixel_height = size->max_pixel_height;
+	render->origin = size->origin;
+	render->sdf_scale = ((uint32_t)pixel_size << 16) / FONT_SDF_PIXEL_SIZE;
+	return ESP_OK;
+}
+
+
+esp_err_t font_render_init(font_render_t *render, font_face_t *face, font_size_t pixel_size) {
+	// Pinned glyph, size and advance table of earlier init are released
+	font_render_destroy(render);
 	render->font_face = face;
-	render->glyph_cache = NULL;
-	render->glyph_cache_records = NULL;
 	render->pixel_size = pixel_size;
-	render->cache_size = cache_size;
+	render->format = FONT_BITMAP_GRAY2_SPANS;
+	render->hinting = FONT_HINTING_DEFAULT;
+	render->prerendered = NULL;
+	render->size_changed = false;
+	render->miss_policy = FONT_MISS_RENDER;
+	memset(&render->stats, 0, sizeof(render->stats));
+	render->stats_window = 0;
 
-	if (font_face_set_pixel_size(face, pixel_size) != ESP_OK) {
-		return ESP_FAIL;
+	if (face->prerendered) {
+		return font_render_set_prerendered_size(render, pixel_size);
 	}
 
-	if (font_cache_init(render) != ESP_OK) {
+	font_freetype_lock();
+	FT_Error err = FT_New_Size(face->ft_face, &render->ft_size);
+	if (err) {
+		font_freetype_unlock();
+		ESP_LOGE(TAG, "New font size failed: %d", err);
+		return ESP_FAIL;
+	}
+	if (font_render_activate_size(render) != ESP_OK) {
+		font_render_destroy(render);
+		font_freetype_unlock();
+		return ESP_FAIL;
+	}
+	err = FT_Set_Pixel_Sizes(face->ft_face, 0, pixel_size);
+	if (err) {
+		ESP_LOGE(TAG, "Set font size failed: %d", err);
+		font_render_destroy(render);
+		font_freetype_unlock();
 		return ESP_FAIL;
 	}
 
+	font_render_update_size(render);
+	font_freetype_unlock();
+
 	return ESP_OK;
 }
 
 
 void font_render_destroy(font_render_t *render) {
-	font_cache_destroy(render);
+	heap_caps_free(render->advances);
+	render->advances = NULL;
+	if (render->glyph) {
+		font_cache_unpin(render->glyph);
+		render->glyph = NULL;
+	}
+	if (render->ft_size) {
+		font_freetype_lock();
+		FT_Done_Size(render->ft_size);
+		font_freetype_unlock();
+		render->ft_size = NULL;
+	}
+}
+
+
+esp_err_t font_render_set_pixel_size(font_render_t *render, font_size_t pixel_size) {
+	if (render->pixel_size == pixel_size) {
+		return ESP_OK;
+	}
+	if (render->prerendered) {
+		return font_render_set_prerendered_size(render, pixel_size);
+	}
+	font_freetype_lock();
+	if (font_render_activate_size(render) != ESP_OK) {
+		font_freetype_unlock();
+		return ESP_FAIL;
+	}
+	FT_Error err = FT_Set_Pixel_Sizes(render->font_face->ft_face, 0, pixel_size);
+	font_freetype_unlock();
+	if (err) {
+		ESP_LOGE(TAG, "Set font size failed: %d", err);
+		return ESP_FAIL;
+	}
+	render->pixel_size = pixel_size;
+	render->size_changed = true;
+	font_render_update_size(render);
+	return ESP_OK;
+}
+
+
+static void font_prerendered_metrics(const font_prerendered_glyph_t *glyph, FT_Glyph_Metrics *metrics) {
+	*metrics = (FT_Glyph_Metrics){
+		.width = glyph->width,
+		.height = glyph->height,
+		.horiBearingX = glyph->hori_bearing_x,
+		.horiBearingY = glyph->hori_bearing_y,
+		.horiAdvance = glyph->hori_advance,
+	};
 }
 
 
 esp_err_t font_load_glyph_metrics(font_render_t *render, uint32_t utf_code) {
-	if (font_face_set_pixel_size(render->font_face, render->pixel_size) != ESP_OK) {
+	if (render->prerendered) {
+		const font_prerendered_glyph_t *glyph = font_prerendered_find_glyph(render->font_face->prerendered, render->prerendered, utf_code);
+		if (!glyph) {
+			return ESP_FAIL;
+		}
+		font_prerendered_metrics(glyph, &render->metrics);
+		return ESP_OK;
+	}
+
+	font_freetype_lock();
+	if (font_render_activate_size(render) != ESP_OK) {
+		font_freetype_unlock();
 		return ESP_FAIL;
 	}
 
 	FT_UInt glyph_index = FT_Get_Char_Index(render->font_face->ft_face, utf_code);
 	if (glyph_index == 0) {
+		font_freetype_unlock();
 		return ESP_FAIL;
 	}
 
-	FT_Error err;
-	err = FT_Load_Glyph(render->font_face->ft_face, glyph_index,  FT_LOAD_DEFAULT);
+	const uint32_t start = esp_cpu_get_ccount();
+	FT_Error err = FT_Load_Glyph(render->font_face->ft_face, glyph_index,  FT_LOAD_DEFAULT);
+	render->stats.load_cycles += esp_cpu_get_ccount() - start;
 	if (err) {
+		font_freetype_unlock();
 		return ESP_FAIL;
 	}
 
 	render->metrics = render->font_face->ft_face->glyph->metrics;
+	font_freetype_unlock();
 
 	return ESP_OK;
 }
 
 
-esp_err_t font_render_glyph(font_render_t *render, uint32_t utf_code) {
-	// Search cache entry
-	int found_cache = -1;
-	for (size_t i = 0; i < render->cache_size; ++i) {
-		if (render->glyph_cache_records[i].utf_code == utf_code) {
-			found_cache = i;
-			break;
-		}
+static void font_pack_metrics(const FT_Glyph_Metrics *metrics, font_glyph_metrics_t *target) {
+	target->width = metrics->width;
+	target->height = metrics->height;
+	target->bearing_x = metrics->horiBearingX;
+	target->bearing_y = metrics->horiBearingY;
+	target->advance = metrics->horiAdvance;
+}
+
+
+// Scales are 16.16 like scales of FT_Size_Metrics, vertical metrics are not
+// cached
+static void font_unpack_metrics(const font_glyph_metrics_t *metrics, FT_Fixed x_scale, FT_Fixed y_scale, FT_Glyph_Metrics *target) {
+	*target = (FT_Glyph_Metrics){
+		.width = FT_MulFix(metrics->width, x_scale),
+		.height = FT_MulFix(metrics->height, y_scale),
+		.horiBearingX = FT_MulFix(metrics->bearing_x, x_scale),
+		.horiBearingY = FT_MulFix(metrics->bearing_y, y_scale),
+		.horiAdvance = FT_MulFix(metrics->advance, x_scale),
+	};
+}
+
+
+// Advance of glyph slot loaded in same way as by font_render_glyph
+static esp_err_t font_load_advance(font_render_t *render, uint32_t utf_code, int *advance) {
+	const FT_Face ft_face = render->font_face->ft_face;
+	FT_UInt glyph_index = FT_Get_Char_Index(ft_face, utf_code);
+	if (glyph_index == 0) {
+		return ESP_FAIL;
 	}
 
-	if (found_cache == -1) {
-		if (font_face_set_pixel_size(render->font_face, render->pixel_size) != ESP_OK) {
+	FT_Fixed value;
+	if (render->format == FONT_BITMAP_SDF) {
+		// Field is loaded unhinted at its own size and scaled
+		if (font_face_activate_pixel_size(render->font_face, FONT_SDF_PIXEL_SIZE) != ESP_OK || FT_Get_Advance(ft_face, glyph_index, FT_LOAD_NO_HINTING, &value)) {
+			return ESP_FAIL;
+		}
+		*advance = ((value >> 16) * (int32_t)render->sdf_scale + 0x8000) >> 16;
+	}
+	else if (render->format == FONT_BITMAP_OUTLINE || render->hinting == FONT_HINTING_NONE) {
+		// Only hmtx is read, scaled like cached outline
+		if (FT_Get_Advance(ft_face, glyph_index, FT_LOAD_NO_SCALE, &value)) {
+			return ESP_FAIL;
+		}
+		*advance = FT_MulFix(value, render->ft_size->metrics.x_scale) >> 6;
+	}
+	else {
+		// Hinting can change advance, without hdmx FreeType loads and hints
+		// whole glyph, it's done once per table entry
+		if (font_render_activate_size(render) != ESP_OK || FT_Get_Advance(ft_face, glyph_index, FT_LOAD_DEFAULT, &value)) {
 			return ESP_FAIL;
 		}
+		*advance = value >> 16;
+	}
+	return ESP_OK;
+}
 
-		FT_UInt glyph_index = FT_Get_Char_Index(render->font_face->ft_face, utf_code);
-		if (glyph_index == 0) {
+
+esp_err_t font_render_glyph_advance(font_render_t *render, uint32_t utf_code, int *advance) {
+	if (render->prerendered) {
+		const font_prerendered_glyph_t *glyph = font_prerendered_find_glyph(render->font_face->prerendered, render->prerendered, utf_code);
+		if (!glyph) {
 			return ESP_FAIL;
 		}
+		*advance = glyph->advance;
+		return ESP_OK;
+	}
 
-		FT_Error err;
-		err = FT_Load_Glyph(render->font_face->ft_face, glyph_index,  FT_LOAD_DEFAULT);
-		if (err) {
+	struct font_advance_table *table = render->advances;
+	if (!table) {
+		table = (struct font_advance_table *)heap_caps_malloc(sizeof(*table), MALLOC_CAP_DEFAULT);
+		if (!table) {
+			ESP_LOGE(TAG, "Advance table not allocated");
 			return ESP_FAIL;
 		}
+		render->advances = table;
+		table->pixel_size = 0;
+	}
+	if (table->pixel_size != render->pixel_size || table->mode != FONT_CACHE_MODE(render)) {
+		for (size_t i = 0; i < FONT_ADVANCE_TABLE_SIZE; ++i) {
+			table->entries[i].utf_code = FONT_ADVANCE_EMPTY;
+		}
+		table->pixel_size = render->pixel_size;
+		table->mode = FONT_CACHE_MODE(render);
+	}
+
+	font_advance_entry_t *entry = &table->entries[utf_code & (FONT_ADVANCE_TABLE_SIZE - 1)];
+	if (entry->utf_code != utf_code) {
+		font_freetype_lock();
+		entry->utf_code = utf_code;
+		entry->advance = font_load_advance(render, utf_code, advance) == ESP_OK ? *advance : FONT_ADVANCE_MISSING;
+		font_freetype_unlock();
+	}
+	if (entry->advance == FONT_ADVANCE_MISSING) {
+		return ESP_FAIL;
+	}
+	*advance = entry->advance;
+	return ESP_OK;
+}
+
+
+static glyph_cache_record_t *font_render_cache_bitmap(font_render_t *render, uint32_t utf_code, const FT_Bitmap *bitmap, int left, int top, int advance, const FT_Glyph_Metrics *metrics) {
+	// Spans are kept even when larger than gray2 bitmap, they are faster to
+	// draw, gray2 is used only when row offsets don't fit 16 bits
+	font_bitmap_format_t bitmap_format = font_bitmap_bits(render->format) ? render->format : FONT_BITMAP_GRAY2;
+	size_t bitmap_size = font_coverage_size(bitmap->width, bitmap->rows, font_bitmap_bits(bitmap_format));
+	if (render->format == FONT_BITMAP_GRAY2_SPANS) {
+		const size_t spans_size = font_encode_spans(bitmap, NULL, SIZE_MAX);
+		if (spans_size > 0) {
+			bitmap_format = FONT_BITMAP_GRAY2_SPANS;
+			bitmap_size = spans_size;
+		}
+	}
+
+	glyph_cache_record_t *record = font_cache_insert(render->font_face, render->pixel_size, utf_code, FONT_CACHE_MODE(render), bitmap_size);
+	if (!record) {
+		return NULL;
+	}
+
+	record->bitmap_width = bitmap->width;
+	record->bitmap_height = bitmap->rows;
+	record->bitmap_left = left;
+	record->bitmap_top = top;
+	record->advance = advance;
+	record->bitmap_format = bitmap_format;
+	font_pack_metrics(metrics, &record->metrics);
+	if (bitmap_format == FONT_BITMAP_GRAY2_SPANS) {
+		font_encode_spans(bitmap, record->bitmap, bitmap_size);
+	}
+	else {
+		font_encode_coverage(bitmap, record->bitmap, font_bitmap_bits(bitmap_format));
+	}
+	font_cache_publish(record);
+
+	return record;
+}
+
+
+// Unscaled outline stored as n_points, n_contours, points, contour ends and
+// tags, all points fit 16 bits in font units
+static glyph_cache_record_t *font_render_outline(font_render_t *render, uint32_t utf_code) {
+	glyph_cache_record_t *record = font_cache_find(render->font_face, 0, utf_code, FONT_CACHE_MODE_OUTLINE);
+	if (record) {
+		return record;
+	}
+
+	const FT_Face ft_face = render->font_face->ft_face;
+	FT_UInt glyph_index = FT_Get_Char_Index(ft_face, utf_code);
+	if (glyph_index == 0) {
+		return NULL;
+	}
+	const uint32_t start = esp_cpu_get_ccount();
+	const FT_Error err = FT_Load_Glyph(ft_face, glyph_index, FT_LOAD_NO_SCALE);
+	render->stats.load_cycles += esp_cpu_get_ccount() - start;
+	if (err || ft_face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
+		return NULL;
+	}
+
+	const FT_Outline *outline = &ft_face->glyph->outline;
+	const size_t size = 4 + outline->n_points * 4 + outline->n_contours * 2 + outline->n_points;
+	record = font_cache_insert(render->font_face, 0, utf_code, FONT_CACHE_MODE_OUTLINE, size);
+	if (!record) {
+		return NULL;
+	}
+
+	int16_t *data = (int16_t *)record->bitmap;
+	data[0] = outline->n_points;
+	data[1] = outline->n_contours;
+	data += 2;
+	for (int i = 0; i < outline->n_points; ++i) {
+		*data++ = outline->points[i].x;
+		*data++ = outline->points[i].y;
+	}
+	for (int i = 0; i < outline->n_contours; ++i) {
+		*data++ = outline->contours[i];
+	}
+	if (outline->n_points) {
+		memcpy(data, outline->tags, outline->n_points);
+	}
+	record->advance = ft_face->glyph->advance.x;
+	record->bitmap_format = FONT_BITMAP_OUTLINE;
+	font_pack_metrics(&ft_face->glyph->metrics, &record->metrics);
+	font_cache_publish(record);
+
+	return record;
+}
+
+
+// Scratch buffers reused for scaled outlines and their bitmaps
+static FT_Vector *outline_points = NULL;
+static size_t outline_points_size = 0;
+static short *outline_contours = NULL;
+static size_t outline_contours_size = 0;
+static uint8_t *outline_bitmap = NULL;
+static size_t outline_bitmap_size = 0;
+
 
-		err = FT_Render_Glyph(render->font_face->ft_face->glyph, FT_RENDER_MODE_NORMAL);
+static bool font_scratch_reserve(void **buffer, size_t *buffer_size, size_t size) {
+	if (*buffer_size >= size) {
+		return true;
+	}
+	heap_caps_free(*buffer);
+	*buffer = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+	*buffer_size = *buffer ? size : 0;
+	return *buffer != NULL;
+}
+
+
+// Cached outline scaled to size of render into scratch buffers
+static bool font_render_scale_outline(const font_render_t *render, const glyph_cache_record_t *outline_record, FT_Outline *outline) {
+	const int16_t *data = (const int16_t *)outline_record->bitmap;
+	const int n_points = data[0];
+	const int n_contours = data[1];
+	const int16_t *points = data + 2;
+	const int16_t *contours = points + n_points * 2;
+	const char *tags = (const char *)(contours + n_contours);
+
+	if (!font_scratch_reserve((void **)&outline_points, &outline_points_size, n_points * sizeof(FT_Vector)) ||
+	    !font_scratch_reserve((void **)&outline_contours, &outline_contours_size, n_contours * sizeof(short))) {
+		ESP_LOGE(TAG, "Outline not allocated");
+		return false;
+	}
+
+	const FT_Size_Metrics *size_metrics = &render->ft_size->metrics;
+	for (int i = 0; i < n_points; ++i) {
+		outline_points[i].x = FT_MulFix(points[i * 2], size_metrics->x_scale);
+		outline_points[i].y = FT_MulFix(points[i * 2 + 1], size_metrics->y_scale);
+	}
+	for (int i = 0; i < n_contours; ++i) {
+		outline_contours[i] = contours[i];
+	}
+	*outline = (FT_Outline){
+		.n_contours = n_contours,
+		.n_points = n_points,
+		.points = outline_points,
+		.tags = (char *)tags,
+		.contours = outline_contours,
+		.flags = FT_OUTLINE_NONE,
+	};
+	return true;
+}
+
+
+// Scales cached outline with size of render and rasterizes it with smooth
+// rasterizer, TrueType loading and bytecode are skipped. Output is same as
+// FreeType unhinted load except for composite glyphs offsetting components,
+// FreeType scales offset of each component separately, so they may be placed
+// 1/64 pixel apart, e.g. quote, colon and semicolon of Ubuntu
+static glyph_cache_record_t *font_render_cache_outline(font_render_t *render, uint32_t utf_code) {
+	glyph_cache_record_t *outline_record = font_render_outline(render, utf_code);
+	if (!outline_record) {
+		return NULL;
+	}
+
+	FT_Outline outline;
+	if (!font_render_scale_outline(render, outline_record, &outline)) {
+		return NULL;
+	}
+	const int n_points = outline.n_points;
+
+	// Pixel aligned bounds like FreeType uses for unhinted glyphs
+	FT_BBox bbox;
+	FT_Outline_Get_CBox(&outline, &bbox);
+	const int left = bbox.xMin >> 6;
+	const int bottom = bbox.yMin >> 6;
+	const int top = n_points ? (bbox.yMax + 63) >> 6 : 0;
+	FT_Bitmap bitmap = {
+		.rows = n_points ? top - bottom : 0,
+		.width = n_points ? ((bbox.xMax + 63) >> 6) - left : 0,
+		.pixel_mode = FT_PIXEL_MODE_GRAY,
+		.num_grays = 256,
+	};
+	bitmap.pitch = bitmap.width;
+	if (!font_scratch_reserve((void **)&outline_bitmap, &outline_bitmap_size, MAX((size_t)bitmap.pitch * bitmap.rows, 1))) {
+		ESP_LOGE(TAG, "Outline bitmap not allocated");
+		return NULL;
+	}
+	bitmap.buffer = outline_bitmap;
+	memset(bitmap.buffer, 0, (size_t)bitmap.pitch * bitmap.rows);
+	if (n_points) {
+		FT_Outline_Translate(&outline, -left * 64, -bottom * 64);
+		const uint32_t start = esp_cpu_get_ccount();
+		FT_Error err = FT_Outline_Get_Bitmap(ft_library, &outline, &bitmap);
+		render->stats.render_cycles += esp_cpu_get_ccount() - start;
 		if (err) {
-			ESP_LOGE(TAG, "Glyph not rendered %d", err);
-			return ESP_FAIL;
+			ESP_LOGE(TAG, "Outline not rendered %d", err);
+			return NULL;
 		}
+	}
 
-		// Find lowest priority
-		uint16_t min_priority = 0xffff;
-		for (size_t i = 0; i < render->cache_size; ++i) {
-			if (render->glyph_cache_records[i].priority <= min_priority) {
-				min_priority = render->glyph_cache_records[i].priority;
-				found_cache = i;
-			}
+	const FT_Size_Metrics *size_metrics = &render->ft_size->metrics;
+	FT_Glyph_Metrics metrics;
+	font_unpack_metrics(&outline_record->metrics, size_metrics->x_scale, size_metrics->y_scale, &metrics);
+	const int advance = FT_MulFix(outline_record->advance, size_metrics->x_scale) >> 6;
+
+	return font_render_cache_bitmap(render, utf_code, &bitmap, left, top, advance, &metrics);
+}
+
+
+// Flattens outline and inserts pending record, field is computed by
+// font_render_publish_sdf without FreeType lock
+static glyph_cache_record_t *font_render_cache_sdf(font_render_t *render, uint32_t utf_code, font_sdf_outline_t *outline) {
+	const FT_GlyphSlot glyph = render->font_face->ft_face->glyph;
+	if (glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
+		ESP_LOGE(TAG, "Glyph without outline");
+		return NULL;
+	}
+
+	// Pixel bounds of outline with border for distance field
+	FT_BBox bbox;
+	FT_Outline_Get_CBox(&glyph->outline, &bbox);
+	const int left = (bbox.xMin >> 6) - FONT_SDF_SPREAD;
+	const int top = ((bbox.yMax + 63) >> 6) + FONT_SDF_SPREAD;
+	const int width = glyph->outline.n_points ? ((bbox.xMax + 63) >> 6) + FONT_SDF_SPREAD - left : 0;
+	const int height = glyph->outline.n_points ? top - ((bbox.yMin >> 6) - FONT_SDF_SPREAD) : 0;
+
+	outline->segments = NULL;
+	outline->count = 0;
+	outline->origin_x = left;
+	outline->origin_y = top;
+	FT_Outline_Decompose(&glyph->outline, &font_sdf_outline_funcs, outline);
+	if (outline->count > 0) {
+		outline->segments = (float *)heap_caps_malloc(outline->count * 4 * sizeof(float), MALLOC_CAP_DEFAULT);
+		if (!outline->segments) {
+			ESP_LOGE(TAG, "Outline not allocated");
+			return NULL;
 		}
+		outline->count = 0;
+		FT_Outline_Decompose(&glyph->outline, &font_sdf_outline_funcs, outline);
+	}
 
-		render->current_priority++;
-		if (render->current_priority == 0) {
-			for (size_t i = 0; i < render->cache_size; ++i) {
-				render->glyph_cache_records[i].priority = 0;
-			}
+	glyph_cache_record_t *record = font_cache_insert(render->font_face, FONT_SDF_PIXEL_SIZE, utf_code, FONT_CACHE_MODE(render), (size_t)width * height);
+	if (!record) {
+		heap_caps_free(outline->segments);
+		outline->segments = NULL;
+		return NULL;
+	}
+	record->bitmap_width = width;
+	record->bitmap_height = height;
+	record->bitmap_left = left;
+	record->bitmap_top = top;
+	record->advance = glyph->advance.x >> 6;
+	record->bitmap_format = FONT_BITMAP_SDF;
+	font_pack_metrics(&glyph->metrics, &record->metrics);
+	outline->record = record;
+	return record;
+}
+
+
+// Pending record is pinned by caller, so it's neither evicted nor moved while
+// field is computed, other tasks miss it until it's published
+static void font_render_publish_sdf(font_render_t *render, font_sdf_outline_t *outline) {
+	glyph_cache_record_t *record = outline->record;
+	const uint32_t start = esp_cpu_get_ccount();
+	font_encode_sdf(outline, record->bitmap, record->bitmap_width, record->bitmap_height);
+	render->stats.render_cycles += esp_cpu_get_ccount() - start;
+	font_cache_publish(record);
+	heap_caps_free(outline->segments);
+	outline->segments = NULL;
+	outline->record = NULL;
+}
+
+
+// Bitmaps are used directly from mapped data, nothing is cached
+static esp_err_t font_render_prerendered_glyph(font_render_t *render, uint32_t utf_code) {
+	const uint8_t *data = render->font_face->prerendered;
+	const font_prerendered_glyph_t *glyph = font_prerendered_find_glyph(data, render->prerendered, utf_code);
+	if (!glyph) {
+		return ESP_FAIL;
+	}
+
+	render->bitmap_width = glyph->bitmap_width;
+	render->bitmap_height = glyph->bitmap_height;
+	render->bitmap_left = glyph->bitmap_left;
+	render->bitmap_top = glyph->bitmap_top;
+	render->advance = glyph->advance;
+	render->bitmap_format = glyph->bitmap_format;
+	render->bitmap = (uint8_t *)(data + glyph->bitmap_offset);
+	font_prerendered_metrics(glyph, &render->metrics);
+
+	return ESP_OK;
+}
+
+
+// Loads, rasterizes and caches glyph missing in cache, called with FreeType
+// lock held, distance field is left pending in sdf_outline
+static glyph_cache_record_t *font_render_load_glyph(font_render_t *render, uint32_t utf_code, font_size_t cache_pixel_size, font_sdf_outline_t *sdf_outline) {
+	if (render->format == FONT_BITMAP_OUTLINE) {
+		// Only unscaled outline is cached, it's rasterized when drawn
+		return font_render_outline(render, utf_code);
+	}
+
+	// Other task could cache glyph while lock was waited for, distance field
+	// it's still computing is shared instead of computed again
+	glyph_cache_record_t *record = font_cache_find_loading(render->font_face, cache_pixel_size, utf_code, FONT_CACHE_MODE(render));
+	if (record) {
+		return record;
+	}
+
+	// Outline is kept only when it's scaled again, render of single size would
+	// share cache budget between outlines and bitmaps made from them
+	const bool unhinted = render->format != FONT_BITMAP_SDF && render->hinting == FONT_HINTING_NONE;
+	if (unhinted && (render->size_changed || font_cache_find(render->font_face, 0, utf_code, FONT_CACHE_MODE_OUTLINE))) {
+		return font_render_cache_outline(render, utf_code);
+	}
+
+	if (render->format == FONT_BITMAP_SDF) {
+		if (font_face_activate_pixel_size(render->font_face, FONT_SDF_PIXEL_SIZE) != ESP_OK) {
+			return NULL;
 		}
-		render->glyph_cache_records[found_cache].priority = render->current_priority;
-		render->glyph_cache_records[found_cache].utf_code = utf_code;
-		render->glyph_cache_records[found_cache].metrics = render->font_face->ft_face->glyph->metrics;
-		render->glyph_cache_records[found_cache].bitmap_width = render->font_face->ft_face->glyph->bitmap.width;
-		render->glyph_cache_records[found_cache].bitmap_height = render->font_face->ft_face->glyph->bitmap.rows;
-		render->glyph_cache_records[found_cache].bitmap_left = render->font_face->ft_face->glyph->bitmap_left;
-		render->glyph_cache_records[found_cache].bitmap_top = render->font_face->ft_face->glyph->bitmap_top;
-		render->glyph_cache_records[found_cache].advance = render->font_face->ft_face->glyph->advance.x >> 6;
-
-		render->bitmap = render->glyph_cache + (render->bytes_per_glyph * found_cache);
-		memset(render->bitmap, 0, render->bytes_per_glyph);
-		size_t pos = 0;
-		for (size_t y = 0; y < render->font_face->ft_face->glyph->bitmap.rows; ++y) {
-			for (size_t x = 0; x < render->font_face->ft_face->glyph->bitmap.width; ++x) {
-				uint8_t color = render->font_face->ft_face->glyph->bitmap.buffer[y * render->font_face->ft_face->glyph->bitmap.pitch + x];
-				render->bitmap[pos >> 2] |= ((color >> 6) << ((pos & 0x03) << 1));
-				pos++;
+	}
+	else if (font_render_activate_size(render) != ESP_OK) {
+		return NULL;
+	}
+
+	FT_UInt glyph_index = FT_Get_Char_Index(render->font_face->ft_face, utf_code);
+	if (glyph_index == 0) {
+		return NULL;
+	}
+
+	// Distance field is scaled, outline hinted to its size would be distorted
+	uint32_t start = esp_cpu_get_ccount();
+	FT_Error err = FT_Load_Glyph(render->font_face->ft_face, glyph_index, render->format == FONT_BITMAP_SDF || unhinted ? FT_LOAD_NO_HINTING : FT_LOAD_DEFAULT);
+	render->stats.load_cycles += esp_cpu_get_ccount() - start;
+	if (err) {
+		return NULL;
+	}
+
+	const FT_GlyphSlot glyph = render->font_face->ft_face->glyph;
+	if (render->format == FONT_BITMAP_SDF) {
+		return font_render_cache_sdf(render, utf_code, sdf_outline);
+	}
+	start = esp_cpu_get_ccount();
+	err = FT_Render_Glyph(glyph, FT_RENDER_MODE_NORMAL);
+	render->stats.render_cycles += esp_cpu_get_ccount() - start;
+	if (err) {
+		ESP_LOGE(TAG, "Glyph not rendered %d", err);
+		return NULL;
+	}
+	return font_render_cache_bitmap(render, utf_code, &glyph->bitmap, glyph->bitmap_left, glyph->bitmap_top, glyph->advance.x >> 6, &glyph->metrics);
+}
+
+
+// Glyph arrives later from prefetch worker, advance comes from table of
+// render when it's known
+static esp_err_t font_render_placeholder(font_render_t *render, uint32_t utf_code) {
+	int advance = render->pixel_size / 2;
+	const struct font_advance_table *table = render->advances;
+	if (table && table->pixel_size == render->pixel_size && table->mode == FONT_CACHE_MODE(render)) {
+		const font_advance_entry_t *entry = &table->entries[utf_code & (FONT_ADVANCE_TABLE_SIZE - 1)];
+		if (entry->utf_code == utf_code && entry->advance != FONT_ADVANCE_MISSING) {
+			advance = entry->advance;
+		}
+	}
+
+	// Previous glyph is released, blitters and outline drawing see empty bitmap
+	if (render->glyph) {
+		font_cache_unpin(render->glyph);
+		render->glyph = NULL;
+	}
+	memset(&render->metrics, 0, sizeof(render->metrics));
+	render->metrics.horiAdvance = advance << 6;
+	render->bitmap_width = 0;
+	render->bitmap_height = 0;
+	render->bitmap_left = 0;
+	render->bitmap_top = 0;
+	render->advance = advance;
+	render->bitmap = NULL;
+	render->bitmap_format = FONT_BITMAP_GRAY2;
+
+	// Full queue loses request, glyph is queued again by one of next misses
+	if (font_prefetch_miss(render, utf_code) == ESP_ERR_NO_MEM) {
+		render->stats.prefetch_dropped++;
+	}
+	return ESP_ERR_NOT_FINISHED;
+}
+
+
+// Working set of shared cache and counters of render since window start
+static void font_render_log_window(font_render_t *render) {
+	const font_render_stats_t *start = &render->window_stats;
+	size_t bytes;
+	size_t used;
+	size_t budget;
+	const size_t glyphs = font_cache_working_set(render->window_clock, &bytes);
+	font_cache_usage(&used, &budget);
+	ESP_LOGI(TAG, "Working set %d glyphs %d bytes, cache %d of %d bytes, %d lookups %d hits %d misses %d evictions",
+		(int)glyphs, (int)bytes, (int)used, (int)budget,
+		(int)(render->stats.lookups - start->lookups),
+		(int)(render->stats.hits - start->hits),
+		(int)(render->stats.misses - start->misses),
+		(int)(render->stats.evictions - start->evictions));
+	render->window_stats = render->stats;
+	render->window_clock = font_cache_clock();
+}
+
+
+esp_err_t font_render_glyph(font_render_t *render, uint32_t utf_code) {
+	if (render->prerendered) {
+		return font_render_prerendered_glyph(render, utf_code);
+	}
+
+	if (render->stats_window && render->stats.lookups - render->window_stats.lookups >= render->stats_window) {
+		font_render_log_window(render);
+	}
+	render->stats.lookups++;
+
+	// Distance fields are shared by all sizes
+	font_size_t cache_pixel_size = render->format == FONT_BITMAP_SDF ? FONT_SDF_PIXEL_SIZE : render->pixel_size;
+	uint8_t cache_mode = FONT_CACHE_MODE(render);
+	if (render->format == FONT_BITMAP_OUTLINE) {
+		cache_pixel_size = 0;
+		cache_mode = FONT_CACHE_MODE_OUTLINE;
+	}
+
+	glyph_cache_record_t *record = render->glyph;
+	if (!record || record->utf_code != utf_code || record->face != render->font_face || record->pixel_size != cache_pixel_size || record->mode != cache_mode) {
+		record = font_cache_acquire(render->font_face, cache_pixel_size, utf_code, cache_mode);
+		if (!record) {
+			render->stats.misses++;
+			if (render->miss_policy == FONT_MISS_PLACEHOLDER) {
+				return font_render_placeholder(render, utf_code);
+			}
+			font_sdf_outline_t sdf_outline = {.record = NULL};
+			font_freetype_lock();
+			// Only FreeType lock holder evicts
+			const uint32_t evictions = font_cache_evictions();
+			record = font_render_load_glyph(render, utf_code, cache_pixel_size, &sdf_outline);
+			if (record) {
+				font_cache_pin(record);
 			}
+			render->stats.evictions += font_cache_evictions() - evictions;
+			font_freetype_unlock();
+			if (!record) {
+				return ESP_FAIL;
+			}
+			if (sdf_outline.record) {
+				font_render_publish_sdf(render, &sdf_outline);
+			}
+			else if (record->bitmap_format == FONT_BITMAP_SDF) {
+				font_cache_wait(record);
+			}
+		}
+		else {
+			render->stats.hits++;
+		}
+
+		// Current glyph stays in cache while it's drawn
+		if (render->glyph) {
+			font_cache_unpin(render->glyph);
 		}
+		render->glyph = record;
+	}
+	else {
+		render->stats.hits++;
+	}
+
+	if (record->bitmap_format == FONT_BITMAP_SDF) {
+		// Placement scaled to render size, field itself is scaled by blitter
+		render->bitmap_width = (record->bitmap_width * render->sdf_scale + 0xffff) >> 16;
+		render->bitmap_height = (record->bitmap_height * render->sdf_scale + 0xffff) >> 16;
+		render->bitmap_left = (record->bitmap_left * (int32_t)render->sdf_scale + 0x8000) >> 16;
+		render->bitmap_top = (record->bitmap_top * (int32_t)render->sdf_scale + 0x8000) >> 16;
+		render->advance = (record->advance * (int32_t)render->sdf_scale + 0x8000) >> 16;
+		font_unpack_metrics(&record->metrics, render->sdf_scale, render->sdf_scale, &render->metrics);
+	}
+	else if (record->bitmap_format == FONT_BITMAP_OUTLINE) {
+		// Pixel bounds of scaled outline, same as bitmap rasterized from it
+		const FT_Size_Metrics *size_metrics = &render->ft_size->metrics;
+		const font_glyph_metrics_t *metrics = &record->metrics;
+		font_unpack_metrics(metrics, size_metrics->x_scale, size_metrics->y_scale, &render->metrics);
+		const bool empty = ((const int16_t *)record->bitmap)[0] == 0;
+		const int left = FT_MulFix(metrics->bearing_x, size_metrics->x_scale) >> 6;
+		const int right = (FT_MulFix(metrics->bearing_x + metrics->width, size_metrics->x_scale) + 63) >> 6;
+		const int top = (FT_MulFix(metrics->bearing_y, size_metrics->y_scale) + 63) >> 6;
+		const int bottom = FT_MulFix(metrics->bearing_y - metrics->height, size_metrics->y_scale) >> 6;
+		render->bitmap_width = empty ? 0 : right - left;
+		render->bitmap_height = empty ? 0 : top - bottom;
+		render->bitmap_left = left;
+		render->bitmap_top = empty ? 0 : top;
+		render->advance = FT_MulFix(record->advance, size_metrics->x_scale) >> 6;
 	}
+	else {
+		render->bitmap_width = record->bitmap_width;
+		render->bitmap_height = record->bitmap_height;
+		render->bitmap_left = record->bitmap_left;
+		render->bitmap_top = record->bitmap_top;
+		render->advance = record->advance;
+		font_unpack_metrics(&record->metrics, 0x10000, 0x10000, &render->metrics);
+	}
+	render->bitmap_format = record->bitmap_format;
+	render->bitmap = record->bitmap;
 
+	return ESP_OK;
+}
 
-	render->glyph_cache_records[found_cache].priority = render->current_priority;
-	render->metrics = render->glyph_cache_records[found_cache].metrics;
-	render->bitmap_width = render->glyph_cache_records[found_cache].bitmap_width;
-	render->bitmap_height = render->glyph_cache_records[found_cache].bitmap_height;
-	render->bitmap_left = render->glyph_cache_records[found_cache].bitmap_left;
-	render->bitmap_top = render->glyph_cache_records[found_cache].bitmap_top;
-	render->advance = render->glyph_cache_records[found_cache].advance;
-	render->bitmap = render->glyph_cache + (render->bytes_per_glyph * found_cache);
+
+void font_render_get_stats(const font_render_t *render, font_render_stats_t *stats) {
+	*stats = render->stats;
+	font_cache_usage(&stats->cache_used, &stats->cache_budget);
+}
+
+
+void font_render_reset_stats(font_render_t *render) {
+	memset(&render->stats, 0, sizeof(render->stats));
+	render->window_stats = render->stats;
+	render->window_clock = font_cache_clock();
+}
+
+
+void font_render_set_stats_window(font_render_t *render, uint32_t lookups) {
+	render->stats_window = lookups;
+	render->window_stats = render->stats;
+	render->window_clock = font_cache_clock();
+}
+
+
+uint8_t font_bitmap_bits(font_bitmap_format_t format) {
+	switch (format) {
+		case FONT_BITMAP_GRAY1:
+			return 1;
+		case FONT_BITMAP_GRAY2:
+			return 2;
+		case FONT_BITMAP_GRAY4:
+			return 4;
+		case FONT_BITMAP_GRAY8:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+
+const FT_Glyph_Metrics *font_render_glyph_metrics(const font_render_t *render) {
+	return render->prerendered || render->glyph ? &render->metrics : NULL;
+}
+
+
+typedef struct font_span_target {
+	font_span_func_t callback;
+	void *user_data;
+	int baseline;
+} font_span_target_t;
+
+
+// Rows of rasterizer go up from baseline, target rows go down
+static void font_render_span(int y, int count, const FT_Span *spans, void *user) {
+	const font_span_target_t *target = (const font_span_target_t *)user;
+	const int row = target->baseline - 1 - y;
+	for (int i = 0; i < count; ++i) {
+		target->callback(spans[i].x, row, spans[i].len, spans[i].coverage, target->user_data);
+	}
+}
+
+
+esp_err_t font_render_draw_spans(const font_render_t *render, int x, int y, int target_w, int target_h, font_span_func_t callback, void *user_data) {
+	if (!render->glyph || render->glyph->bitmap_format != FONT_BITMAP_OUTLINE) {
+		ESP_LOGE(TAG, "Glyph is not outline");
+		return ESP_FAIL;
+	}
+	if (x >= target_w || y >= target_h || x + (int)render->bitmap_width <= 0 || y + (int)render->bitmap_height <= 0) {
+		return ESP_OK;
+	}
+
+	// Scratch outline is shared with tasks loading glyphs
+	font_freetype_lock();
+	FT_Outline outline;
+	if (!font_render_scale_outline(render, render->glyph, &outline)) {
+		font_freetype_unlock();
+		return ESP_FAIL;
+	}
+	FT_Outline_Translate(&outline, (x - render->bitmap_left) * 64, 0);
+
+	// Rasterizer skips cells outside of clip box, only target rows are swept
+	font_span_target_t target = {
+		.callback = callback,
+		.user_data = user_data,
+		.baseline = y + render->bitmap_top,
+	};
+	FT_Raster_Params params = {
+		.source = &outline,
+		.flags = FT_RASTER_FLAG_AA | FT_RASTER_FLAG_DIRECT | FT_RASTER_FLAG_CLIP,
+		.gray_spans = font_render_span,
+		.user = &target,
+		.clip_box = {
+			.xMin = 0,
+			.yMin = target.baseline - target_h,
+			.xMax = target_w,
+			.yMax = target.baseline,
+		},
+	};
+	FT_Error err = FT_Outline_Render(ft_library, &outline, &params);
+	font_freetype_unlock();
+	if (err) {
+		ESP_LOGE(TAG, "Outline not rendered %d", err);
+		return ESP_FAIL;
+	}
 
 	return ESP_OK;
 }
+
+
+// Spans and all coverage depths encode bitmap of same size and placement
+static font_bitmap_format_t font_string_format(font_bitmap_format_t format) {
+	return format == FONT_BITMAP_GRAY2_SPANS || font_bitmap_bits(format) ? FONT_BITMAP_GRAY2 : format;
+}
+
+
+const font_string_t *font_render_string(const font_render_t *render, const font_string_set_t *set) {
+	if (set->font_id != render->font_face->font_id || set->hinting != render->hinting || font_string_format(set->format) != font_string_format(render->format)) {
+		return NULL;
+	}
+	for (size_t i = 0; i < set->size_count; ++i) {
+		if (set->sizes[i].pixel_size == render->pixel_size) {
+			return &set->sizes[i];
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: MIT
+
+// Measures font_render_glyph on text workloads and writes one JSON object per
+// line for every result, so runs can be compared by scripts
+//
+// font_benchmark FONT [--sizes 14,24,48] [--budgets 4096,16384,65536]
+//     [--format gray1|gray2|gray4|gray8|outline] [--repeat 16]
+//
+// Every corpus is measured at every size with both hinting modes:
+//   rasterize       cold and warm glyph cost with cache large enough for corpus
+//   cache           hit rate of corpus text repeated within each cache budget
+//   coverage_strip  glyph lookup and coverage of corpus lines combined into
+//                   8 bit strips for each budget, RGB565 blending and display
+//                   transfer are not included
+// Times are nanoseconds, FreeType times come from render statistics, which
+// count nanoseconds in host build
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <time.h>
+
+#include "font_render.h"
+#include "font_tool.h"
+#include "unicode.h"
+
+
+#define FONT_BENCHMARK_MAX_SIZES 16
+#define FONT_BENCHMARK_MAX_BUDGETS 16
+#define FONT_BENCHMARK_MAX_CODES 256
+// Cache of rasterize results, holds every corpus at largest size
+#define FONT_BENCHMARK_RASTERIZE_BUDGET (1024 * 1024)
+// Strips of demo display
+#define FONT_BENCHMARK_STRIP_WIDTH 240
+#define FONT_BENCHMARK_STRIP_HEIGHT 20
+
+
+typedef struct font_benchmark_options {
+	const char *font_path;
+	font_size_t sizes[FONT_BENCHMARK_MAX_SIZES];
+	size_t size_count;
+	size_t budgets[FONT_BENCHMARK_MAX_BUDGETS];
+	size_t budget_count;
+	font_bitmap_format_t format;
+	size_t repeat;
+} font_benchmark_options_t;
+
+// Lines are separated by newline
+typedef struct font_benchmark_corpus {
+	const char *name;
+	const char *text;
+} font_benchmark_corpus_t;
+
+typedef struct font_benchmark_strip {
+	uint8_t pixels[FONT_BENCHMARK_STRIP_WIDTH * FONT_BENCHMARK_STRIP_HEIGHT];
+} font_benchmark_strip_t;
+
+
+static const font_benchmark_corpus_t font_benchmark_corpora[] = {
+	{"lorem",
+		"Lorem ipsum dolor sit amet,\n"
+		"consectetur adipiscing elit.\n"
+		"Pellentesque tristique quam sit\n"
+		"amet dolor sagittis lacinia.\n"
+		"Phasellus non dui sed orci\n"
+		"vehicula faucibus ut vitae dui.\n"
+		"Duis pulvinar sem risus, quis\n"
+		"bibendum elit consequat vel.\n"
+		"Cras eget fermentum magna.\n"
+		"Maecenas eu pretium diam,\n"
+		"sed tempor ex."},
+	{"digits",
+		"12:45:07\n"
+		"98.6 % 3.14159\n"
+		"-40.5 +1024 0x7f\n"
+		"2718281828 459045\n"
+		"23/11/2025 08:30"},
+	{"mixed",
+		"Menu: Настройки / Ρυθμίσεις\n"
+		"Příliš žluťoučký kůň úpěl\n"
+		"Съешь же ещё этих мягких булок\n"
+		"Größe, Straße, garçon, señor\n"
+		"Ξεσκεπάζω την ψυχοφθόρα βδελυγμία\n"
+		"42 °C, 80 %, 設定 ready"},
+};
+
+static void font_benchmark_usage(void) {
+	fprintf(stderr, "usage: font_benchmark FONT [--sizes 14,24] [--budgets 4096,65536] [--format gray1|gray2|gray4|gray8|outline] [--repeat 16]\n");
+	exit(1);
+}
+
+
+static void font_benchmark_parse(font_benchmark_options_t *options, int argc, char **argv) {
+	if (argc < 2) {
+		font_benchmark_usage();
+	}
+	options->font_path = argv[1];
+	options->format = FONT_BITMAP_GRAY2;
+	options->repeat = 16;
+
+	for (int i = 2; i < argc; i += 2) {
+		if (i + 1 == argc) {
+			font_benchmark_usage();
+		}
+		bool valid;
+		if (strcmp(argv[i], "--sizes") == 0) {
+			valid = font_tool_parse_sizes(argv[i + 1], options->sizes, FONT_BENCHMARK_MAX_SIZES, &options->size_count);
+		}
+		else if (strcmp(argv[i], "--budgets") == 0) {
+			valid = font_tool_parse_list(argv[i + 1], options->budgets, FONT_BENCHMARK_MAX_BUDGETS, SIZE_MAX, &options->budget_count);
+		}
+		else if (strcmp(argv[i], "--repeat") == 0) {
+			size_t repeat_count = 0;
+			valid = font_tool_parse_list(argv[i + 1], &options->repeat, 1, 1 << 20, &repeat_count);
+		}
+		else if (strcmp(argv[i], "--format") == 0) {
+			// Strips draw cached bitmaps and outlines, spans are not decoded
+			valid = font_tool_parse_format(argv[i + 1], &options->format) && options->format != FONT_BITMAP_GRAY2_SPANS;
+		}
+		else {
+			valid = false;
+		}
+		if (!valid) {
+			font_benchmark_usage();
+		}
+	}
+
+	if (options->size_count == 0) {
+		static const font_size_t sizes[] = {14, 24, 48};
+		memcpy(options->sizes, sizes, sizeof(sizes));
+		options->size_count = sizeof(sizes) / sizeof(sizes[0]);
+	}
+	if (options->budget_count == 0) {
+		static const size_t budgets[] = {4096, 8192, 16384, 32768, 65536};
+		memcpy(options->budgets, budgets, sizeof(budgets));
+		options->budget_count = sizeof(budgets) / sizeof(budgets[0]);
+	}
+}
+
+
+static uint64_t font_benchmark_now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000u + time.tv_nsec;
+}
+
+
+// Distinct codes of corpus without line breaks in order of first use
+static size_t font_benchmark_codes(const font_benchmark_corpus_t *corpus, uint32_t *codes) {
+	size_t count = 0;
+	for (const char *text = corpus->text; *text;) {
+		uint32_t utf_code;
+		text += u8_decode(&utf_code, text);
+		if (utf_code == '\n') {
+			continue;
+		}
+		size_t i = 0;
+		while (i < count && codes[i] != utf_code) {
+			i++;
+		}
+		if (i == count && count < FONT_BENCHMARK_MAX_CODES) {
+			codes[count++] = utf_code;
+		}
+	}
+	return count;
+}
+
+
+// Empty cache, renders must not pin glyphs
+static void font_benchmark_flush(size_t budget) {
+	ESP_ERROR_CHECK(font_cache_set_budget(budget));
+}
+
+
+static void font_benchmark_init_render(font_render_t *render, font_face_t *face, const font_benchmark_options_t *options, font_size_t pixel_size, font_hinting_t hinting) {
+	ESP_ERROR_CHECK(font_render_init(render, face, pixel_size));
+	render->format = options->format;
+	render->hinting = hinting;
+}
+
+
+static void font_benchmark_print_key(const char *benchmark, const font_benchmark_options_t *options, const font_benchmark_corpus_t *corpus, const font_render_t *render) {
+	printf("{\"benchmark\": \"%s\", \"corpus\": \"%s\", \"format\": \"%s\", \"hinting\": \"%s\", \"pixel_size\": %u", benchmark, corpus->name, font_tool_format_name(options->format), font_tool_hinting_name(render->hinting), (unsigned)render->pixel_size);
+}
+
+
+static double font_benchmark_hit_rate(const font_render_stats_t *stats) {
+	return stats->lookups ? (double)stats->hits / stats->lookups : 0.0;
+}
+
+
+// Distinct glyphs of corpus loaded into empty cache, then looked up again
+static void font_benchmark_rasterize(const font_benchmark_options_t *options, font_face_t *face, const font_benchmark_corpus_t *corpus, font_size_t pixel_size, font_hinting_t hinting) {
+	uint32_t codes[FONT_BENCHMARK_MAX_CODES];
+	const size_t count = font_benchmark_codes(corpus, codes);
+	size_t missing = 0;
+
+	font_benchmark_flush(FONT_BENCHMARK_RASTERIZE_BUDGET);
+	font_render_t render = {0};
+	font_benchmark_init_render(&render, face, options, pixel_size, hinting);
+
+	uint64_t start = font_benchmark_now();
+	for (size_t i = 0; i < count; ++i) {
+		if (font_render_glyph(&render, codes[i]) != ESP_OK) {
+			missing++;
+		}
+	}
+	const uint64_t cold_ns = font_benchmark_now() - start;
+	font_render_stats_t stats;
+	font_render_get_stats(&render, &stats);
+
+	start = font_benchmark_now();
+	for (size_t repeat = 0; repeat < options->repeat; ++repeat) {
+		for (size_t i = 0; i < count; ++i) {
+			font_render_glyph(&render, codes[i]);
+		}
+	}
+	const uint64_t warm_ns = font_benchmark_now() - start;
+
+	font_benchmark_print_key("rasterize", options, corpus, &render);
+	printf(", \"glyphs\": %zu, \"missing\": %zu, \"cold_ns_per_glyph\": %.1f, \"warm_ns_per_glyph\": %.1f, \"load_ns_per_glyph\": %.1f, \"render_ns_per_glyph\": %.1f, \"cache_bytes\": %zu}\n",
+		count, missing,
+		(double)cold_ns / MAX(count, 1),
+		(double)warm_ns / MAX(count * options->repeat, 1),
+		(double)stats.load_cycles / MAX(count, 1),
+		(double)stats.render_cycles / MAX(count, 1),
+		stats.cache_used);
+	font_render_destroy(&render);
+}
+
+
+// Corpus text looked up glyph by glyph in cache of budget, starting empty
+static void font_benchmark_cache(const font_benchmark_options_t *options, font_face_t *face, const font_benchmark_corpus_t *corpus, font_size_t pixel_size, font_hinting_t hinting, size_t budget) {
+	font_benchmark_flush(budget);
+	font_render_t render = {0};
+	font_benchmark_init_render(&render, face, options, pixel_size, hinting);
+
+	const uint64_t start = font_benchmark_now();
+	for (size_t repeat = 0; repeat < options->repeat; ++repeat) {
+		for (const char *text = corpus->text; *text;) {
+			uint32_t utf_code;
+			text += u8_decode(&utf_code, text);
+			if (utf_code != '\n') {
+				font_render_glyph(&render, utf_code);
+			}
+		}
+	}
+	const uint64_t ns = font_benchmark_now() - start;
+
+	font_render_stats_t stats;
+	font_render_get_stats(&render, &stats);
+	font_benchmark_print_key("cache", options, corpus, &render);
+	printf(", \"budget\": %zu, \"lookups\": %u, \"hits\": %u, \"misses\": %u, \"evictions\": %u, \"hit_rate\": %.4f, \"ns_per_glyph\": %.1f, \"load_ns\": %llu, \"render_ns\": %llu, \"cache_bytes\": %zu}\n",
+		budget, (unsigned)stats.lookups, (unsigned)stats.hits, (unsigned)stats.misses, (unsigned)stats.evictions,
+		font_benchmark_hit_rate(&stats),
+		(double)ns / MAX(stats.lookups, 1),
+		(unsigned long long)stats.load_cycles, (unsigned long long)stats.render_cycles,
+		stats.cache_used);
+	font_render_destroy(&render);
+}
+
+
+static void font_benchmark_span(int x, int y, int length, uint8_t coverage, void *user_data) {
+	uint8_t *pixel = ((font_benchmark_strip_t *)user_data)->pixels + y * FONT_BENCHMARK_STRIP_WIDTH + x;
+	for (int i = 0; i < length; ++i) {
+		pixel[i] = MAX(pixel[i], coverage);
+	}
+}
+
+
+// Coverage of current glyph combined into strip, x and y are bitmap corner
+static void font_benchmark_draw_glyph(const font_render_t *render, font_benchmark_strip_t *strip, int x, int y) {
+	if (render->bitmap_format == FONT_BITMAP_OUTLINE) {
+		font_render_draw_spans(render, x, y, FONT_BENCHMARK_STRIP_WIDTH, FONT_BENCHMARK_STRIP_HEIGHT, font_benchmark_span, strip);
+		return;
+	}
+	const uint8_t bits = font_bitmap_bits(render->bitmap_format);
+	if (bits == 0) {
+		return;
+	}
+	const uint8_t mask = (1 << bits) - 1;
+	const size_t pixels_per_byte = 8 / bits;
+	for (int row = MAX(-y, 0); row < (int)render->bitmap_height && y + row < FONT_BENCHMARK_STRIP_HEIGHT; ++row) {
+		for (int column = MAX(-x, 0); column < (int)render->bitmap_width && x + column < FONT_BENCHMARK_STRIP_WIDTH; ++column) {
+			const size_t pos = (size_t)row * render->bitmap_width + column;
+			const uint8_t level = (render->bitmap[pos / pixels_per_byte] >> ((pos % pixels_per_byte) * bits)) & mask;
+			uint8_t *pixel = &strip->pixels[(y + row) * FONT_BENCHMARK_STRIP_WIDTH + x + column];
+			*pixel = MAX(*pixel, level * 255 / mask);
+		}
+	}
+}
+
+
+// Corpus lines laid out to every strip of frame like paragraphs of demo, lines
+// outside of strip are skipped without decoding, coverage is kept as 8 bit
+// maximum instead of blended to display colors
+static void font_benchmark_strips(const font_benchmark_options_t *options, font_face_t *face, const font_benchmark_corpus_t *corpus, font_size_t pixel_size, font_hinting_t hinting, size_t budget) {
+	const char *lines[64];
+	size_t line_count = 0;
+	for (const char *line = corpus->text; line && line_count < sizeof(lines) / sizeof(lines[0]); line = strchr(line, '\n')) {
+		if (*line == '\n') {
+			line++;
+		}
+		lines[line_count++] = line;
+	}
+
+	font_benchmark_flush(budget);
+	font_render_t render = {0};
+	font_benchmark_init_render(&render, face, options, pixel_size, hinting);
+	const int line_height = render.max_pixel_height;
+	const int frame_height = line_height * line_count;
+	const size_t strip_count = (frame_height + FONT_BENCHMARK_STRIP_HEIGHT - 1) / FONT_BENCHMARK_STRIP_HEIGHT;
+	font_benchmark_strip_t *strip = malloc(sizeof(font_benchmark_strip_t));
+	if (!strip) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	const uint64_t start = font_benchmark_now();
+	for (size_t repeat = 0; repeat < options->repeat; ++repeat) {
+		for (int y = 0; y < frame_height; y += FONT_BENCHMARK_STRIP_HEIGHT) {
+			memset(strip->pixels, 0, sizeof(strip->pixels));
+			for (size_t line = 0; line < line_count; ++line) {
+				const int line_y = (int)line * line_height - y;
+				if (line_y >= FONT_BENCHMARK_STRIP_HEIGHT || line_y + line_height <= 0) {
+					continue;
+				}
+				int x = 0;
+				for (const char *text = lines[line]; *text && *text != '\n';) {
+					uint32_t utf_code;
+					text += u8_decode(&utf_code, text);
+					if (font_render_glyph(&render, utf_code) != ESP_OK) {
+						continue;
+					}
+					font_benchmark_draw_glyph(&render, strip, x + render.bitmap_left, line_y + render.max_pixel_height - render.origin - render.bitmap_top);
+					x += render.advance;
+				}
+			}
+		}
+	}
+	const uint64_t ns = font_benchmark_now() - start;
+
+	font_render_stats_t stats;
+	font_render_get_stats(&render, &stats);
+	font_benchmark_print_key("coverage_strip", options, corpus, &render);
+	printf(", \"budget\": %zu, \"strip_width\": %d, \"strip_height\": %d, \"strips\": %zu, \"hit_rate\": %.4f, \"ns_per_strip\": %.1f, \"ns_per_frame\": %.1f}\n",
+		budget, FONT_BENCHMARK_STRIP_WIDTH, FONT_BENCHMARK_STRIP_HEIGHT, strip_count,
+		font_benchmark_hit_rate(&stats),
+		(double)ns / MAX(strip_count * options->repeat, 1),
+		(double)ns / options->repeat);
+	free(strip);
+	font_render_destroy(&render);
+}
+
+
+int main(int argc, char **argv) {
+	font_benchmark_options_t options = {0};
+	font_benchmark_parse(&options, argc, argv);
+
+	size_t font_size;
+	uint8_t *font_data = font_tool_read(options.font_path, &font_size);
+	font_face_t face;
+	ESP_ERROR_CHECK(font_face_init(&face, font_data, font_size));
+
+	for (size_t corpus = 0; corpus < sizeof(font_benchmark_corpora) / sizeof(font_benchmark_corpora[0]); ++corpus) {
+		for (size_t size = 0; size < options.size_count; ++size) {
+			for (font_hinting_t hinting = FONT_HINTING_DEFAULT; hinting <= FONT_HINTING_NONE; ++hinting) {
+				font_benchmark_rasterize(&options, &face, &font_benchmark_corpora[corpus], options.sizes[size], hinting);
+				for (size_t budget = 0; budget < options.budget_count; ++budget) {
+					font_benchmark_cache(&options, &face, &font_benchmark_corpora[corpus], options.sizes[size], hinting, options.budgets[budget]);
+				}
+				for (size_t budget = 0; budget < options.budget_count; ++budget) {
+					font_benchmark_strips(&options, &face, &font_benchmark_corpora[corpus], options.sizes[size], hinting, options.budgets[budget]);
+				}
+			}
+		}
+	}
+
+	font_face_destroy(&face);
+	free(font_data);
+	return 0;
+}
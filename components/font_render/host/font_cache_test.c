@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: MIT
+
+// Checks lookups, pending records, LRU order, pinning, budget eviction and
+// face removal of glyph cache, records are inserted directly without fonts
+//
+// font_cache_test
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "font_cache.h"
+
+
+#define FONT_CACHE_TEST_BITMAP 64
+#define FONT_CACHE_TEST_RECORDS 8
+
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+		failures++; \
+	} \
+} while (0)
+
+
+static const font_face_t face_a;
+static const font_face_t face_b;
+
+
+static glyph_cache_record_t *font_cache_test_add(const font_face_t *face, uint32_t utf_code) {
+	glyph_cache_record_t *record = font_cache_insert(face, 14, utf_code, 0, FONT_CACHE_TEST_BITMAP);
+	if (record) {
+		record->bitmap[0] = (uint8_t)utf_code;
+		font_cache_publish(record);
+	}
+	return record;
+}
+
+
+// Budget holding exactly count test records
+static size_t font_cache_test_budget(size_t count) {
+	CHECK(font_cache_set_budget(1 << 16) == ESP_OK);
+	glyph_cache_record_t *record = font_cache_test_add(&face_a, 0);
+	const size_t size = record->size;
+	CHECK(font_cache_set_budget(size * count) == ESP_OK);
+	return size;
+}
+
+
+static void font_cache_test_lookup(void) {
+	font_cache_test_budget(FONT_CACHE_TEST_RECORDS);
+
+	glyph_cache_record_t *record = font_cache_insert(&face_a, 14, 'a', 0, FONT_CACHE_TEST_BITMAP);
+	CHECK(record != NULL);
+	// Pending record is hidden until it's published
+	CHECK(font_cache_find(&face_a, 14, 'a', 0) == NULL);
+	record->bitmap[0] = 'a';
+	font_cache_publish(record);
+	CHECK(font_cache_find(&face_a, 14, 'a', 0) == record);
+
+	// Every part of key is compared
+	CHECK(font_cache_find(&face_a, 14, 'b', 0) == NULL);
+	CHECK(font_cache_find(&face_a, 16, 'a', 0) == NULL);
+	CHECK(font_cache_find(&face_a, 14, 'a', 1) == NULL);
+	CHECK(font_cache_find(&face_b, 14, 'a', 0) == NULL);
+
+	glyph_cache_record_t *other = font_cache_test_add(&face_b, 'a');
+	CHECK(font_cache_find(&face_b, 14, 'a', 0) == other);
+	CHECK(font_cache_find(&face_a, 14, 'a', 0) == record);
+	CHECK(record->bitmap[0] == 'a');
+}
+
+
+// Loader holding FreeType lock sees record other task still writes, so it
+// waits for it instead of inserting duplicate
+static void font_cache_test_loading(void) {
+	font_cache_test_budget(FONT_CACHE_TEST_RECORDS);
+	glyph_cache_record_t *record = font_cache_insert(&face_a, 14, 'p', 0, FONT_CACHE_TEST_BITMAP);
+	CHECK(record != NULL);
+	font_cache_pin(record);
+	CHECK(font_cache_find(&face_a, 14, 'p', 0) == NULL);
+	CHECK(font_cache_acquire(&face_a, 14, 'p', 0) == NULL);
+	CHECK(font_cache_find_loading(&face_a, 14, 'p', 0) == record);
+	CHECK(font_cache_find_loading(&face_b, 14, 'p', 0) == NULL);
+
+	record->bitmap[0] = 'p';
+	font_cache_publish(record);
+	font_cache_wait(record);
+	CHECK(font_cache_find(&face_a, 14, 'p', 0) == record);
+	CHECK(font_cache_find_loading(&face_a, 14, 'p', 0) == record);
+	CHECK(record->bitmap[0] == 'p');
+	font_cache_unpin(record);
+}
+
+
+static void font_cache_test_lru(void) {
+	font_cache_test_budget(FONT_CACHE_TEST_RECORDS);
+	for (uint32_t code = 1; code <= FONT_CACHE_TEST_RECORDS; ++code) {
+		CHECK(font_cache_test_add(&face_a, code) != NULL);
+	}
+
+	// Lookup moves glyph 1 to front, glyph 2 is least recently used
+	CHECK(font_cache_find(&face_a, 14, 1, 0) != NULL);
+	const uint32_t evictions = font_cache_evictions();
+	CHECK(font_cache_test_add(&face_a, 100) != NULL);
+	CHECK(font_cache_evictions() == evictions + 1);
+	CHECK(font_cache_find(&face_a, 14, 2, 0) == NULL);
+	CHECK(font_cache_find(&face_a, 14, 1, 0) != NULL);
+	for (uint32_t code = 3; code <= FONT_CACHE_TEST_RECORDS; ++code) {
+		CHECK(font_cache_find(&face_a, 14, code, 0) != NULL);
+	}
+	CHECK(font_cache_find(&face_a, 14, 100, 0) != NULL);
+}
+
+
+static void font_cache_test_pin(void) {
+	font_cache_test_budget(FONT_CACHE_TEST_RECORDS);
+	glyph_cache_record_t *pinned = font_cache_test_add(&face_a, 1);
+	font_cache_pin(pinned);
+	CHECK(font_cache_acquire(&face_a, 14, 1, 0) == pinned);
+	CHECK(pinned->pin_count == 2);
+
+	// Pinned glyph is least recently used and survives all evictions
+	for (uint32_t code = 2; code < 4 * FONT_CACHE_TEST_RECORDS; ++code) {
+		CHECK(font_cache_test_add(&face_a, code) != NULL);
+	}
+	CHECK(font_cache_find(&face_a, 14, 1, 0) == pinned);
+	CHECK(pinned->bitmap[0] == 1);
+
+	// Pinned glyphs block budget change
+	CHECK(font_cache_set_budget(1 << 16) == ESP_FAIL);
+	CHECK(font_cache_find(&face_a, 14, 1, 0) == pinned);
+
+	font_cache_unpin(pinned);
+	font_cache_unpin(pinned);
+	CHECK(pinned->pin_count == 0);
+	CHECK(font_cache_set_budget(1 << 16) == ESP_OK);
+	CHECK(font_cache_find(&face_a, 14, 1, 0) == NULL);
+}
+
+
+static void font_cache_test_full_of_pinned(void) {
+	font_cache_test_budget(2);
+	glyph_cache_record_t *first = font_cache_test_add(&face_a, 1);
+	glyph_cache_record_t *second = font_cache_test_add(&face_a, 2);
+	font_cache_pin(first);
+	font_cache_pin(second);
+	CHECK(font_cache_test_add(&face_a, 3) == NULL);
+	font_cache_unpin(second);
+	CHECK(font_cache_test_add(&face_a, 3) != NULL);
+	CHECK(font_cache_find(&face_a, 14, 2, 0) == NULL);
+	font_cache_unpin(first);
+}
+
+
+static void font_cache_test_budget_eviction(void) {
+	const size_t record_size = font_cache_test_budget(FONT_CACHE_TEST_RECORDS);
+	const uint32_t evictions = font_cache_evictions();
+	const uint32_t count = 10 * FONT_CACHE_TEST_RECORDS;
+	for (uint32_t code = 1; code <= count; ++code) {
+		// Records of other sizes leave holes filled by compaction
+		const size_t bitmap_size = (code % 3) * FONT_CACHE_TEST_BITMAP / 2;
+		glyph_cache_record_t *record = font_cache_insert(&face_a, 14, code, 0, bitmap_size);
+		CHECK(record != NULL);
+		if (record) {
+			font_cache_publish(record);
+		}
+		size_t used;
+		size_t budget;
+		font_cache_usage(&used, &budget);
+		CHECK(used <= budget);
+	}
+	CHECK(font_cache_evictions() > evictions);
+
+	// Most recent glyphs stay, oldest are gone
+	CHECK(font_cache_find(&face_a, 14, count, 0) != NULL);
+	CHECK(font_cache_find(&face_a, 14, 1, 0) == NULL);
+	size_t bytes;
+	font_cache_working_set(0, &bytes);
+	CHECK(bytes <= record_size * FONT_CACHE_TEST_RECORDS);
+}
+
+
+static void font_cache_test_remove_face(void) {
+	font_cache_test_budget(FONT_CACHE_TEST_RECORDS);
+	glyph_cache_record_t *pinned = font_cache_test_add(&face_a, 1);
+	font_cache_test_add(&face_a, 2);
+	font_cache_test_add(&face_b, 1);
+
+	// Glyph held by render keeps all glyphs of face
+	font_cache_pin(pinned);
+	CHECK(font_cache_remove_face(&face_a) == ESP_ERR_INVALID_STATE);
+	CHECK(font_cache_find(&face_a, 14, 1, 0) == pinned);
+	CHECK(font_cache_find(&face_a, 14, 2, 0) != NULL);
+	font_cache_unpin(pinned);
+
+	CHECK(font_cache_remove_face(&face_a) == ESP_OK);
+	CHECK(font_cache_find(&face_a, 14, 1, 0) == NULL);
+	CHECK(font_cache_find(&face_a, 14, 2, 0) == NULL);
+	CHECK(font_cache_find(&face_b, 14, 1, 0) != NULL);
+}
+
+
+int main(void) {
+	font_cache_test_lookup();
+	font_cache_test_loading();
+	font_cache_test_lru();
+	font_cache_test_pin();
+	font_cache_test_full_of_pinned();
+	font_cache_test_budget_eviction();
+	font_cache_test_remove_face();
+	CHECK(font_cache_set_budget(1 << 16) == ESP_OK);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("font_cache_test: all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: MIT
+
+// Rasterizes glyph ranges of font at selected sizes with font_render and
+// writes them in format of font_prerendered.h
+//
+// font_prerender FONT OUTPUT --sizes 14,16,24 --ranges 0x20-0x7e,0xa0-0x17f
+//     [--format gray1|gray2|gray4|gray8|spans] [--hinting default|none]
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "font_render.h"
+#include "font_prerendered.h"
+#include "font_tool.h"
+
+
+#define FONT_PRERENDER_MAX_SIZES 16
+#define FONT_PRERENDER_MAX_RANGES 32
+
+
+typedef struct font_prerender_range {
+	uint32_t first;
+	uint32_t last;
+} font_prerender_range_t;
+
+typedef struct font_prerender_options {
+	const char *font_path;
+	const char *output_path;
+	font_size_t sizes[FONT_PRERENDER_MAX_SIZES];
+	size_t size_count;
+	font_prerender_range_t ranges[FONT_PRERENDER_MAX_RANGES];
+	size_t range_count;
+	font_bitmap_format_t format;
+	font_hinting_t hinting;
+} font_prerender_options_t;
+
+typedef struct font_prerender_buffer {
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+} font_prerender_buffer_t;
+
+
+static void font_prerender_usage(void) {
+	fprintf(stderr, "usage: font_prerender FONT OUTPUT --sizes 14,16 --ranges 0x20-0x7e [--format gray1|gray2|gray4|gray8|spans] [--hinting default|none]\n");
+	exit(1);
+}
+
+
+static void *font_prerender_append(font_prerender_buffer_t *buffer, const void *data, size_t size) {
+	if (size == 0) {
+		return NULL;
+	}
+	if (buffer->size + size > buffer->capacity) {
+		buffer->capacity = (buffer->size + size) * 2;
+		buffer->data = realloc(buffer->data, buffer->capacity);
+		if (!buffer->data) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	void *target = buffer->data + buffer->size;
+	if (data) {
+		memcpy(target, data, size);
+	}
+	else {
+		memset(target, 0, size);
+	}
+	buffer->size += size;
+	return target;
+}
+
+
+static void font_prerender_align(font_prerender_buffer_t *buffer, size_t alignment) {
+	const size_t padding = (alignment - (buffer->size & (alignment - 1))) & (alignment - 1);
+	font_prerender_append(buffer, NULL, padding);
+}
+
+
+static bool font_prerender_parse_ranges(font_prerender_options_t *options, char *value) {
+	for (char *item = strtok(value, ","); item; item = strtok(NULL, ",")) {
+		char *end;
+		font_prerender_range_t range;
+		range.first = strtoul(item, &end, 0);
+		range.last = *end == '-' ? strtoul(end + 1, &end, 0) : range.first;
+		if (options->range_count == FONT_PRERENDER_MAX_RANGES || *end != '\0' || range.last < range.first) {
+			return false;
+		}
+		options->ranges[options->range_count++] = range;
+	}
+	return true;
+}
+
+
+static void font_prerender_parse(font_prerender_options_t *options, int argc, char **argv) {
+	if (argc < 3) {
+		font_prerender_usage();
+	}
+	options->font_path = argv[1];
+	options->output_path = argv[2];
+	options->format = FONT_BITMAP_GRAY2_SPANS;
+	options->hinting = FONT_HINTING_DEFAULT;
+
+	for (int i = 3; i < argc; i += 2) {
+		if (i + 1 == argc) {
+			font_prerender_usage();
+		}
+		bool valid;
+		if (strcmp(argv[i], "--sizes") == 0) {
+			valid = font_tool_parse_sizes(argv[i + 1], options->sizes, FONT_PRERENDER_MAX_SIZES, &options->size_count);
+		}
+		else if (strcmp(argv[i], "--ranges") == 0) {
+			valid = font_prerender_parse_ranges(options, argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "--format") == 0) {
+			// Outlines are not stored in prerendered data
+			valid = font_tool_parse_format(argv[i + 1], &options->format) && options->format != FONT_BITMAP_OUTLINE;
+		}
+		else if (strcmp(argv[i], "--hinting") == 0) {
+			valid = font_tool_parse_hinting(argv[i + 1], &options->hinting);
+		}
+		else {
+			valid = false;
+		}
+		if (!valid) {
+			font_prerender_usage();
+		}
+	}
+	if (options->size_count == 0 || options->range_count == 0) {
+		font_prerender_usage();
+	}
+}
+
+
+// Encoded spans end after runs of last row
+static size_t font_prerender_spans_size(const uint8_t *bitmap, size_t width, size_t height) {
+	size_t pos = height * 2;
+	for (size_t row = 0; row < height; ++row) {
+		pos = bitmap[row * 2] | (bitmap[row * 2 + 1] << 8);
+		size_t x = 0;
+		while (x < width) {
+			const uint8_t header = bitmap[pos++];
+			const size_t length = (header & 0x3f) + 1;
+			if ((header >> 6) == 2) {
+				pos += (length + 3) >> 2;
+			}
+			x += length;
+		}
+	}
+	return pos;
+}
+
+
+static size_t font_prerender_bitmap_size(const font_render_t *render) {
+	if (render->bitmap_format == FONT_BITMAP_GRAY2_SPANS) {
+		return font_prerender_spans_size(render->bitmap, render->bitmap_width, render->bitmap_height);
+	}
+	return ((size_t)render->bitmap_width * render->bitmap_height * font_bitmap_bits(render->bitmap_format) + 7) >> 3;
+}
+
+
+// Glyph table of one size, bitmap offsets are relative to bitmap buffer
+static size_t font_prerender_size(const font_prerender_options_t *options, font_face_t *face, font_size_t pixel_size, font_prerendered_size_t *size, font_prerender_buffer_t *glyphs, font_prerender_buffer_t *bitmaps) {
+	font_render_t render = {0};
+	ESP_ERROR_CHECK(font_render_init(&render, face, pixel_size));
+	render.format = options->format;
+	render.hinting = options->hinting;
+
+	size->pixel_size = pixel_size;
+	size->max_pixel_width = render.max_pixel_width;
+	size->max_pixel_height = render.max_pixel_height;
+	size->origin = render.origin;
+	size->glyph_count = 0;
+
+	// Codes are visited in order, overlapping ranges still give sorted table
+	for (uint32_t utf_code = 0; utf_code <= 0x10ffff; ++utf_code) {
+		bool selected = false;
+		for (size_t i = 0; i < options->range_count; ++i) {
+			if (utf_code >= options->ranges[i].first && utf_code <= options->ranges[i].last) {
+				selected = true;
+				break;
+			}
+		}
+		if (!selected || font_render_glyph(&render, utf_code) != ESP_OK) {
+			continue;
+		}
+
+		const FT_Glyph_Metrics *metrics = font_render_glyph_metrics(&render);
+		const font_prerendered_glyph_t glyph = {
+			.utf_code = utf_code,
+			.bitmap_offset = bitmaps->size,
+			.bitmap_width = render.bitmap_width,
+			.bitmap_height = render.bitmap_height,
+			.bitmap_left = render.bitmap_left,
+			.bitmap_top = render.bitmap_top,
+			.advance = render.advance,
+			.bitmap_format = render.bitmap_format,
+			.width = metrics->width,
+			.height = metrics->height,
+			.hori_bearing_x = metrics->horiBearingX,
+			.hori_bearing_y = metrics->horiBearingY,
+			.hori_advance = metrics->horiAdvance,
+		};
+		font_prerender_append(glyphs, &glyph, sizeof(glyph));
+		font_prerender_append(bitmaps, render.bitmap, font_prerender_bitmap_size(&render));
+		size->glyph_count++;
+	}
+
+	font_render_destroy(&render);
+	return size->glyph_count;
+}
+
+
+int main(int argc, char **argv) {
+	font_prerender_options_t options = {0};
+	font_prerender_parse(&options, argc, argv);
+
+	size_t font_size;
+	uint8_t *font_data = font_tool_read(options.font_path, &font_size);
+	font_face_t face;
+	ESP_ERROR_CHECK(font_face_init(&face, font_data, font_size));
+
+	font_prerendered_size_t sizes[FONT_PRERENDER_MAX_SIZES];
+	font_prerender_buffer_t glyphs[FONT_PRERENDER_MAX_SIZES] = {0};
+	font_prerender_buffer_t bitmaps = {0};
+	size_t glyph_count = 0;
+	for (size_t i = 0; i < options.size_count; ++i) {
+		glyph_count += font_prerender_size(&options, &face, options.sizes[i], &sizes[i], &glyphs[i], &bitmaps);
+	}
+
+	// Header, size table, glyph tables, bitmaps
+	font_prerender_buffer_t output = {0};
+	const font_prerendered_header_t header = {
+		.magic = FONT_PRERENDERED_MAGIC,
+		.version = FONT_PRERENDERED_VERSION,
+		.size_count = options.size_count,
+		.font_id = face.font_id,
+	};
+	font_prerender_append(&output, &header, sizeof(header));
+	font_prerender_append(&output, NULL, sizeof(sizes[0]) * options.size_count);
+	size_t glyphs_offset[FONT_PRERENDER_MAX_SIZES];
+	for (size_t i = 0; i < options.size_count; ++i) {
+		font_prerender_align(&output, __alignof__(font_prerendered_glyph_t));
+		glyphs_offset[i] = output.size;
+		font_prerender_append(&output, glyphs[i].data, glyphs[i].size);
+	}
+	const size_t bitmaps_offset = output.size;
+	font_prerender_append(&output, bitmaps.data, bitmaps.size);
+
+	font_prerendered_size_t *size_table = (font_prerendered_size_t *)(output.data + sizeof(header));
+	for (size_t i = 0; i < options.size_count; ++i) {
+		sizes[i].glyphs_offset = glyphs_offset[i];
+		size_table[i] = sizes[i];
+		font_prerendered_glyph_t *glyph = (font_prerendered_glyph_t *)(output.data + glyphs_offset[i]);
+		for (size_t j = 0; j < sizes[i].glyph_count; ++j) {
+			glyph[j].bitmap_offset += bitmaps_offset;
+		}
+		free(glyphs[i].data);
+	}
+
+	FILE *file = fopen(options.output_path, "wb");
+	if (!file || fwrite(output.data, 1, output.size, file) != output.size || fclose(file) != 0) {
+		perror(options.output_path);
+		return 1;
+	}
+	printf("%s: %zu glyphs in %zu sizes, %zu bytes\n", options.output_path, glyph_count, options.size_count, output.size);
+
+	free(output.data);
+	free(bitmaps.data);
+	font_face_destroy(&face);
+	free(font_data);
+	return 0;
+}
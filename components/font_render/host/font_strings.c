@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: MIT
+
+// Lays out constant strings with font_render at selected sizes and writes
+// them as font_string_set_t tables, OUTPUT.c and OUTPUT.h are generated and
+// symbols are named <basename of OUTPUT>_<name>
+//
+// font_strings FONT STRINGS OUTPUT --sizes 14,16,24
+//     [--format gray1|gray2|gray4|gray8|spans|outline] [--hinting default|none]
+//
+// STRINGS has one NAME = TEXT per line, text is UTF-8 up to end of line,
+// empty lines and lines starting with # are skipped, longer lines than
+// FONT_STRINGS_MAX_LINE are rejected
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "font_render.h"
+#include "font_tool.h"
+#include "unicode.h"
+
+
+#define FONT_STRINGS_MAX_SIZES 16
+#define FONT_STRINGS_MAX_LINE 1024
+
+
+typedef struct font_strings_options {
+	const char *font_path;
+	const char *strings_path;
+	const char *output_path;
+	font_size_t sizes[FONT_STRINGS_MAX_SIZES];
+	size_t size_count;
+	font_bitmap_format_t format;
+	font_hinting_t hinting;
+} font_strings_options_t;
+
+
+static const char *font_strings_format_names[] = {
+	[FONT_BITMAP_GRAY2] = "FONT_BITMAP_GRAY2",
+	[FONT_BITMAP_GRAY2_SPANS] = "FONT_BITMAP_GRAY2_SPANS",
+	[FONT_BITMAP_SDF] = "FONT_BITMAP_SDF",
+	[FONT_BITMAP_OUTLINE] = "FONT_BITMAP_OUTLINE",
+	[FONT_BITMAP_GRAY1] = "FONT_BITMAP_GRAY1",
+	[FONT_BITMAP_GRAY4] = "FONT_BITMAP_GRAY4",
+	[FONT_BITMAP_GRAY8] = "FONT_BITMAP_GRAY8",
+};
+
+static const char *font_strings_hinting_names[] = {
+	[FONT_HINTING_DEFAULT] = "FONT_HINTING_DEFAULT",
+	[FONT_HINTING_NONE] = "FONT_HINTING_NONE",
+};
+
+
+static void font_strings_usage(void) {
+	fprintf(stderr, "usage: font_strings FONT STRINGS OUTPUT --sizes 14,16 [--format gray1|gray2|gray4|gray8|spans|outline] [--hinting default|none]\n");
+	exit(1);
+}
+
+
+static void font_strings_parse(font_strings_options_t *options, int argc, char **argv) {
+	if (argc < 4) {
+		font_strings_usage();
+	}
+	options->font_path = argv[1];
+	options->strings_path = argv[2];
+	options->output_path = argv[3];
+	options->format = FONT_BITMAP_GRAY2_SPANS;
+	options->hinting = FONT_HINTING_DEFAULT;
+
+	for (int i = 4; i < argc; i += 2) {
+		if (i + 1 == argc) {
+			font_strings_usage();
+		}
+		bool valid;
+		if (strcmp(argv[i], "--sizes") == 0) {
+			valid = font_tool_parse_sizes(argv[i + 1], options->sizes, FONT_STRINGS_MAX_SIZES, &options->size_count);
+		}
+		else if (strcmp(argv[i], "--format") == 0) {
+			valid = font_tool_parse_format(argv[i + 1], &options->format);
+		}
+		else if (strcmp(argv[i], "--hinting") == 0) {
+			valid = font_tool_parse_hinting(argv[i + 1], &options->hinting);
+		}
+		else {
+			valid = false;
+		}
+		if (!valid) {
+			font_strings_usage();
+		}
+	}
+	if (options->size_count == 0) {
+		font_strings_usage();
+	}
+}
+
+
+static FILE *font_strings_create(const char *output_path, const char *extension) {
+	char path[FILENAME_MAX];
+	snprintf(path, sizeof(path), "%s%s", output_path, extension);
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		perror(path);
+		exit(1);
+	}
+	return file;
+}
+
+
+static char *font_strings_trim(char *text) {
+	while (isspace((unsigned char)*text)) {
+		text++;
+	}
+	char *end = text + strlen(text);
+	while (end > text && isspace((unsigned char)end[-1])) {
+		*--end = '\0';
+	}
+	return text;
+}
+
+
+static bool font_strings_identifier(const char *name) {
+	if (!isalpha((unsigned char)*name) && *name != '_') {
+		return false;
+	}
+	for (; *name; ++name) {
+		if (!isalnum((unsigned char)*name) && *name != '_') {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Octal escapes do not swallow following digits like hex escapes
+static void font_strings_write_literal(FILE *file, const char *text) {
+	fputc('"', file);
+	for (const uint8_t *pos = (const uint8_t *)text; *pos; ++pos) {
+		if (*pos == '"' || *pos == '\\') {
+			fprintf(file, "\\%c", *pos);
+		}
+		else if (*pos < 0x20 || *pos >= 0x7f || *pos == '?') {
+			fprintf(file, "\\%03o", *pos);
+		}
+		else {
+			fputc(*pos, file);
+		}
+	}
+	fputc('"', file);
+}
+
+
+// Same layout as runs shaped at runtime, missing glyphs are skipped
+static void font_strings_layout(FILE *file, const char *prefix, const char *name, const char *text, font_render_t *render, font_string_t *layout) {
+	memset(layout, 0, sizeof(*layout));
+	layout->pixel_size = render->pixel_size;
+	int left = INT16_MAX;
+	int top = INT16_MAX;
+	int right = INT16_MIN;
+	int bottom = INT16_MIN;
+	int pen_x = 0;
+
+	// Text is shorter than line, so every code fits
+	uint32_t codes[FONT_STRINGS_MAX_LINE];
+	const size_t length = strlen(text);
+	size_t consumed;
+	u8_decode_status_t status;
+	const size_t count = u8_decode_buffer(codes, FONT_STRINGS_MAX_LINE, text, length, U8_INVALID_STOP, &consumed, &status);
+	if (status != U8_DECODE_OK) {
+		fprintf(stderr, "%s: %s UTF-8 sequence at byte %zu\n", name, status == U8_DECODE_TRUNCATED ? "truncated" : "ill-formed", consumed);
+		exit(1);
+	}
+	for (size_t i = 0; i < count; ++i) {
+		const uint32_t utf_code = codes[i];
+		if (font_render_glyph(render, utf_code) != ESP_OK) {
+			fprintf(stderr, "%s: glyph U+%04X skipped\n", name, (unsigned)utf_code);
+			continue;
+		}
+
+		const font_string_glyph_t glyph = {
+			.utf_code = utf_code,
+			.x = pen_x + render->bitmap_left,
+			.y = render->max_pixel_height - render->origin - render->bitmap_top,
+			.width = render->bitmap_width,
+			.height = render->bitmap_height,
+		};
+		pen_x += render->advance;
+
+		if (layout->glyph_count == 0) {
+			fprintf(file, "static const font_string_glyph_t %s_%s_%u[] = {\n", prefix, name, (unsigned)render->pixel_size);
+		}
+		fprintf(file, "\t{0x%04x, %d, %d, %u, %u},\n", (unsigned)glyph.utf_code, glyph.x, glyph.y, glyph.width, glyph.height);
+		layout->glyph_count++;
+
+		if (glyph.width > 0 && glyph.height > 0) {
+			left = MIN(left, glyph.x);
+			top = MIN(top, glyph.y);
+			right = MAX(right, glyph.x + glyph.width);
+			bottom = MAX(bottom, glyph.y + glyph.height);
+		}
+	}
+	if (layout->glyph_count > 0) {
+		fprintf(file, "};\n\n");
+	}
+	if (left > right) {
+		left = top = right = bottom = 0;
+	}
+	layout->advance = pen_x;
+	layout->left = left;
+	layout->top = top;
+	layout->right = right;
+	layout->bottom = bottom;
+}
+
+
+static void font_strings_write_set(FILE *source, FILE *header, const font_strings_options_t *options, const char *prefix, const char *name, const char *text, font_render_t *renders, uint32_t font_id) {
+	font_string_t layouts[FONT_STRINGS_MAX_SIZES];
+	for (size_t i = 0; i < options->size_count; ++i) {
+		font_strings_layout(source, prefix, name, text, &renders[i], &layouts[i]);
+	}
+
+	fprintf(source, "static const font_string_t %s_%s_sizes[] = {\n", prefix, name);
+	for (size_t i = 0; i < options->size_count; ++i) {
+		const font_string_t *layout = &layouts[i];
+		fprintf(source, "\t{\n");
+		fprintf(source, "\t\t.pixel_size = %u,\n", (unsigned)layout->pixel_size);
+		fprintf(source, "\t\t.advance = %d,\n", layout->advance);
+		fprintf(source, "\t\t.left = %d,\n", layout->left);
+		fprintf(source, "\t\t.top = %d,\n", layout->top);
+		fprintf(source, "\t\t.right = %d,\n", layout->right);
+		fprintf(source, "\t\t.bottom = %d,\n", layout->bottom);
+		fprintf(source, "\t\t.glyph_count = %u,\n", layout->glyph_count);
+		if (layout->glyph_count > 0) {
+			fprintf(source, "\t\t.glyphs = %s_%s_%u,\n", prefix, name, (unsigned)layout->pixel_size);
+		}
+		fprintf(source, "\t},\n");
+	}
+	fprintf(source, "};\n\n");
+
+	fprintf(source, "const font_string_set_t %s_%s = {\n", prefix, name);
+	fprintf(source, "\t.text = ");
+	font_strings_write_literal(source, text);
+	fprintf(source, ",\n");
+	fprintf(source, "\t.font_id = 0x%08x,\n", (unsigned)font_id);
+	fprintf(source, "\t.format = %s,\n", font_strings_format_names[options->format]);
+	fprintf(source, "\t.hinting = %s,\n", font_strings_hinting_names[options->hinting]);
+	fprintf(source, "\t.size_count = %zu,\n", options->size_count);
+	fprintf(source, "\t.sizes = %s_%s_sizes,\n", prefix, name);
+	fprintf(source, "};\n");
+
+	fprintf(header, "extern const font_string_set_t %s_%s;\n", prefix, name);
+}
+
+
+int main(int argc, char **argv) {
+	font_strings_options_t options = {0};
+	font_strings_parse(&options, argc, argv);
+
+	size_t font_size;
+	uint8_t *font_data = font_tool_read(options.font_path, &font_size);
+	font_face_t face;
+	ESP_ERROR_CHECK(font_face_init(&face, font_data, font_size));
+	font_render_t renders[FONT_STRINGS_MAX_SIZES] = {0};
+	for (size_t i = 0; i < options.size_count; ++i) {
+		ESP_ERROR_CHECK(font_render_init(&renders[i], &face, options.sizes[i]));
+		renders[i].format = options.format;
+		renders[i].hinting = options.hinting;
+	}
+
+	const char *prefix = strrchr(options.output_path, '/');
+	prefix = prefix ? prefix + 1 : options.output_path;
+	if (!font_strings_identifier(prefix)) {
+		fprintf(stderr, "%s: output name is not C identifier\n", prefix);
+		return 1;
+	}
+	const char *strings_name = strrchr(options.strings_path, '/');
+	strings_name = strings_name ? strings_name + 1 : options.strings_path;
+
+	FILE *strings = fopen(options.strings_path, "r");
+	if (!strings) {
+		perror(options.strings_path);
+		return 1;
+	}
+	FILE *source = font_strings_create(options.output_path, ".c");
+	FILE *header = font_strings_create(options.output_path, ".h");
+	fprintf(source, "// Generated by font_strings from %s, do not edit\n", strings_name);
+	fprintf(source, "// Laid out with %s %s, font id 0x%08x\n\n", face.ft_face->family_name, face.ft_face->style_name, (unsigned)face.font_id);
+	fprintf(source, "#include \"%s.h\"\n", prefix);
+	fprintf(header, "// Generated by font_strings from %s, do not edit\n\n", strings_name);
+	fprintf(header, "#pragma once\n\n#include \"font_render.h\"\n\n\n");
+
+	char line[FONT_STRINGS_MAX_LINE];
+	size_t line_number = 0;
+	size_t string_count = 0;
+	while (fgets(line, sizeof(line), strings)) {
+		line_number++;
+		// fgets splits longer line, its tail would be read as next line
+		if (strchr(line, '\n') == NULL && !feof(strings)) {
+			fprintf(stderr, "%s:%zu: line longer than %d bytes\n", options.strings_path, line_number, FONT_STRINGS_MAX_LINE - 2);
+			return 1;
+		}
+		char *name = font_strings_trim(line);
+		if (*name == '\0' || *name == '#') {
+			continue;
+		}
+		char *separator = strchr(name, '=');
+		if (!separator) {
+			fprintf(stderr, "%s:%zu: expected NAME = TEXT\n", options.strings_path, line_number);
+			return 1;
+		}
+		*separator = '\0';
+		const char *text = font_strings_trim(separator + 1);
+		name = font_strings_trim(name);
+		if (!font_strings_identifier(name)) {
+			fprintf(stderr, "%s:%zu: %s is not C identifier\n", options.strings_path, line_number, name);
+			return 1;
+		}
+		fprintf(source, "\n\n");
+		font_strings_write_set(source, header, &options, prefix, name, text, renders, face.font_id);
+		string_count++;
+	}
+
+	fclose(strings);
+	if (fclose(source) != 0 || fclose(header) != 0) {
+		perror(options.output_path);
+		return 1;
+	}
+	printf("%s: %zu strings in %zu sizes\n", options.output_path, string_count, options.size_count);
+
+	for (size_t i = 0; i < options.size_count; ++i) {
+		font_render_destroy(&renders[i]);
+	}
+	font_face_destroy(&face);
+	free(font_data);
+	return 0;
+}
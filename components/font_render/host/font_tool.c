@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "font_tool.h"
+
+
+static const char *font_tool_format_names[] = {
+	[FONT_BITMAP_GRAY2] = "gray2",
+	[FONT_BITMAP_GRAY2_SPANS] = "spans",
+	[FONT_BITMAP_OUTLINE] = "outline",
+	[FONT_BITMAP_GRAY1] = "gray1",
+	[FONT_BITMAP_GRAY4] = "gray4",
+	[FONT_BITMAP_GRAY8] = "gray8",
+};
+
+static const char *font_tool_hinting_names[] = {
+	[FONT_HINTING_DEFAULT] = "default",
+	[FONT_HINTING_NONE] = "none",
+};
+
+
+// Index of name in table with gaps, count when it's missing
+static size_t font_tool_find_name(const char **names, size_t count, const char *name) {
+	size_t index = 0;
+	while (index < count && (!names[index] || strcmp(names[index], name) != 0)) {
+		index++;
+	}
+	return index;
+}
+
+
+uint8_t *font_tool_read(const char *path, size_t *size) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		exit(1);
+	}
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t *data = malloc(*size);
+	if (!data || fread(data, 1, *size, file) != *size) {
+		perror(path);
+		exit(1);
+	}
+	fclose(file);
+	return data;
+}
+
+
+// Whole item is number from 1 to max_value
+static bool font_tool_parse_number(const char *item, size_t max_value, size_t *number) {
+	char *end;
+	const long value = strtol(item, &end, 0);
+	if (*end != '\0' || value <= 0 || (size_t)value > max_value) {
+		return false;
+	}
+	*number = value;
+	return true;
+}
+
+
+bool font_tool_parse_list(char *value, size_t *items, size_t capacity, size_t max_value, size_t *count) {
+	for (char *item = strtok(value, ","); item; item = strtok(NULL, ",")) {
+		if (*count == capacity || !font_tool_parse_number(item, max_value, &items[*count])) {
+			return false;
+		}
+		(*count)++;
+	}
+	return true;
+}
+
+
+bool font_tool_parse_sizes(char *value, font_size_t *sizes, size_t capacity, size_t *count) {
+	for (char *item = strtok(value, ","); item; item = strtok(NULL, ",")) {
+		size_t size;
+		if (*count == capacity || !font_tool_parse_number(item, 0xffff, &size)) {
+			return false;
+		}
+		sizes[(*count)++] = size;
+	}
+	return true;
+}
+
+
+bool font_tool_parse_format(const char *name, font_bitmap_format_t *format) {
+	const size_t count = sizeof(font_tool_format_names) / sizeof(font_tool_format_names[0]);
+	const size_t index = font_tool_find_name(font_tool_format_names, count, name);
+	if (index == count) {
+		return false;
+	}
+	*format = index;
+	return true;
+}
+
+
+const char *font_tool_format_name(font_bitmap_format_t format) {
+	return format < sizeof(font_tool_format_names) / sizeof(font_tool_format_names[0]) && font_tool_format_names[format] ? font_tool_format_names[format] : "unknown";
+}
+
+
+bool font_tool_parse_hinting(const char *name, font_hinting_t *hinting) {
+	const size_t count = sizeof(font_tool_hinting_names) / sizeof(font_tool_hinting_names[0]);
+	const size_t index = font_tool_find_name(font_tool_hinting_names, count, name);
+	if (index == count) {
+		return false;
+	}
+	*hinting = index;
+	return true;
+}
+
+
+const char *font_tool_hinting_name(font_hinting_t hinting) {
+	return hinting < sizeof(font_tool_hinting_names) / sizeof(font_tool_hinting_names[0]) ? font_tool_hinting_names[hinting] : "unknown";
+}
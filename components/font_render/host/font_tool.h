@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+
+// Input and option parsing shared by host tools, errors are reported by
+// caller, which prints its usage
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "font_render.h"
+
+
+// Whole file, exits with message when it can't be read
+uint8_t *font_tool_read(const char *path, size_t *size);
+// Comma separated numbers from 1 to max_value appended to items, false when
+// any is invalid or they don't fit capacity, value is modified by strtok
+bool font_tool_parse_list(char *value, size_t *items, size_t capacity, size_t max_value, size_t *count);
+bool font_tool_parse_sizes(char *value, font_size_t *sizes, size_t capacity, size_t *count);
+// Names are gray1, gray2, gray4, gray8, spans and outline
+bool font_tool_parse_format(const char *name, font_bitmap_format_t *format);
+const char *font_tool_format_name(font_bitmap_format_t format);
+// Names are default and none
+bool font_tool_parse_hinting(const char *name, font_hinting_t *hinting);
+const char *font_tool_hinting_name(font_hinting_t hinting);
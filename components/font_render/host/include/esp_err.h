@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: MIT
+
+// Subset of ESP-IDF used by font_render when built for host tools
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_NOT_FINISHED 0x10C
+
+#define ESP_ERROR_CHECK(x) do { \
+		if ((x) != ESP_OK) { \
+			fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #x); \
+			abort(); \
+		} \
+	} while (0)
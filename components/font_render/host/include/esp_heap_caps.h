@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_DEFAULT 0
+
+static inline void *heap_caps_malloc(size_t size, int caps) {
+	(void)caps;
+	return malloc(size);
+}
+
+static inline void heap_caps_free(void *ptr) {
+	free(ptr);
+}
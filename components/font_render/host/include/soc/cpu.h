@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// Nanoseconds stand in for cycles of render statistics
+static inline uint32_t esp_cpu_get_ccount(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint32_t)((uint64_t)time.tv_sec * 1000000000u + time.tv_nsec);
+}
@@ -2,31 +2,150 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 #include "esp_err.h"
 
 #include "ft2build.h"
 #include FT_FREETYPE_H
+#include FT_SIZES_H
 
 typedef FT_Long font_data_size_t;
 typedef FT_UInt font_size_t;
 typedef FT_Byte font_data_t;
 
 
+typedef enum font_bitmap_format {
+	FONT_BITMAP_GRAY2,       // packed 2 bit coverage
+	FONT_BITMAP_GRAY2_SPANS, // runs of transparent, solid and partial pixels
+	FONT_BITMAP_SDF,         // 8 bit signed distance field, drawn at any scale
+	FONT_BITMAP_OUTLINE,     // unscaled outline, rasterized into spans when drawn
+	FONT_BITMAP_GRAY1,       // packed 1 bit mono, smallest and fastest for tiny text
+	FONT_BITMAP_GRAY4,       // packed 4 bit coverage
+	FONT_BITMAP_GRAY8,       // 8 bit coverage, no banding on large text
+} font_bitmap_format_t;
+
+
+typedef enum font_hinting {
+	FONT_HINTING_DEFAULT, // glyphs loaded and hinted by FreeType for every size
+	FONT_HINTING_NONE,    // cached unscaled outline is scaled and rasterized
+} font_hinting_t;
+
+
+// Distance fields are rendered once at this size and scaled to render size
+#ifndef FONT_SDF_PIXEL_SIZE
+#define FONT_SDF_PIXEL_SIZE 32
+#endif
+// Distance in pixels of FONT_SDF_PIXEL_SIZE covered by field around outline
+#ifndef FONT_SDF_SPREAD
+#define FONT_SDF_SPREAD 4
+#endif
+
+
+// Miss of render used in strip callbacks while prefetch worker fills cache
+typedef enum font_miss_policy {
+	FONT_MISS_RENDER,      // glyph is loaded and rasterized by calling task
+	FONT_MISS_PLACEHOLDER, // empty glyph with advance, glyph is requested from worker
+} font_miss_policy_t;
+
+
+typedef struct font_face font_face_t;
+struct font_prerendered_size;
+struct font_advance_table;
+
+// Run of pixels with same 8 bit coverage, x and y are target coordinates
+typedef void (*font_span_func_t)(int x, int y, int length, uint8_t coverage, void *user_data);
+
+
+// Glyph of laid out string, bitmap position is relative to top left corner of
+// line box at string origin
+typedef struct font_string_glyph {
+	uint32_t utf_code;
+	int16_t x;
+	int16_t y;
+	uint16_t width;
+	uint16_t height;
+} font_string_glyph_t;
+
+// String laid out at one pixel size with bounds of all glyph bitmaps
+typedef struct font_string {
+	font_size_t pixel_size;
+	int16_t advance;
+	int16_t left;
+	int16_t top;
+	int16_t right;
+	int16_t bottom;
+	uint16_t glyph_count;
+	const font_string_glyph_t *glyphs;
+} font_string_t;
+
+// Constant string laid out at build time by host/font_strings for several
+// sizes of one font, text is kept for renders of other sizes
+typedef struct font_string_set {
+	const char *text;
+	uint32_t font_id; // font_id of face strings were laid out with
+	font_bitmap_format_t format;
+	font_hinting_t hinting;
+	size_t size_count;
+	const font_string_t *sizes;
+} font_string_set_t;
+
+
+// Horizontal metrics kept in cache records, 26.6 pixels of cached size or
+// font units for outlines
+typedef struct font_glyph_metrics {
+	int32_t width;
+	int32_t height;
+	int32_t bearing_x;
+	int32_t bearing_y;
+	int32_t advance;
+} font_glyph_metrics_t;
+
+// Entry of glyph cache shared by all renders, bitmap data follows the record
 typedef struct glyph_cache_record {
+	size_t size; // record and bitmap, first member shared with free arena blocks
+	struct glyph_cache_record *hash_next;
+	struct glyph_cache_record *lru_prev;
+	struct glyph_cache_record *lru_next;
+	const font_face_t *face;
 	uint32_t utf_code;
-	uint16_t priority;
-	font_size_t bitmap_width;
-	font_size_t bitmap_height;
-	FT_Glyph_Metrics metrics;
-	int bitmap_left;
-	int bitmap_top;
-	int advance;
+	font_size_t pixel_size;
+	uint8_t mode; // format and hinting requested by render
+	uint16_t pin_count;
+	uint8_t pending; // inserted, bitmap is still written by task that inserted it
+	uint32_t last_used; // cache clock of last lookup
+	uint16_t bitmap_width;
+	uint16_t bitmap_height;
+	int16_t bitmap_left;
+	int16_t bitmap_top;
+	int16_t advance;
+	font_bitmap_format_t bitmap_format;
+	font_glyph_metrics_t metrics;
+	uint8_t bitmap[];
 } glyph_cache_record_t;
 
-typedef struct font_face {
+struct font_face {
 	FT_Face ft_face;
+	FT_Size ft_size; // size used by font_face_set_pixel_size
 	font_size_t pixel_size;
-} font_face_t;
+	const uint8_t *prerendered; // glyphs generated at build time, no FreeType face
+	uint32_t font_id; // checksum of font file, same for prerendered data made from it
+};
+
+
+// Counters of render since init or reset, cache fields describe shared cache
+// at snapshot
+typedef struct font_render_stats {
+	uint32_t lookups; // font_render_glyph calls served through cache
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions; // glyphs evicted to make space for glyphs of render
+	uint64_t load_cycles; // FT_Load_Glyph
+	uint64_t render_cycles; // FT_Render_Glyph, rasterized outlines and distance fields
+	uint32_t prefetch_dropped; // placeholder misses not queued, queue was full
+	size_t cache_used;
+	size_t cache_budget;
+} font_render_stats_t;
 
 
 typedef struct font_render {
@@ -37,24 +156,83 @@ typedef struct font_render {
 	font_size_t bitmap_width;
 	font_size_t bitmap_height;
 	font_size_t pixel_size;
-	uint16_t cache_size;
-	size_t bytes_per_glyph;
-	uint8_t *glyph_cache;
-	glyph_cache_record_t *glyph_cache_records;
-	FT_Glyph_Metrics metrics;
+	FT_Size ft_size; // owned scaled size, activated on glyph load
+	glyph_cache_record_t *glyph; // current glyph, pinned in cache
+	FT_Glyph_Metrics metrics; // 26.6 pixels of render size, set by every glyph call
 	int bitmap_left;
 	int bitmap_top;
 	int advance;
 	uint8_t *bitmap;
-	uint16_t current_priority;
+	font_bitmap_format_t bitmap_format;
+	font_bitmap_format_t format; // preferred format of cached glyphs
+	uint32_t sdf_scale; // 16.16 scale of distance field to pixel size
+	font_hinting_t hinting;
+	bool size_changed; // unhinted glyphs keep unscaled outline in cache
+	const struct font_prerendered_size *prerendered; // size table entry of prerendered face
+	struct font_advance_table *advances; // allocated by first font_render_glyph_advance
+	font_miss_policy_t miss_policy;
+	font_render_stats_t stats;
+	uint32_t stats_window; // lookups between working set logs, 0 when disabled
+	font_render_stats_t window_stats; // counters at start of window
+	uint32_t window_clock; // cache clock at start of window
 } font_render_t;
 
 
 esp_err_t font_face_init(font_face_t *face, const font_data_t *data, font_data_size_t size);
-void font_face_destroy(font_face_t *face);
+// Face served from data of host/font_prerender without FreeType, data must
+// stay mapped while face is used and renders accept only prerendered sizes
+esp_err_t font_face_init_prerendered(font_face_t *face, const uint8_t *data, size_t size);
+// Renders of face must be destroyed first, ESP_ERR_INVALID_STATE and face is
+// kept while any of them holds glyph of face
+esp_err_t font_face_destroy(font_face_t *face);
 esp_err_t font_face_set_pixel_size(font_face_t *face, font_size_t pixel_size);
 
-esp_err_t font_render_init(font_render_t *render, font_face_t *face, font_size_t pixel_size, uint16_t cache_size);
+// Render must be zero initialized or destroyed, glyph still held by render
+// initialized again is released
+esp_err_t font_render_init(font_render_t *render, font_face_t *face, font_size_t pixel_size);
 void font_render_destroy(font_render_t *render);
+// Glyphs of previous size stay in shared cache until evicted, current glyph
+// is valid until next font_render_glyph call
+esp_err_t font_render_set_pixel_size(font_render_t *render, font_size_t pixel_size);
 esp_err_t font_load_glyph_metrics(font_render_t *render, uint32_t utf_code);
+// With FONT_MISS_PLACEHOLDER uncached glyph returns ESP_ERR_NOT_FINISHED,
+// previous glyph is released, bitmap is empty gray2 and advance is known or
+// estimated, FreeType is not used
 esp_err_t font_render_glyph(font_render_t *render, uint32_t utf_code);
+// Pixel advance of glyph same as font_render_glyph gives, advances are kept in
+// per render table, only hinted renders load glyph outline to measure it
+esp_err_t font_render_glyph_advance(font_render_t *render, uint32_t utf_code, int *advance);
+// Rasterizes current FONT_BITMAP_OUTLINE glyph clipped to target area without
+// intermediate bitmap, x and y are position of bitmap corner like for bitmaps,
+// waits while other task holds FreeType
+esp_err_t font_render_draw_spans(const font_render_t *render, int x, int y, int target_w, int target_h, font_span_func_t callback, void *user_data);
+// Layout of set for pixel size, hinting and format of render, NULL when
+// string was not compiled for them
+const font_string_t *font_render_string(const font_render_t *render, const font_string_set_t *set);
+// Coverage bits per pixel of packed bitmap format, 0 for other formats
+uint8_t font_bitmap_bits(font_bitmap_format_t format);
+// Metrics of glyph loaded by last font_render_glyph call
+const FT_Glyph_Metrics *font_render_glyph_metrics(const font_render_t *render);
+
+// Memory limit of glyph cache shared by all renders
+esp_err_t font_cache_set_budget(size_t budget);
+// Counters of render with current use of shared cache
+void font_render_get_stats(const font_render_t *render, font_render_stats_t *stats);
+void font_render_reset_stats(font_render_t *render);
+// Every lookups glyphs working set of last window is logged, glyphs and bytes
+// of shared cache used since window start with hits, misses and evictions of
+// window, 0 stops logging
+void font_render_set_stats_window(font_render_t *render, uint32_t lookups);
+
+
+// Worker task rasterizing requested glyphs into shared cache, core_id is
+// core of FreeRTOS task
+esp_err_t font_prefetch_start(int core_id);
+void font_prefetch_stop(void);
+// Glyphs are queued for size, format and hinting of render without waiting,
+// ESP_ERR_NO_MEM when queue is full
+esp_err_t font_prefetch_range(const font_render_t *render, uint32_t first, uint32_t last);
+// Consecutive codes are queued as one range
+esp_err_t font_prefetch_glyphs(const font_render_t *render, const uint32_t *codes, size_t count);
+// Waits until all queued glyphs are cached
+void font_prefetch_wait(void);
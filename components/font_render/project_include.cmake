@@ -0,0 +1,145 @@
+include(ExternalProject)
+
+set(FONT_RENDER_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+
+# Builds host tools once per project, their directory is stored to tool_dir,
+# host build runs on every build, so edits of font_render sources relink
+# tools and outputs depending on tool binaries are generated again
+function(font_render_host_tools tool_dir)
+	idf_build_get_property(build_dir BUILD_DIR)
+	set(dir ${build_dir}/font_prerender)
+	if(NOT TARGET font_prerender_host)
+		ExternalProject_Add(font_prerender_host
+			SOURCE_DIR ${FONT_RENDER_DIR}/host
+			BINARY_DIR ${dir}
+			CMAKE_ARGS -DCMAKE_BUILD_TYPE=Release
+			BUILD_ALWAYS 1
+			INSTALL_COMMAND ""
+			BUILD_BYPRODUCTS ${dir}/font_prerender ${dir}/font_strings
+		)
+	endif()
+	set(${tool_dir} ${dir} PARENT_SCOPE)
+endfunction()
+
+
+# Prerenders glyphs of font at build time and embeds result to target, data
+# is available as _binary_<output>_start and _end symbols
+#
+# font_render_prerender(target font output
+#     SIZES 14 16 RANGES 0x20-0x7e [FORMAT gray1|gray2|gray4|gray8|spans] [HINTING default|none])
+function(font_render_prerender target font output)
+	cmake_parse_arguments(PRERENDER "" "FORMAT;HINTING" "SIZES;RANGES" ${ARGN})
+	if(NOT PRERENDER_FORMAT)
+		set(PRERENDER_FORMAT "spans")
+	endif()
+	if(NOT PRERENDER_HINTING)
+		set(PRERENDER_HINTING "default")
+	endif()
+	string(REPLACE ";" "," sizes "${PRERENDER_SIZES}")
+	string(REPLACE ";" "," ranges "${PRERENDER_RANGES}")
+
+	font_render_host_tools(tool_dir)
+
+	get_filename_component(font_path ${font} ABSOLUTE)
+	set(output_path ${CMAKE_CURRENT_BINARY_DIR}/${output})
+	add_custom_command(
+		OUTPUT ${output_path}
+		COMMAND ${tool_dir}/font_prerender ${font_path} ${output_path}
+			--sizes ${sizes} --ranges ${ranges}
+			--format ${PRERENDER_FORMAT} --hinting ${PRERENDER_HINTING}
+		DEPENDS font_prerender_host ${tool_dir}/font_prerender ${font_path}
+		VERBATIM
+	)
+	add_custom_target(${output}_prerender DEPENDS ${output_path})
+	add_dependencies(${target} ${output}_prerender)
+	target_add_binary_data(${target} ${output_path} BINARY)
+endfunction()
+
+
+# Lays out constant strings of STRINGS file at build time and compiles them
+# to target, <output>.h declares font_string_set_t <output>_<name> for every
+# NAME = TEXT line
+#
+# font_render_strings(target font strings output
+#     SIZES 14 16 [FORMAT gray1|gray2|gray4|gray8|spans|outline] [HINTING default|none])
+function(font_render_strings target font strings output)
+	cmake_parse_arguments(STRINGS "" "FORMAT;HINTING" "SIZES" ${ARGN})
+	if(NOT STRINGS_FORMAT)
+		set(STRINGS_FORMAT "spans")
+	endif()
+	if(NOT STRINGS_HINTING)
+		set(STRINGS_HINTING "default")
+	endif()
+	string(REPLACE ";" "," sizes "${STRINGS_SIZES}")
+
+	font_render_host_tools(tool_dir)
+
+	get_filename_component(font_path ${font} ABSOLUTE)
+	get_filename_component(strings_path ${strings} ABSOLUTE)
+	set(output_path ${CMAKE_CURRENT_BINARY_DIR}/${output})
+	add_custom_command(
+		OUTPUT ${output_path}.c ${output_path}.h
+		COMMAND ${tool_dir}/font_strings ${font_path} ${strings_path} ${output_path}
+			--sizes ${sizes}
+			--format ${STRINGS_FORMAT} --hinting ${STRINGS_HINTING}
+		DEPENDS font_prerender_host ${tool_dir}/font_strings ${font_path} ${strings_path}
+		VERBATIM
+	)
+	add_custom_target(${output}_strings DEPENDS ${output_path}.c ${output_path}.h)
+	add_dependencies(${target} ${output}_strings)
+	target_sources(${target} PRIVATE ${output_path}.c)
+	target_include_directories(${target} PRIVATE ${CMAKE_CURRENT_BINARY_DIR})
+endfunction()
+
+
+# Subsets TrueType font to code points with fontTools and embeds result to
+# target as _binary_<output>_start and _end, glyph outlines, hinting and face
+# bounds are kept, so retained glyphs render same as with full font
+#
+# font_render_subset(target font output
+#     UNICODES 0x20-0x7e [DROP_TABLES kern ...] [NO_HINTING])
+#
+# NO_HINTING drops bytecode, renders then have to use FONT_HINTING_NONE
+function(font_render_subset target font output)
+	cmake_parse_arguments(SUBSET "NO_HINTING" "" "UNICODES;DROP_TABLES" ${ARGN})
+	if(NOT SUBSET_DROP_TABLES)
+		# Kerning and layout tables are not used by font_render
+		set(SUBSET_DROP_TABLES kern GPOS GSUB GDEF FFTM)
+	endif()
+	string(REPLACE ";" "," drop_tables "${SUBSET_DROP_TABLES}")
+	string(REGEX REPLACE "0[xX]" "" unicodes "${SUBSET_UNICODES}")
+	string(REPLACE ";" "," unicodes "${unicodes}")
+	set(hinting_option "--hinting")
+	if(SUBSET_NO_HINTING)
+		set(hinting_option "--no-hinting")
+	endif()
+
+	idf_build_get_property(python PYTHON)
+	execute_process(
+		COMMAND ${python} -c "import fontTools.subset"
+		RESULT_VARIABLE fonttools_missing
+		OUTPUT_QUIET ERROR_QUIET
+	)
+	if(fonttools_missing)
+		message(FATAL_ERROR "font_render_subset requires fontTools: ${python} -m pip install fonttools")
+	endif()
+
+	get_filename_component(font_path ${font} ABSOLUTE)
+	set(output_path ${CMAKE_CURRENT_BINARY_DIR}/${output})
+	add_custom_command(
+		OUTPUT ${output_path}
+		COMMAND ${python} -m fontTools.subset ${font_path}
+			--output-file=${output_path}
+			--unicodes=${unicodes}
+			--drop-tables+=${drop_tables}
+			${hinting_option}
+			--no-recalc-bounds
+			--name-IDs=1,2
+		DEPENDS ${font_path}
+		VERBATIM
+	)
+	add_custom_target(${output}_subset DEPENDS ${output_path})
+	add_dependencies(${target} ${output}_subset)
+	target_add_binary_data(${target} ${output_path} BINARY)
+endfunction()
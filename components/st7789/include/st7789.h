@@ -153,28 +153,58 @@ inline st7789_color_t st7789_rgb_to_color(uint8_t r, uint8_t g, uint8_t b) {
 	return (((uint16_t)r >> 3) << 11) | (((uint16_t)g >> 2) << 5) | ((uint16_t)b >> 3);
 }
 */
-extern uint8_t st7789_dither_table[];
-void st7789_randomize_dither_table();
 #define st7789_rgb_to_color(r, g, b) ((((st7789_color_t)(r) >> 3) << 11) | (((st7789_color_t)(g) >> 2) << 5) | ((st7789_color_t)(b) >> 3))
+
+// RGB565 spread to 0b00000gggggg00000rrrrr000000bbbbb, every channel has
+// enough free bits above it to hold 5 bits of fraction after blending
+#define ST7789_SPREAD_MASK           0x07e0f81f
+#define ST7789_SPREAD_FRACTION_MASK  0x03e0f81f
+#define ST7789_SPREAD_CARRY_MASK     0x00200801
+#define ST7789_SPREAD_OVERFLOW_MASK  0x08010020
+// Threshold rounding fraction to nearest value
+#define ST7789_SPREAD_DITHER_ROUND   0x02008010
+
+inline uint32_t __attribute__((always_inline)) st7789_spread_color(st7789_color_t color) {
+	return ((uint32_t)color | ((uint32_t)color << 16)) & ST7789_SPREAD_MASK;
+}
+
+inline st7789_color_t __attribute__((always_inline)) st7789_pack_color(uint32_t value) {
+	return (st7789_color_t)(value | (value >> 16));
+}
+
+// Round spread color with 5 bits of fraction using dither thresholds
+inline st7789_color_t __attribute__((always_inline)) st7789_round_spread(uint32_t value, uint32_t dither) {
+	uint32_t result = ((value >> 5) & ST7789_SPREAD_MASK) + ((((value & ST7789_SPREAD_FRACTION_MASK) + dither) >> 5) & ST7789_SPREAD_CARRY_MASK);
+	// Saturate channels overflowed by dithering
+	const uint32_t overflow = result & ST7789_SPREAD_OVERFLOW_MASK;
+	result |= overflow - ((overflow >> 5) & 0x00000801) - ((overflow >> 6) & 0x00200000);
+	return st7789_pack_color(result & ST7789_SPREAD_MASK);
+}
+
+// 8 bit RGB as spread color with 5 bits of fraction
+#define st7789_rgb_to_spread(r, g, b) (((uint32_t)(r) << 13) | ((uint32_t)(g) << 24) | ((uint32_t)(b) << 2))
+
+typedef enum st7789_dither_mode {
+	ST7789_DITHER_NONE,
+	ST7789_DITHER_BAYER,
+	ST7789_DITHER_BLUE_NOISE,
+} st7789_dither_mode_t;
+
+#define ST7789_DITHER_SIZE 16
+#define ST7789_DITHER_TABLE_SIZE (ST7789_DITHER_SIZE * ST7789_DITHER_SIZE)
+
+// Thresholds of current frame as spread fractions, 16 x 16 tile
+extern uint32_t st7789_dither_table[];
+void st7789_dither_set_mode(st7789_dither_mode_t mode, bool temporal);
+void st7789_dither_next_frame();
+#define st7789_dither_offset(x, y) ((((y) & 0x0f) << 4) | ((x) & 0x0f))
+// Row of dither tile, indexed by x & 0x0f, glyph blitters index tile by
+// position relative to visible corner of glyph
+#define st7789_dither_row(y) (st7789_dither_table + (((y) & 0x0f) << 4))
 inline st7789_color_t __attribute__((always_inline)) st7789_rgb_to_color_dither(uint8_t r, uint8_t g, uint8_t b, uint16_t x, uint16_t y) {
-	const uint8_t pos = ((y << 8) + (y << 3) + x) & 0xff;
-	uint8_t rand_b = st7789_dither_table[pos];
-	const uint8_t rand_r = rand_b & 0x07;
-	rand_b >>= 3;
-	const uint8_t rand_g = rand_b & 0x03;
-	rand_b >>= 2;
-
-	if (r < 249) {
-		r = r + rand_r;
-	}
-	if (g < 253) {
-		g = g + rand_g;
-	}
-	if (b < 249) {
-		b = b + rand_b;
-	}
-	return st7789_rgb_to_color(r, g, b);
+	return st7789_round_spread(st7789_rgb_to_spread(r, g, b), st7789_dither_table[st7789_dither_offset(x, y)]);
 }
+void st7789_rgb_to_color_dither_span(st7789_color_t *target, const uint8_t *rgb, size_t length, uint16_t x, uint16_t y);
 
 inline void __attribute__((always_inline)) st7789_color_to_rgb(st7789_color_t color, uint8_t *r, uint8_t *g, uint8_t *b) {
 	*b = (color << 3);
@@ -187,4 +217,68 @@ inline void __attribute__((always_inline)) st7789_color_to_rgb(st7789_color_t co
 
 //void st7789_color_to_rgb(st7789_color_t color, uint8_t *r, uint8_t *g, uint8_t *b);
 //st7789_color_t st7789_rgb_to_color_dither(uint8_t r, uint8_t g, uint8_t b, uint16_t x, uint16_t y);
+/*
+ * Span encoded gray2 bitmap starts with little endian uint16_t offset of each
+ * row followed by runs. Every run starts with header byte
+ * (type << 6) | (length - 1), partial run continues with packed gray2
+ * coverage of its pixels.
+ */
+#define ST7789_SPAN_TRANSPARENT 0
+#define ST7789_SPAN_SOLID 1
+#define ST7789_SPAN_PARTIAL 2
+
+// Colors of coverage levels blended over known solid background
+typedef struct st7789_gray2_palette {
+	uint32_t values[4];       // spread colors with 5 bits of fraction
+	st7789_color_t colors[4]; // rounded colors used without dithering
+	bool dither;
+} st7789_gray2_palette_t;
+
+// Packed coverage bitmaps of 1, 2, 4 and 8 bits per pixel, each depth has its
+// own loop specialized from one template
+void st7789_draw_gray1_bitmap(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h);
 void st7789_draw_gray2_bitmap(uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h);
+void st7789_draw_gray4_bitmap(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h);
+void st7789_draw_gray8_bitmap(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h);
+void st7789_draw_gray2_spans(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h);
+void st7789_gray2_palette_init(st7789_gray2_palette_t *palette, st7789_color_t background, uint8_t r, uint8_t g, uint8_t b, bool dither);
+// Covered pixels are replaced by palette colors, not blended with target, so
+// output matches blending blitters only where target still holds background,
+// overlapping glyphs (kerning, italics) or text over other drawing differ
+void st7789_draw_gray2_bitmap_palette(const st7789_gray2_palette_t *palette, const uint8_t *src_buf, st7789_color_t *target_buf, int x, int y, int src_w, int src_h, int target_w, int target_h);
+void st7789_draw_gray2_spans_palette(const st7789_gray2_palette_t *palette, const uint8_t *src_buf, st7789_color_t *target_buf, int x, int y, int src_w, int src_h, int target_w, int target_h);
+
+// Foreground premultiplied for each 5 bit coverage level
+typedef struct st7789_coverage_color {
+	uint32_t foreground[33];
+} st7789_coverage_color_t;
+
+void st7789_coverage_color_init(st7789_coverage_color_t *color, uint8_t r, uint8_t g, uint8_t b);
+// Run of pixels with same 8 bit coverage, x and y select dither threshold,
+// they are relative to visible corner of glyph like in other blitters
+void st7789_blend_coverage_span(const st7789_coverage_color_t *color, st7789_color_t *target, uint8_t coverage, uint16_t x, uint16_t y, size_t length);
+// Signed distance field scaled by 16.16 scale, x and y are 24.8 fixed point
+// position of field corner, spread is distance in source pixels of value 0
+void st7789_draw_sdf(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, uint32_t scale, uint8_t spread, int target_w, int target_h);
+
+// Span kernels
+#define ST7789_DITHER_PATTERN_SIZE ST7789_DITHER_TABLE_SIZE
+
+// Linear gradient, channels are 8.16 fixed point values
+typedef struct st7789_gradient {
+	int32_t r;
+	int32_t g;
+	int32_t b;
+	int32_t r_step;
+	int32_t g_step;
+	int32_t b_step;
+} st7789_gradient_t;
+
+void st7789_fill_span(st7789_color_t *target, st7789_color_t color, size_t length);
+void st7789_fill_span_wide(st7789_color_t *target, st7789_color_t color, size_t length);
+void st7789_dither_pattern_init(st7789_color_t *pattern, uint8_t r, uint8_t g, uint8_t b);
+void st7789_fill_span_pattern(st7789_color_t *target, const st7789_color_t *pattern, uint16_t x, uint16_t y, size_t length);
+void st7789_gradient_init(st7789_gradient_t *gradient, uint8_t r0, uint8_t g0, uint8_t b0, uint8_t r1, uint8_t g1, uint8_t b1, size_t length);
+void st7789_fill_span_gradient(st7789_color_t *target, const st7789_gradient_t *gradient, size_t length);
+void st7789_fill_span_gradient_dither(st7789_color_t *target, const st7789_gradient_t *gradient, uint16_t x, uint16_t y, size_t length);
+void st7789_fill_rect(st7789_color_t *target_buf, st7789_color_t color, int x, int y, int w, int h, int target_w, int target_h);
@@ -192,9 +192,7 @@ void st7789_clear(st7789_driver_t *driver, st7789_color_t color) {
 }
 
 void st7789_fill_area(st7789_driver_t *driver, st7789_color_t color, uint16_t start_x, uint16_t start_y, uint16_t width, uint16_t height) {
-	for (size_t i = 0; i < driver->buffer_size * 2; ++i) {
-		driver->buffer[i] = color;
-	}
+	st7789_fill_span(driver->buffer, color, driver->buffer_size * 2);
 	st7789_set_window(driver, start_x, start_y, start_x + width - 1, start_y + height - 1);
 
 	size_t bytes_to_write = width * height * 2;
@@ -273,94 +271,414 @@ void st7789_swap_buffers(st7789_driver_t *driver) {
 }
 
 
-uint8_t st7789_dither_table[256] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+#define ST7789_GRAY2_PIXEL(buf, pos) (((buf)[(pos) >> 2] >> (((pos) & 0x03) << 1)) & 0x03)
+
+
+// Blend with 5 bit weight, foreground is premultiplied with 5 bits of fraction
+static inline st7789_color_t __attribute__((always_inline)) st7789_blend_spread(uint32_t target, uint32_t weight, uint32_t foreground, uint32_t dither) {
+	return st7789_round_spread(target * weight + foreground, dither);
+}
+
+
+// Weight of target pixel for each coverage level (out of 32)
+static const uint8_t target_weights[4] = {32, 16, 8, 0};
+
+
+// Coverage packed from least significant bits, 8 / bits pixels per byte
+#define ST7789_COVERAGE_PIXEL(buf, pos, bits) (((buf)[(pos) / (8 / (bits))] >> (((pos) % (8 / (bits))) * (bits))) & ((1 << (bits)) - 1))
+
+
+// 5 bit alpha of coverage level, gray2 levels keep their original weights,
+// other depths are linear like st7789_blend_coverage_span
+static inline uint32_t __attribute__((always_inline)) st7789_coverage_alpha(const int bits, uint32_t level) {
+	if (bits == 2) {
+		return 32 - target_weights[level];
+	}
+	return (level * (255 / ((1 << bits) - 1)) * 33) >> 8;
+}
+
+
+static inline uint32_t __attribute__((always_inline)) st7789_premultiply(uint8_t r, uint8_t g, uint8_t b, uint32_t alpha) {
+	return (((uint32_t)r * alpha >> 3) << 11) | (((uint32_t)g * alpha >> 2) << 21) | ((uint32_t)b * alpha >> 3);
+}
+
+
+static void st7789_gray2_foreground(uint8_t r, uint8_t g, uint8_t b, uint32_t *foreground) {
+	for (size_t level = 0; level < 4; ++level) {
+		foreground[level] = st7789_premultiply(r, g, b, 32 - target_weights[level]);
+	}
+}
+
+
+static inline st7789_color_t __attribute__((always_inline)) st7789_blend_coverage(const int bits, const uint32_t *foreground, st7789_color_t target, uint32_t level, uint32_t dither) {
+	const uint32_t alpha = st7789_coverage_alpha(bits, level);
+	return st7789_blend_spread(st7789_spread_color(target), 32 - alpha, foreground[bits == 8 ? alpha : level], dither);
+}
+
+
+// Source group skipped at once when all its pixels are transparent, one
+// byte or four 8 bit pixels
+static inline bool __attribute__((always_inline)) st7789_coverage_empty(const int bits, const uint8_t *src_buf, size_t pos) {
+	if (bits == 8) {
+		return (src_buf[pos] | src_buf[pos + 1] | src_buf[pos + 2] | src_buf[pos + 3]) == 0;
+	}
+	return src_buf[pos / (8 / bits)] == 0;
+}
+
+
+/*
+ * Template of packed coverage blitters, bits is constant in every caller, so
+ * each depth is compiled to its own loop without per pixel dispatch. Gray2
+ * output matches previous per channel implementation exactly for transparent
+ * and solid pixels. Partially covered pixels are computed with higher
+ * precision and can differ by 1 LSB per channel.
+ */
+static inline void __attribute__((always_inline)) st7789_draw_coverage_bitmap(const int bits, const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	if (x >= target_w || y >= target_h || x + src_w <= 0 || y + src_h <= 0) {
+		return;
+	}
 
-void st7789_randomize_dither_table() {
-	uint16_t *dither_table = (uint16_t *)st7789_dither_table;
-	for (size_t i = 0; i < sizeof(st7789_dither_table) / 2; ++i) {
-		dither_table[i] = rand() & 0xffff;
+	// Premultiplied foreground by level, 8 bit coverage by 5 bit alpha
+	const size_t group = bits == 8 ? 4 : 8 / bits;
+	const size_t levels = bits == 8 ? 33 : 1 << bits;
+	uint32_t foreground[bits == 8 ? 33 : 1 << bits];
+	for (size_t index = 0; index < levels; ++index) {
+		foreground[index] = st7789_premultiply(r, g, b, bits == 8 ? index : st7789_coverage_alpha(bits, index));
 	}
+
+	const int line_w = MIN(src_w + x, target_w) - MAX(x, 0);
+	const int line_h = MIN(src_h + y, target_h) - MAX(y, 0);
+	size_t src_pos = MAX(-y, 0) * src_w + MAX(-x, 0);
+	st7789_color_t *target = target_buf + MAX(y, 0) * target_w + MAX(x, 0);
+
+	for (int y_pos = 0; y_pos < line_h; ++y_pos) {
+		const uint32_t *dither_row = st7789_dither_row(y_pos);
+		int x_pos = 0;
+
+		// Align target to 32 bits
+		if (((uintptr_t)target & 0x02) && line_w > 0) {
+			const uint32_t level = ST7789_COVERAGE_PIXEL(src_buf, src_pos, bits);
+			if (st7789_coverage_alpha(bits, level)) {
+				target[0] = st7789_blend_coverage(bits, foreground, target[0], level, dither_row[0]);
+			}
+			x_pos++;
+		}
+
+		// Two pixels per word
+		while (x_pos + 1 < line_w) {
+			const size_t pos = src_pos + x_pos;
+			if ((pos % group) == 0 && x_pos + (int)group <= line_w && st7789_coverage_empty(bits, src_buf, pos)) {
+				x_pos += group;
+				continue;
+			}
+			const uint32_t level_lo = ST7789_COVERAGE_PIXEL(src_buf, pos, bits);
+			const uint32_t level_hi = ST7789_COVERAGE_PIXEL(src_buf, pos + 1, bits);
+			const bool visible_lo = st7789_coverage_alpha(bits, level_lo) != 0;
+			const bool visible_hi = st7789_coverage_alpha(bits, level_hi) != 0;
+			if (visible_lo || visible_hi) {
+				uint32_t *pair = (uint32_t *)(target + x_pos);
+				uint32_t pixels = *pair;
+				if (visible_lo) {
+					pixels = (pixels & 0xffff0000) | st7789_blend_coverage(bits, foreground, pixels, level_lo, dither_row[x_pos & 0x0f]);
+				}
+				if (visible_hi) {
+					pixels = (pixels & 0x0000ffff) | ((uint32_t)st7789_blend_coverage(bits, foreground, pixels >> 16, level_hi, dither_row[(x_pos + 1) & 0x0f]) << 16);
+				}
+				*pair = pixels;
+			}
+			x_pos += 2;
+		}
+
+		if (x_pos < line_w) {
+			const uint32_t level = ST7789_COVERAGE_PIXEL(src_buf, src_pos + x_pos, bits);
+			if (st7789_coverage_alpha(bits, level)) {
+				target[x_pos] = st7789_blend_coverage(bits, foreground, target[x_pos], level, dither_row[x_pos & 0x0f]);
+			}
+		}
+
+		src_pos += src_w;
+		target += target_w;
+	}
+}
+
+
+void st7789_draw_gray1_bitmap(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	st7789_draw_coverage_bitmap(1, src_buf, target_buf, r, g, b, x, y, src_w, src_h, target_w, target_h);
 }
 
 
 void st7789_draw_gray2_bitmap(uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	st7789_draw_coverage_bitmap(2, src_buf, target_buf, r, g, b, x, y, src_w, src_h, target_w, target_h);
+}
+
+
+void st7789_draw_gray4_bitmap(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	st7789_draw_coverage_bitmap(4, src_buf, target_buf, r, g, b, x, y, src_w, src_h, target_w, target_h);
+}
+
+
+void st7789_draw_gray8_bitmap(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	st7789_draw_coverage_bitmap(8, src_buf, target_buf, r, g, b, x, y, src_w, src_h, target_w, target_h);
+}
+
+
+void st7789_draw_gray2_spans(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
 	if (x >= target_w || y >= target_h || x + src_w <= 0 || y + src_h <= 0) {
 		return;
 	}
 
-	const size_t src_size = src_w * src_h;
-	const size_t target_size = target_w * target_h;
-	const size_t line_w = MIN(src_w + x, target_w) - MAX(x, 0);
-	const size_t src_skip = src_w - line_w;
-	const size_t target_skip = target_w - line_w;
-	size_t src_pos = 0;
-	size_t target_pos = 0;
-	size_t x_pos = 0;
-	size_t y_pos = 0;
-
-	if (y < 0) {
-		src_pos = (-y) * src_w;
+	uint32_t foreground[4];
+	st7789_gray2_foreground(r, g, b, foreground);
+
+	// Solid color is constant if dithering can't change it
+	const st7789_color_t solid = st7789_blend_spread(0, 0, foreground[3], 0);
+	const bool solid_dithered = solid != st7789_blend_spread(0, 0, foreground[3], ST7789_SPREAD_FRACTION_MASK);
+
+	const int col_start = MAX(-x, 0);
+	const int col_end = MIN(src_w, target_w - x);
+	const int row_start = MAX(-y, 0);
+	const int row_end = MIN(src_h, target_h - y);
+
+	for (int row = row_start; row < row_end; ++row) {
+		const int y_pos = row - row_start;
+		const uint32_t *dither_row = st7789_dither_row(y_pos);
+		const uint8_t *span = src_buf + (src_buf[row << 1] | (src_buf[(row << 1) + 1] << 8));
+		st7789_color_t *target = target_buf + (y + row) * target_w;
+		int col = 0;
+
+		while (col < col_end) {
+			const uint8_t header = *span++;
+			const int length = (header & 0x3f) + 1;
+			const int run_start = MAX(col, col_start);
+			const int run_end = MIN(col + length, col_end);
+
+			switch (header >> 6) {
+				case ST7789_SPAN_SOLID:
+					if (!solid_dithered) {
+						if (run_start < run_end) {
+							st7789_fill_span(target + x + run_start, solid, run_end - run_start);
+						}
+					}
+					else {
+						for (int i = run_start; i < run_end; ++i) {
+							target[x + i] = st7789_blend_spread(0, 0, foreground[3], dither_row[(i - col_start) & 0x0f]);
+						}
+					}
+					break;
+				case ST7789_SPAN_PARTIAL:
+					for (int i = run_start; i < run_end; ++i) {
+						const uint8_t level = ST7789_GRAY2_PIXEL(span, i - col);
+						if (level) {
+							target[x + i] = st7789_blend_spread(st7789_spread_color(target[x + i]), target_weights[level], foreground[level], dither_row[(i - col_start) & 0x0f]);
+						}
+					}
+					span += (length + 3) >> 2;
+					break;
+				default:
+					break;
+			}
+
+			col += length;
+		}
+	}
+}
+
+
+void st7789_gray2_palette_init(st7789_gray2_palette_t *palette, st7789_color_t background, uint8_t r, uint8_t g, uint8_t b, bool dither) {
+	uint32_t foreground[4];
+	st7789_gray2_foreground(r, g, b, foreground);
+	const uint32_t spread_background = st7789_spread_color(background);
+	palette->dither = false;
+	for (size_t level = 0; level < 4; ++level) {
+		palette->values[level] = spread_background * target_weights[level] + foreground[level];
+		// Truncated like by blending blitters with dithering off
+		palette->colors[level] = st7789_round_spread(palette->values[level], 0);
+		// Dithering is skipped when it can't change any color
+		if (dither && palette->colors[level] != st7789_round_spread(palette->values[level], ST7789_SPREAD_FRACTION_MASK)) {
+			palette->dither = true;
+		}
+	}
+}
+
+
+static inline st7789_color_t __attribute__((always_inline)) st7789_palette_color(const st7789_gray2_palette_t *palette, uint8_t level, uint32_t dither) {
+	if (palette->dither) {
+		return st7789_round_spread(palette->values[level], dither);
+	}
+	else {
+		return palette->colors[level];
+	}
+}
+
+
+void st7789_draw_gray2_bitmap_palette(const st7789_gray2_palette_t *palette, const uint8_t *src_buf, st7789_color_t *target_buf, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	if (x >= target_w || y >= target_h || x + src_w <= 0 || y + src_h <= 0) {
+		return;
+	}
+
+	const int line_w = MIN(src_w + x, target_w) - MAX(x, 0);
+	const int line_h = MIN(src_h + y, target_h) - MAX(y, 0);
+	size_t src_pos = MAX(-y, 0) * src_w + MAX(-x, 0);
+	st7789_color_t *target = target_buf + MAX(y, 0) * target_w + MAX(x, 0);
+
+	for (int y_pos = 0; y_pos < line_h; ++y_pos) {
+		const uint32_t *dither_row = st7789_dither_row(y_pos);
+		for (int x_pos = 0; x_pos < line_w; ++x_pos) {
+			const size_t pos = src_pos + x_pos;
+			if ((pos & 0x03) == 0 && x_pos + 4 <= line_w && src_buf[pos >> 2] == 0) {
+				x_pos += 3;
+				continue;
+			}
+			const uint8_t level = ST7789_GRAY2_PIXEL(src_buf, pos);
+			if (level) {
+				target[x_pos] = st7789_palette_color(palette, level, dither_row[x_pos & 0x0f]);
+			}
+		}
+		src_pos += src_w;
+		target += target_w;
+	}
+}
+
+
+void st7789_draw_gray2_spans_palette(const st7789_gray2_palette_t *palette, const uint8_t *src_buf, st7789_color_t *target_buf, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	if (x >= target_w || y >= target_h || x + src_w <= 0 || y + src_h <= 0) {
+		return;
 	}
-	if (x < 0) {
-		src_pos -= x;
+
+	const int col_start = MAX(-x, 0);
+	const int col_end = MIN(src_w, target_w - x);
+	const int row_start = MAX(-y, 0);
+	const int row_end = MIN(src_h, target_h - y);
+
+	for (int row = row_start; row < row_end; ++row) {
+		const int y_pos = row - row_start;
+		const uint32_t *dither_row = st7789_dither_row(y_pos);
+		const uint8_t *span = src_buf + (src_buf[row << 1] | (src_buf[(row << 1) + 1] << 8));
+		st7789_color_t *target = target_buf + (y + row) * target_w;
+		int col = 0;
+
+		while (col < col_end) {
+			const uint8_t header = *span++;
+			const int length = (header & 0x3f) + 1;
+			const int run_start = MAX(col, col_start);
+			const int run_end = MIN(col + length, col_end);
+
+			switch (header >> 6) {
+				case ST7789_SPAN_SOLID:
+					if (!palette->dither) {
+						if (run_start < run_end) {
+							st7789_fill_span(target + x + run_start, palette->colors[3], run_end - run_start);
+						}
+					}
+					else {
+						for (int i = run_start; i < run_end; ++i) {
+							target[x + i] = st7789_palette_color(palette, 3, dither_row[(i - col_start) & 0x0f]);
+						}
+					}
+					break;
+				case ST7789_SPAN_PARTIAL:
+					for (int i = run_start; i < run_end; ++i) {
+						const uint8_t level = ST7789_GRAY2_PIXEL(span, i - col);
+						if (level) {
+							target[x + i] = st7789_palette_color(palette, level, dither_row[(i - col_start) & 0x0f]);
+						}
+					}
+					span += (length + 3) >> 2;
+					break;
+				default:
+					break;
+			}
+
+			col += length;
+		}
 	}
-	if (y > 0) {
-		target_pos = y * target_w;
+}
+
+
+void st7789_coverage_color_init(st7789_coverage_color_t *color, uint8_t r, uint8_t g, uint8_t b) {
+	for (size_t alpha = 0; alpha <= 32; ++alpha) {
+		color->foreground[alpha] = (((uint32_t)r * alpha >> 3) << 11) | (((uint32_t)g * alpha >> 2) << 21) | ((uint32_t)b * alpha >> 3);
 	}
-	if (x > 0) {
-		target_pos += x;
+}
+
+
+void st7789_blend_coverage_span(const st7789_coverage_color_t *color, st7789_color_t *target, uint8_t coverage, uint16_t x, uint16_t y, size_t length) {
+	const uint32_t alpha = ((uint32_t)coverage * 33) >> 8;
+	if (alpha == 0) {
+		return;
 	}
 
-	while (src_pos < src_size && target_pos < target_size) {
-		uint8_t src_r, src_g, src_b;
-		uint8_t target_r, target_g, target_b;
-		st7789_color_to_rgb(target_buf[target_pos], &src_r, &src_g, &src_b);
-		uint8_t gray2_color = (src_buf[src_pos >> 2] >> ((src_pos & 0x03) << 1)) & 0x03;
-		/*
-		static const uint32_t src_weights = 0x002b5580;
-		static const uint32_t target_weights = 0x80552b00;
-		const uint32_t src_weight = (src_weights >> (gray2_color << 3)) & 0xff;
-		const uint32_t target_weight = (target_weights >> (gray2_color << 3)) & 0xff;
-		target_r = ((src_weight * src_r) + (target_weight * r)) >> 7;
-		target_g = ((src_weight * src_g) + (target_weight * g)) >> 7;
-		target_b = ((src_weight * src_b) + (target_weight * b)) >> 7;
-		target_buf[target_pos] = st7789_rgb_to_color_dither(target_r, target_g, target_b, x_pos, y_pos);
-		*/
-		switch(gray2_color) {
-			case 1:
-				target_r = r >> 1;
-				target_g = g >> 1;
-				target_b = b >> 1;
-				src_r = (src_r >> 1) + target_r;
-				src_g = (src_g >> 1) + target_g;
-				src_b = (src_b >> 1) + target_b;
-				target_buf[target_pos] = st7789_rgb_to_color_dither(src_r, src_g, src_b, x_pos, y_pos);
-				break;
-			case 2:
-				target_r = r >> 2;
-				target_g = g >> 2;
-				target_b = b >> 2;
-				src_r = (src_r >> 2) + target_r + target_r + target_r;
-				src_g = (src_g >> 2) + target_g + target_g + target_g;
-				src_b = (src_b >> 2) + target_b + target_b + target_b;
-				target_buf[target_pos] = st7789_rgb_to_color_dither(src_r, src_g, src_b, x_pos, y_pos);
-				break;
-			case 3:
-				target_buf[target_pos] = st7789_rgb_to_color_dither(r, g, b, x_pos, y_pos);
-				break;
-			default:
-				break;
+	const uint32_t *dither_row = st7789_dither_row(y);
+	if (alpha == 32) {
+		for (size_t i = 0; i < length; ++i) {
+			target[i] = st7789_blend_spread(0, 0, color->foreground[32], dither_row[(x + i) & 0x0f]);
+		}
+	}
+	else {
+		for (size_t i = 0; i < length; ++i) {
+			target[i] = st7789_blend_spread(st7789_spread_color(target[i]), 32 - alpha, color->foreground[alpha], dither_row[(x + i) & 0x0f]);
 		}
+	}
+}
+
+
+// Distance field value with 8 bits of fraction, zero outside of source
+static inline int32_t __attribute__((always_inline)) st7789_sdf_texel(const uint8_t *src_buf, int u, int v, int src_w, int src_h) {
+	if (u < 0 || v < 0 || u >= src_w || v >= src_h) {
+		return 0;
+	}
+	return src_buf[v * src_w + u];
+}
 
-		x_pos++;
 
-		if (x_pos == line_w) {
-			x_pos = 0;
-			y_pos++;
-			src_pos += src_skip;
-			target_pos += target_skip;
+void st7789_draw_sdf(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, uint32_t scale, uint8_t spread, int target_w, int target_h) {
+	if (scale == 0) {
+		return;
+	}
+
+	const int x_end = x + (int)(((int64_t)src_w * scale) >> 8);
+	const int y_end = y + (int)(((int64_t)src_h * scale) >> 8);
+	const int col_start = MAX(x >> 8, 0);
+	const int col_end = MIN((x_end + 0xff) >> 8, target_w);
+	const int row_start = MAX(y >> 8, 0);
+	const int row_end = MIN((y_end + 0xff) >> 8, target_h);
+	if (col_start >= col_end || row_start >= row_end) {
+		return;
+	}
+
+	st7789_coverage_color_t color;
+	st7789_coverage_color_init(&color, r, g, b);
+	const uint32_t *foreground = color.foreground;
+
+	// Source step per target pixel and coverage slope, both 16.16
+	const int32_t step = (int32_t)((((uint64_t)1) << 32) / scale);
+	const int32_t slope = (int32_t)(((int64_t)spread * 32 * scale / 127) >> 4);
+
+	for (int row = row_start; row < row_end; ++row) {
+		const uint32_t *dither_row = st7789_dither_row(row - row_start);
+		st7789_color_t *target = target_buf + row * target_w;
+		// Pixel centers mapped to texel centers
+		const int32_t v = (int32_t)((((int64_t)((row << 8) + 128 - y)) * step) >> 8) - 0x8000;
+		const int v0 = v >> 16;
+		const int32_t fv = (v >> 8) & 0xff;
+		int32_t u = (int32_t)((((int64_t)((col_start << 8) + 128 - x)) * step) >> 8) - 0x8000;
+
+		for (int col = col_start; col < col_end; ++col, u += step) {
+			const int u0 = u >> 16;
+			const int32_t fu = (u >> 8) & 0xff;
+			const int32_t top = st7789_sdf_texel(src_buf, u0, v0, src_w, src_h) * (256 - fu) + st7789_sdf_texel(src_buf, u0 + 1, v0, src_w, src_h) * fu;
+			const int32_t bottom = st7789_sdf_texel(src_buf, u0, v0 + 1, src_w, src_h) * (256 - fu) + st7789_sdf_texel(src_buf, u0 + 1, v0 + 1, src_w, src_h) * fu;
+			const int32_t distance = ((top * (256 - fv) + bottom * fv) >> 8) - 0x8000;
+			const int32_t alpha = 16 + (((distance >> 4) * slope) >> 16);
+			if (alpha <= 0) {
+				continue;
+			}
+			if (alpha >= 32) {
+				target[col] = st7789_blend_spread(0, 0, foreground[32], dither_row[(col - col_start) & 0x0f]);
+			}
+			else {
+				target[col] = st7789_blend_spread(st7789_spread_color(target[col]), 32 - alpha, foreground[alpha], dither_row[(col - col_start) & 0x0f]);
+			}
 		}
-		src_pos++;
-		target_pos++;
 	}
 }
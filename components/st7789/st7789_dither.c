@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "st7789.h"
+
+
+// Golden ratio step of thresholds between frames
+#define ST7789_DITHER_TEMPORAL_STEP 159
+
+
+static const uint8_t bayer_matrix[ST7789_DITHER_TABLE_SIZE] = {
+	  0, 128,  32, 160,   8, 136,  40, 168,   2, 130,  34, 162,  10, 138,  42, 170,
+	192,  64, 224,  96, 200,  72, 232, 104, 194,  66, 226,  98, 202,  74, 234, 106,
+	 48, 176,  16, 144,  56, 184,  24, 152,  50, 178,  18, 146,  58, 186,  26, 154,
+	240, 112, 208,  80, 248, 120, 216,  88, 242, 114, 210,  82, 250, 122, 218,  90,
+	 12, 140,  44, 172,   4, 132,  36, 164,  14, 142,  46, 174,   6, 134,  38, 166,
+	204,  76, 236, 108, 196,  68, 228, 100, 206,  78, 238, 110, 198,  70, 230, 102,
+	 60, 188,  28, 156,  52, 180,  20, 148,  62, 190,  30, 158,  54, 182,  22, 150,
+	252, 124, 220,  92, 244, 116, 212,  84, 254, 126, 222,  94, 246, 118, 214,  86,
+	  3, 131,  35, 163,  11, 139,  43, 171,   1, 129,  33, 161,   9, 137,  41, 169,
+	195,  67, 227,  99, 203,  75, 235, 107, 193,  65, 225,  97, 201,  73, 233, 105,
+	 51, 179,  19, 147,  59, 187,  27, 155,  49, 177,  17, 145,  57, 185,  25, 153,
+	243, 115, 211,  83, 251, 123, 219,  91, 241, 113, 209,  81, 249, 121, 217,  89,
+	 15, 143,  47, 175,   7, 135,  39, 167,  13, 141,  45, 173,   5, 133,  37, 165,
+	207,  79, 239, 111, 199,  71, 231, 103, 205,  77, 237, 109, 197,  69, 229, 101,
+	 63, 191,  31, 159,  55, 183,  23, 151,  61, 189,  29, 157,  53, 181,  21, 149,
+	255, 127, 223,  95, 247, 119, 215,  87, 253, 125, 221,  93, 245, 117, 213,  85,
+};
+
+// Void and cluster, sigma 1.5
+static const uint8_t blue_noise_matrix[ST7789_DITHER_TABLE_SIZE] = {
+	234,  50, 188,  19,  58, 171, 121,  47, 163,   3, 247, 104,  22, 132,  14,  65,
+	209,   8, 118,  97, 240, 205,  23, 228, 138,  64, 123, 170,  72, 224,  99, 149,
+	 85, 139, 229, 165,  78, 146, 111,  84, 176, 216,  30, 231, 153, 201,  42, 180,
+	 25,  62, 195,  29,  43, 185,   7, 249,  41, 100, 191,  48,  87,   5, 128, 243,
+	221, 152, 101, 253, 130, 220,  59, 200, 156,  12, 136, 112, 254, 174,  69, 109,
+	 46, 189,   2,  73, 172,  90, 142, 116,  80, 237, 210,  61, 147,  33, 206, 160,
+	 81, 124, 217, 113, 208,  15, 241,  27, 168,  45, 178,  20, 193,  96, 225,  18,
+	242, 164,  60,  35, 157,  53, 181,  68, 223, 105, 125,  83, 236, 131,  55, 141,
+	197,  10, 227, 134, 246,  95, 126, 198, 148,   1, 244, 161,  71,   9, 182, 106,
+	 40,  93, 179,  75, 192,   6, 218,  36,  91,  57, 202,  34, 215, 155, 233,  74,
+	252, 120, 150,  24, 110,  63, 166, 119, 232, 183, 133, 103,  49, 117,  31, 167,
+	 16, 212,  51, 238, 207, 137, 255,  21,  76, 151,  13, 250, 190,  88, 203, 135,
+	102, 184,  82, 169,  38,  89, 187,  52, 204,  98, 173,  67, 129,   4, 222,  56,
+	230, 144,   0, 127, 226,  11, 154, 114, 239,  39, 219,  28, 235, 145, 175,  77,
+	196,  37, 248,  70, 107, 199,  66, 177,  17, 143, 115, 159,  86,  44, 108,  26,
+	122,  92, 158, 214, 140,  32, 245,  94, 213,  79, 194,  54, 211, 186, 251, 162,
+};
+
+
+uint32_t st7789_dither_table[ST7789_DITHER_TABLE_SIZE] = {0};
+
+static const uint8_t *dither_matrix = NULL;
+static bool dither_temporal = false;
+static uint8_t dither_phase = 0;
+
+
+static void st7789_dither_update_table() {
+	if (dither_matrix == NULL) {
+		memset(st7789_dither_table, 0, sizeof(st7789_dither_table));
+		return;
+	}
+	for (size_t i = 0; i < ST7789_DITHER_TABLE_SIZE; ++i) {
+		const uint32_t threshold = (uint8_t)(dither_matrix[i] + dither_phase) >> 3;
+		st7789_dither_table[i] = (threshold << 21) | (threshold << 11) | threshold;
+	}
+}
+
+
+void st7789_dither_set_mode(st7789_dither_mode_t mode, bool temporal) {
+	switch (mode) {
+		case ST7789_DITHER_BAYER:
+			dither_matrix = bayer_matrix;
+			break;
+		case ST7789_DITHER_BLUE_NOISE:
+			dither_matrix = blue_noise_matrix;
+			break;
+		default:
+			dither_matrix = NULL;
+			break;
+	}
+	dither_temporal = temporal;
+	dither_phase = 0;
+	st7789_dither_update_table();
+}
+
+
+void st7789_dither_next_frame() {
+	if (!dither_temporal || dither_matrix == NULL) {
+		return;
+	}
+	dither_phase += ST7789_DITHER_TEMPORAL_STEP;
+	st7789_dither_update_table();
+}
+
+
+void st7789_rgb_to_color_dither_span(st7789_color_t *target, const uint8_t *rgb, size_t length, uint16_t x, uint16_t y) {
+	const uint32_t *dither_row = st7789_dither_row(y);
+	for (size_t i = 0; i < length; ++i) {
+		target[i] = st7789_round_spread(st7789_rgb_to_spread(rgb[0], rgb[1], rgb[2]), dither_row[x & 0x0f]);
+		rgb += 3;
+		x++;
+	}
+}
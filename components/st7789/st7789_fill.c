@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "st7789.h"
+
+
+void st7789_fill_span(st7789_color_t *target, st7789_color_t color, size_t length) {
+	if (((uintptr_t)target & 0x02) && length > 0) {
+		*target++ = color;
+		length--;
+	}
+
+	const uint32_t pair = (uint32_t)color | ((uint32_t)color << 16);
+	uint32_t *target_pairs = (uint32_t *)target;
+	size_t pairs = length >> 1;
+	while (pairs >= 4) {
+		target_pairs[0] = pair;
+		target_pairs[1] = pair;
+		target_pairs[2] = pair;
+		target_pairs[3] = pair;
+		target_pairs += 4;
+		pairs -= 4;
+	}
+	while (pairs > 0) {
+		*target_pairs++ = pair;
+		pairs--;
+	}
+
+	if (length & 0x01) {
+		target[length - 1] = color;
+	}
+}
+
+
+void st7789_fill_span_wide(st7789_color_t *target, st7789_color_t color, size_t length) {
+	while (((uintptr_t)target & 0x07) && length > 0) {
+		*target++ = color;
+		length--;
+	}
+
+	const uint32_t pair = (uint32_t)color | ((uint32_t)color << 16);
+	const uint64_t quad = (uint64_t)pair | ((uint64_t)pair << 32);
+	uint64_t *target_quads = (uint64_t *)target;
+	for (size_t i = 0; i < (length >> 2); ++i) {
+		target_quads[i] = quad;
+	}
+
+	target += length & ~(size_t)0x03;
+	for (size_t i = 0; i < (length & 0x03); ++i) {
+		target[i] = color;
+	}
+}
+
+
+// Dithered solid color for every position in dither tile
+void st7789_dither_pattern_init(st7789_color_t *pattern, uint8_t r, uint8_t g, uint8_t b) {
+	const uint32_t color = st7789_rgb_to_spread(r, g, b);
+	for (size_t i = 0; i < ST7789_DITHER_PATTERN_SIZE; ++i) {
+		pattern[i] = st7789_round_spread(color, st7789_dither_table[i]);
+	}
+}
+
+
+void st7789_fill_span_pattern(st7789_color_t *target, const st7789_color_t *pattern, uint16_t x, uint16_t y, size_t length) {
+	const st7789_color_t *pattern_row = pattern + st7789_dither_offset(0, y);
+	size_t offset = x & 0x0f;
+	while (length > 0) {
+		const size_t chunk = MIN(length, ST7789_DITHER_SIZE - offset);
+		memcpy(target, pattern_row + offset, chunk * sizeof(st7789_color_t));
+		target += chunk;
+		length -= chunk;
+		offset = 0;
+	}
+}
+
+
+void st7789_gradient_init(st7789_gradient_t *gradient, uint8_t r0, uint8_t g0, uint8_t b0, uint8_t r1, uint8_t g1, uint8_t b1, size_t length) {
+	gradient->r = (int32_t)r0 << 16;
+	gradient->g = (int32_t)g0 << 16;
+	gradient->b = (int32_t)b0 << 16;
+	gradient->r_step = length ? ((int32_t)r1 - r0) * 65536 / (int32_t)length : 0;
+	gradient->g_step = length ? ((int32_t)g1 - g0) * 65536 / (int32_t)length : 0;
+	gradient->b_step = length ? ((int32_t)b1 - b0) * 65536 / (int32_t)length : 0;
+}
+
+
+void st7789_fill_span_gradient(st7789_color_t *target, const st7789_gradient_t *gradient, size_t length) {
+	int32_t r = gradient->r;
+	int32_t g = gradient->g;
+	int32_t b = gradient->b;
+	for (size_t i = 0; i < length; ++i) {
+		target[i] = st7789_rgb_to_color(r >> 16, g >> 16, b >> 16);
+		r += gradient->r_step;
+		g += gradient->g_step;
+		b += gradient->b_step;
+	}
+}
+
+
+void st7789_fill_span_gradient_dither(st7789_color_t *target, const st7789_gradient_t *gradient, uint16_t x, uint16_t y, size_t length) {
+	const uint32_t *dither_row = st7789_dither_row(y);
+	int32_t r = gradient->r;
+	int32_t g = gradient->g;
+	int32_t b = gradient->b;
+	for (size_t i = 0; i < length; ++i) {
+		target[i] = st7789_round_spread(st7789_rgb_to_spread(r >> 16, g >> 16, b >> 16), dither_row[(x + i) & 0x0f]);
+		r += gradient->r_step;
+		g += gradient->g_step;
+		b += gradient->b_step;
+	}
+}
+
+
+// Rectangle with y relative to target strip
+void st7789_fill_rect(st7789_color_t *target_buf, st7789_color_t color, int x, int y, int w, int h, int target_w, int target_h) {
+	const int x_start = MAX(x, 0);
+	const int x_end = MIN(x + w, target_w);
+	const int y_start = MAX(y, 0);
+	const int y_end = MIN(y + h, target_h);
+	if (x_start >= x_end || y_start >= y_end) {
+		return;
+	}
+
+	if (x_start == 0 && x_end == target_w) {
+		st7789_fill_span(target_buf + y_start * target_w, color, (y_end - y_start) * target_w);
+		return;
+	}
+
+	for (int row = y_start; row < y_end; ++row) {
+		st7789_fill_span(target_buf + row * target_w + x_start, color, x_end - x_start);
+	}
+}
@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: MIT
+
+// Checks UTF-8 decoding of well-formed and ill-formed input with every
+// invalid policy, replacement follows maximal subparts of Unicode chapter 3,
+// and line breaking with cases of LineBreakTest-14.0.0.txt
+//
+// unicode_test
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unicode.h"
+
+
+#define UNICODE_TEST_MAX_CODES 16
+#define R U8_REPLACEMENT_CHARACTER
+
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+		failures++; \
+	} \
+} while (0)
+
+
+// Expected codes of one input for each policy, stop also gives consumed
+// bytes and status
+typedef struct unicode_test_case {
+	const char *name;
+	const char *text;
+	uint32_t replace[UNICODE_TEST_MAX_CODES];
+	size_t replace_count;
+	uint32_t skip[UNICODE_TEST_MAX_CODES];
+	size_t skip_count;
+	size_t stop_count;
+	size_t stop_consumed;
+	u8_decode_status_t stop_status;
+} unicode_test_case_t;
+
+
+static const unicode_test_case_t unicode_test_cases[] = {
+	{"well-formed", "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80",
+		{'a', 0xe9, 0x20ac, 0x1f600}, 4, {'a', 0xe9, 0x20ac, 0x1f600}, 4, 4, 10, U8_DECODE_OK},
+	{"boundaries", "\xc2\x80\xdf\xbf\xe0\xa0\x80\xef\xbf\xbf\xf0\x90\x80\x80\xf4\x8f\xbf\xbf",
+		{0x80, 0x7ff, 0x800, 0xffff, 0x10000, 0x10ffff}, 6, {0x80, 0x7ff, 0x800, 0xffff, 0x10000, 0x10ffff}, 6, 6, 18, U8_DECODE_OK},
+	// Overlong lead bytes C0 and C1 are never valid, E0 and F0 reject low
+	// continuation
+	{"overlong 2", "a\xc0\xafz",
+		{'a', R, R, 'z'}, 4, {'a', 'z'}, 2, 1, 1, U8_DECODE_INVALID},
+	{"overlong 3", "a\xe0\x80\xafz",
+		{'a', R, R, R, 'z'}, 5, {'a', 'z'}, 2, 1, 1, U8_DECODE_INVALID},
+	{"overlong 4", "a\xf0\x80\x80\xafz",
+		{'a', R, R, R, R, 'z'}, 6, {'a', 'z'}, 2, 1, 1, U8_DECODE_INVALID},
+	{"surrogate", "a\xed\xa0\x80z",
+		{'a', R, R, R, 'z'}, 5, {'a', 'z'}, 2, 1, 1, U8_DECODE_INVALID},
+	{"beyond U+10FFFF", "a\xf4\x90\x80\x80z",
+		{'a', R, R, R, R, 'z'}, 6, {'a', 'z'}, 2, 1, 1, U8_DECODE_INVALID},
+	{"invalid lead", "a\xf5\xffz",
+		{'a', R, R, 'z'}, 4, {'a', 'z'}, 2, 1, 1, U8_DECODE_INVALID},
+	{"lone continuation", "\x80\xbf" "a",
+		{R, R, 'a'}, 3, {'a'}, 1, 0, 0, U8_DECODE_INVALID},
+	// Sequence broken by ASCII is one maximal subpart, ASCII byte starts next
+	{"interrupted", "a\xe2\x82z",
+		{'a', R, 'z'}, 3, {'a', 'z'}, 2, 1, 1, U8_DECODE_INVALID},
+	{"interrupted 4", "\xf0\x9f\x98" "a\xf0\x9f" "b",
+		{R, 'a', R, 'b'}, 4, {'a', 'b'}, 2, 0, 0, U8_DECODE_INVALID},
+	// End of input inside sequence
+	{"truncated 2", "a\xc3",
+		{'a', R}, 2, {'a'}, 1, 1, 1, U8_DECODE_TRUNCATED},
+	{"truncated 3", "a\xe2\x82",
+		{'a', R}, 2, {'a'}, 1, 1, 1, U8_DECODE_TRUNCATED},
+	{"truncated 4", "a\xf0\x9f\x98",
+		{'a', R}, 2, {'a'}, 1, 1, 1, U8_DECODE_TRUNCATED},
+	// Prefix of ill-formed sequence is already ill-formed
+	{"truncated surrogate", "a\xed\xa0",
+		{'a', R, R}, 3, {'a'}, 1, 1, 1, U8_DECODE_INVALID},
+};
+
+
+static void unicode_test_case(const unicode_test_case_t *test) {
+	const size_t length = strlen(test->text);
+	uint32_t codes[UNICODE_TEST_MAX_CODES];
+	size_t consumed;
+	u8_decode_status_t status;
+
+	size_t count = u8_decode_buffer(codes, UNICODE_TEST_MAX_CODES, test->text, length, U8_INVALID_REPLACE, &consumed, &status);
+	if (count != test->replace_count || memcmp(codes, test->replace, count * sizeof(uint32_t)) != 0 || consumed != length || status != U8_DECODE_OK) {
+		fprintf(stderr, "%s: replace gives %zu codes of %zu bytes\n", test->name, count, consumed);
+		failures++;
+	}
+
+	count = u8_decode_buffer(codes, UNICODE_TEST_MAX_CODES, test->text, length, U8_INVALID_SKIP, &consumed, &status);
+	if (count != test->skip_count || memcmp(codes, test->skip, count * sizeof(uint32_t)) != 0 || consumed != length || status != U8_DECODE_OK) {
+		fprintf(stderr, "%s: skip gives %zu codes of %zu bytes\n", test->name, count, consumed);
+		failures++;
+	}
+
+	count = u8_decode_buffer(codes, UNICODE_TEST_MAX_CODES, test->text, length, U8_INVALID_STOP, &consumed, &status);
+	if (count != test->stop_count || memcmp(codes, test->replace, count * sizeof(uint32_t)) != 0 || consumed != test->stop_consumed || status != test->stop_status) {
+		fprintf(stderr, "%s: stop gives %zu codes of %zu bytes, status %d\n", test->name, count, consumed, (int)status);
+		failures++;
+	}
+
+	// Single code decoder of NUL terminated text agrees with replace policy,
+	// truncated sequence ends at NUL
+	count = 0;
+	for (const char *pos = test->text; *pos && count < UNICODE_TEST_MAX_CODES;) {
+		pos += u8_decode(&codes[count++], pos);
+	}
+	if (count != test->replace_count || memcmp(codes, test->replace, count * sizeof(uint32_t)) != 0) {
+		fprintf(stderr, "%s: u8_decode gives %zu codes\n", test->name, count);
+		failures++;
+	}
+}
+
+
+// Text split at every byte is decoded in chunks, truncated tail is carried
+// to next chunk like by stream reader
+static void unicode_test_stream(void) {
+	const char *text = "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80z";
+	const uint32_t expected[] = {'a', 0xe9, 0x20ac, 0x1f600, 'z'};
+	const size_t length = strlen(text);
+	for (size_t split = 0; split <= length; ++split) {
+		uint32_t codes[UNICODE_TEST_MAX_CODES];
+		size_t consumed;
+		u8_decode_status_t status;
+		size_t count = u8_decode_buffer(codes, UNICODE_TEST_MAX_CODES, text, split, U8_INVALID_STOP, &consumed, &status);
+		CHECK(status != U8_DECODE_INVALID);
+		CHECK(status == U8_DECODE_OK || split - consumed < 4);
+		count += u8_decode_buffer(codes + count, UNICODE_TEST_MAX_CODES - count, text + consumed, length - consumed, U8_INVALID_STOP, &consumed, &status);
+		CHECK(status == U8_DECODE_OK);
+		CHECK(count == sizeof(expected) / sizeof(expected[0]));
+		CHECK(memcmp(codes, expected, sizeof(expected)) == 0);
+	}
+}
+
+
+static void unicode_test_capacity(void) {
+	uint32_t codes[2];
+	size_t consumed;
+	u8_decode_status_t status;
+	// Capacity ends decoding before multibyte code, not in middle of it
+	CHECK(u8_decode_buffer(codes, 2, "a\xc3\xa9z", 4, U8_INVALID_STOP, &consumed, &status) == 2);
+	CHECK(consumed == 3);
+	CHECK(status == U8_DECODE_OK);
+	CHECK(codes[1] == 0xe9);
+	// Word copy of ASCII stops at capacity
+	CHECK(u8_decode_buffer(codes, 2, "abcdefgh", 8, U8_INVALID_STOP, &consumed, &status) == 2);
+	CHECK(consumed == 2);
+	CHECK(u8_decode_buffer(codes, 2, "", 0, U8_INVALID_STOP, &consumed, &status) == 0);
+	CHECK(consumed == 0);
+	CHECK(status == U8_DECODE_OK);
+}
+
+
+static void unicode_test_encode(void) {
+	const uint32_t codes[] = {0, 0x7f, 0x80, 0x7ff, 0x800, 0xffff, 0x10000, 0x10ffff};
+	for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i) {
+		char text[5] = {0};
+		const uint8_t length = u8_encode(text, codes[i]);
+		uint32_t code;
+		CHECK(length > 0);
+		CHECK(u8_decode_buffer(&code, 1, text, length, U8_INVALID_STOP, NULL, NULL) == 1);
+		CHECK(code == codes[i]);
+	}
+	char text[5];
+	CHECK(u8_encode(text, 0x110000) == 0);
+}
+
+
+// Lines of LineBreakTest.txt, × forbids and ÷ allows break before next code,
+// last mark is end of text
+static const char *unicode_test_line_breaks[] = {
+	// LB4, LB5 hard line ends, CR LF is kept together
+	"× 000D × 000A ÷",
+	"× 000D ÷ 0023 ÷",
+	"× 000A ÷ 000A ÷",
+	"× 000B ÷ 0023 ÷",
+	"× 0023 × 0020 × 000D × 000A ÷ 0023 ÷",
+	// LB7, LB18 space runs, break comes after last space
+	"× 0020 ÷ 0023 ÷",
+	"× 0023 × 0020 ÷ 0023 ÷",
+	"× 0023 × 0020 × 0020 × 0020 ÷ 0023 ÷",
+	"× 0023 × 0020 × 000A ÷",
+	// LB8, LB13, LB14, LB15 keep their classes across spaces
+	"× 0023 × 0020 × 200B ÷ 0023 ÷",
+	"× 0023 × 0020 × 007D ÷",
+	"× 0028 × 0020 × 0023 ÷",
+	"× 0022 × 0020 × 0028 ÷",
+	// LB9, LB10 combining mark joins base, after space it's alphabetic
+	"× 0023 × 0308 × 0023 ÷",
+	"× 0020 ÷ 0308 ÷",
+	"× 0023 × 0020 ÷ 0308 ÷",
+	"× 0030 × 0308 × 0023 ÷",
+	// LB8a no break after ZWJ
+	"× 200D × 231A ÷",
+	"× 0023 × 200D × 0023 ÷",
+	"× 0020 ÷ 200D × 0023 ÷",
+	"× 0023 ÷ 231A ÷",
+	// LB21a no break after hyphen following Hebrew letter
+	"× 05D0 × 002D × 0023 ÷",
+	"× 05D0 × 0009 × 05D0 ÷",
+	"× 0023 × 002D ÷ 0023 ÷",
+	// LB30a regional indicators are paired
+	"× 1F1F7 × 1F1FA ÷ 1F1F8 ÷",
+	"× 1F1F7 × 1F1FA ÷ 1F1F8 × 1F1EA ÷",
+	"× 1F1F7 × 0308 × 1F1FA ÷ 1F1F8 ÷",
+};
+
+
+// Every code of line is fed to iterator, break before it must match mark
+static void unicode_test_line_break(const char *line) {
+	u8_line_break_t state;
+	u8_line_break_init(&state);
+	const char *pos = line;
+	size_t index = 0;
+	for (;;) {
+		const bool allowed = strncmp(pos, "÷", strlen("÷")) == 0;
+		pos = strchr(pos, ' ');
+		if (!pos) {
+			break;
+		}
+		char *end;
+		const uint32_t code = strtoul(pos + 1, &end, 16);
+		pos = end + 1;
+		// Mandatory and allowed breaks are both ÷
+		if ((u8_line_break_next(&state, code) != U8_BREAK_PROHIBITED) != allowed) {
+			fprintf(stderr, "%s: break before code %zu is %s\n", line, index, allowed ? "prohibited" : "allowed");
+			failures++;
+		}
+		index++;
+	}
+}
+
+
+// Folded plane 14 keeps tags and variation selectors, planes 2 and 3 are
+// ideographic, other planes alphabetic
+static void unicode_test_line_break_class(void) {
+	CHECK(u8_line_break_class(0x20000) == U8_LB_ID);
+	CHECK(u8_line_break_class(0x2a6df) == U8_LB_ID);
+	CHECK(u8_line_break_class(0x2fffd) == U8_LB_ID);
+	CHECK(u8_line_break_class(0x30000) == U8_LB_ID);
+	CHECK(u8_line_break_class(0x3fffd) == U8_LB_ID);
+	CHECK(u8_line_break_class(0xe0001) == U8_LB_CM);
+	CHECK(u8_line_break_class(0xe0020) == U8_LB_CM);
+	CHECK(u8_line_break_class(0xe007f) == U8_LB_CM);
+	CHECK(u8_line_break_class(0xe0100) == U8_LB_CM);
+	CHECK(u8_line_break_class(0xe01ef) == U8_LB_CM);
+	CHECK(u8_line_break_class(0xe01f0) == U8_LB_AL);
+	CHECK(u8_line_break_class(0xe1000) == U8_LB_AL);
+	CHECK(u8_line_break_class(0x10ffff) == U8_LB_AL);
+	// Below folded range table is used directly
+	CHECK(u8_line_break_class(0x1f1e6) == U8_LB_RI);
+	CHECK(u8_line_break_class(0x1fffd) == U8_LB_ID);
+}
+
+
+int main(void) {
+	for (size_t i = 0; i < sizeof(unicode_test_cases) / sizeof(unicode_test_cases[0]); ++i) {
+		unicode_test_case(&unicode_test_cases[i]);
+	}
+	unicode_test_stream();
+	unicode_test_capacity();
+	unicode_test_encode();
+	for (size_t i = 0; i < sizeof(unicode_test_line_breaks) / sizeof(unicode_test_line_breaks[0]); ++i) {
+		unicode_test_line_break(unicode_test_line_breaks[i]);
+	}
+	unicode_test_line_break_class();
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("unicode_test: all checks passed\n");
+	return 0;
+}
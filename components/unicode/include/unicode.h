@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define U8_REPLACEMENT_CHARACTER 0xfffd
+
+
+// What bulk decoder does with ill-formed sequence
+typedef enum u8_invalid_policy {
+	// Each maximal ill-formed subpart becomes U8_REPLACEMENT_CHARACTER
+	U8_INVALID_REPLACE,
+	// Ill-formed bytes are dropped
+	U8_INVALID_SKIP,
+	// Decoding stops before ill-formed or truncated sequence
+	U8_INVALID_STOP,
+} u8_invalid_policy_t;
+
+// Where bulk decoder stopped, only U8_INVALID_STOP stops before end of input
+// or capacity
+typedef enum u8_decode_status {
+	// Input decoded up to its end or capacity
+	U8_DECODE_OK,
+	// Sequence is cut by end of input, following bytes may complete it
+	U8_DECODE_TRUNCATED,
+	// Ill-formed sequence, it stays ill-formed whatever follows
+	U8_DECODE_INVALID,
+} u8_decode_status_t;
+
+
+// Line break classes of UAX #14 resolved by rule LB1, classes before
+// U8_LB_CM are looked up in pair table, order is shared with unicode_tables.py
+typedef enum u8_line_break_class {
+	U8_LB_OP,
+	U8_LB_CL,
+	U8_LB_CP,
+	U8_LB_QU,
+	U8_LB_GL,
+	U8_LB_NS,
+	U8_LB_EX,
+	U8_LB_SY,
+	U8_LB_IS,
+	U8_LB_PR,
+	U8_LB_PO,
+	U8_LB_NU,
+	U8_LB_AL,
+	U8_LB_HL,
+	U8_LB_ID,
+	U8_LB_IN,
+	U8_LB_HY,
+	U8_LB_BA,
+	U8_LB_BB,
+	U8_LB_B2,
+	U8_LB_ZW,
+	U8_LB_WJ,
+	U8_LB_H2,
+	U8_LB_H3,
+	U8_LB_JL,
+	U8_LB_JV,
+	U8_LB_JT,
+	U8_LB_RI,
+	U8_LB_EB,
+	U8_LB_EM,
+	U8_LB_CB,
+	U8_LB_CM,
+	U8_LB_ZWJ,
+	U8_LB_SP,
+	U8_LB_BK,
+	U8_LB_CR,
+	U8_LB_LF,
+	U8_LB_NL,
+	// Start of text, only in iterator state
+	U8_LB_SOT,
+} u8_line_break_class_t;
+
+typedef enum u8_break {
+	U8_BREAK_PROHIBITED,
+	U8_BREAK_ALLOWED,
+	U8_BREAK_MANDATORY,
+} u8_break_t;
+
+// Streaming line break iterator, small enough to be copied for lookahead
+typedef struct u8_line_break {
+	// Last class which is not space, combining marks take class of base
+	uint8_t before;
+	// Class of previous code
+	uint8_t previous;
+	// Regional indicators in run ending at before
+	uint8_t regional_count;
+	// Spaces follow before
+	bool spaces;
+	// Hyphen or BA after HL, no break after it
+	bool hebrew_hyphen;
+} u8_line_break_t;
+
+
+// Encode utf code and saves to str, returns length of utf-8 string
+uint8_t u8_encode(char *str, uint32_t ucode);
+// Decode utf code and saves to ucode, returns length of utf-8 string, 0 at
+// terminating NUL, ill-formed sequence is decoded as replacement character
+// and never read past NUL
+uint8_t u8_decode(uint32_t *ucode, const char *str);
+// Decodes up to length bytes of str to at most capacity codes, returns number
+// of codes, consumed and status receive number of decoded bytes and reason of
+// stop when they are not NULL, streaming callers wait for more input after
+// U8_DECODE_TRUNCATED and must skip or reject input after U8_DECODE_INVALID
+size_t u8_decode_buffer(uint32_t *codes, size_t capacity, const char *str, size_t length, u8_invalid_policy_t policy, size_t *consumed, u8_decode_status_t *status);
+// Line break class of code from generated two-stage table
+u8_line_break_class_t u8_line_break_class(uint32_t ucode);
+void u8_line_break_init(u8_line_break_t *state);
+// Feeds next code of text, returns break opportunity before it, mandatory
+// break comes before code following BK, CR, LF or NL
+u8_break_t u8_line_break_next(u8_line_break_t *state, uint32_t ucode);
@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: MIT
+#include <string.h>
+
+#include "unicode.h"
+#include "unicode_tables.h"
+
+
+// Byte classes of well-formed UTF-8 table, continuation bytes are split by
+// ranges allowed after E0, ED, F0 and F4
+enum {
+	U8_CLASS_ASCII,
+	U8_CLASS_CONT_80,
+	U8_CLASS_CONT_90,
+	U8_CLASS_CONT_A0,
+	U8_CLASS_INVALID,
+	U8_CLASS_LEAD2,
+	U8_CLASS_E0,
+	U8_CLASS_LEAD3,
+	U8_CLASS_ED,
+	U8_CLASS_F0,
+	U8_CLASS_LEAD4,
+	U8_CLASS_F4,
+	U8_CLASS_COUNT,
+};
+
+// Decoder states, pending states name bytes still expected, missing
+// transitions of table are U8_REJECT
+enum {
+	U8_REJECT,
+	U8_ACCEPT,
+	U8_CONT1,
+	U8_CONT2,
+	U8_CONT3,
+	U8_AFTER_E0,
+	U8_AFTER_ED,
+	U8_AFTER_F0,
+	U8_AFTER_F4,
+	U8_STATE_COUNT,
+};
+
+static const uint8_t u8_classes[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 00
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 10
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 20
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 30
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 40
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 50
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 60
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 70
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 80
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, // 90
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, // a0
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, // b0
+	4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, // c0
+	5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, // d0
+	6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 7, // e0
+	9, 10, 10, 10, 11, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, // f0
+};
+
+// Payload bits of lead byte
+static const uint8_t u8_lead_masks[U8_CLASS_COUNT] = {
+	0x7f, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x0f, 0x0f, 0x0f, 0x07, 0x07, 0x07,
+};
+
+static const uint8_t u8_transitions[U8_STATE_COUNT][U8_CLASS_COUNT] = {
+	[U8_ACCEPT] = {
+		[U8_CLASS_ASCII] = U8_ACCEPT,
+		[U8_CLASS_LEAD2] = U8_CONT1,
+		[U8_CLASS_E0] = U8_AFTER_E0,
+		[U8_CLASS_LEAD3] = U8_CONT2,
+		[U8_CLASS_ED] = U8_AFTER_ED,
+		[U8_CLASS_F0] = U8_AFTER_F0,
+		[U8_CLASS_LEAD4] = U8_CONT3,
+		[U8_CLASS_F4] = U8_AFTER_F4,
+	},
+	[U8_CONT1] = {[U8_CLASS_CONT_80] = U8_ACCEPT, [U8_CLASS_CONT_90] = U8_ACCEPT, [U8_CLASS_CONT_A0] = U8_ACCEPT},
+	[U8_CONT2] = {[U8_CLASS_CONT_80] = U8_CONT1, [U8_CLASS_CONT_90] = U8_CONT1, [U8_CLASS_CONT_A0] = U8_CONT1},
+	[U8_CONT3] = {[U8_CLASS_CONT_80] = U8_CONT2, [U8_CLASS_CONT_90] = U8_CONT2, [U8_CLASS_CONT_A0] = U8_CONT2},
+	// Overlong and surrogate sequences
+	[U8_AFTER_E0] = {[U8_CLASS_CONT_A0] = U8_CONT1},
+	[U8_AFTER_ED] = {[U8_CLASS_CONT_80] = U8_CONT1, [U8_CLASS_CONT_90] = U8_CONT1},
+	// Overlong and beyond U+10FFFF
+	[U8_AFTER_F0] = {[U8_CLASS_CONT_90] = U8_CONT2, [U8_CLASS_CONT_A0] = U8_CONT2},
+	[U8_AFTER_F4] = {[U8_CLASS_CONT_80] = U8_CONT2},
+};
+
+
+// Lead byte starts code and sets expected continuation bytes, state is
+// U8_ACCEPT again once code is complete
+static inline uint8_t u8_lead(uint8_t byte, uint32_t *code) {
+	const uint8_t byte_class = u8_classes[byte];
+	*code = byte & u8_lead_masks[byte_class];
+	return u8_transitions[U8_ACCEPT][byte_class];
+}
+
+
+static inline uint8_t u8_continue(uint8_t state, uint8_t byte, uint32_t *code) {
+	*code = (*code << 6) | (byte & 0x3f);
+	return u8_transitions[state][u8_classes[byte]];
+}
+
+
+uint8_t u8_encode(char *str, uint32_t ucode) {
+	if (ucode < 0x80) {
+		str[0] = (char)(ucode & 0xff);
+		return 1;
+	}
+	else if (ucode < 0x800) {
+		str[0] = (char)(((ucode >> 6) & 0x1f) | 0xc0);
+		str[1] = (char)(((ucode >> 0) & 0x3f) | 0x80);
+		return 2;
+	}
+	else if (ucode < 0x10000) {
+		str[0] = (char)(((ucode >> 12) & 0x0f) | 0xe0);
+		str[1] = (char)(((ucode >> 6) & 0x3f) | 0x80);
+		str[2] = (char)(((ucode >> 0) & 0x3f) | 0x80);
+		return 3;
+	}
+	else if (ucode < 0x110000) {
+		str[0] = (char)(((ucode >> 18) & 0x07) | 0xf0);
+		str[1] = (char)(((ucode >> 12) & 0x3f) | 0x80);
+		str[2] = (char)(((ucode >> 6) & 0x3f) | 0x80);
+		str[3] = (char)(((ucode >> 0) & 0x3f) | 0x80);
+		return 4;
+	}
+	else {
+		// Error
+		return 0;
+	}
+}
+
+uint8_t u8_decode(uint32_t *ucode, const char *str) {
+	const uint8_t *bytes = (const uint8_t *)str;
+	if (bytes[0] < 0x80) {
+		*ucode = bytes[0];
+		return bytes[0] ? 1 : 0;
+	}
+	// NUL is rejected inside sequence, so bytes after it are never read
+	uint32_t code;
+	uint8_t state = u8_lead(bytes[0], &code);
+	uint8_t length = 1;
+	while (state > U8_ACCEPT) {
+		state = u8_continue(state, bytes[length++], &code);
+	}
+	if (state == U8_ACCEPT) {
+		*ucode = code;
+		return length;
+	}
+	*ucode = U8_REPLACEMENT_CHARACTER;
+	return length > 1 ? length - 1 : 1;
+}
+
+
+size_t u8_decode_buffer(uint32_t *codes, size_t capacity, const char *str, size_t length, u8_invalid_policy_t policy, size_t *consumed, u8_decode_status_t *status) {
+	const uint8_t *bytes = (const uint8_t *)str;
+	u8_decode_status_t result = U8_DECODE_OK;
+	size_t count = 0;
+	size_t pos = 0;
+	while (pos < length && count < capacity) {
+		if (bytes[pos] < 0x80) {
+			// ASCII runs are copied word at a time
+			while (pos + sizeof(uint32_t) <= length && count + sizeof(uint32_t) <= capacity) {
+				uint32_t word;
+				memcpy(&word, bytes + pos, sizeof(word));
+				if (word & 0x80808080) {
+					break;
+				}
+				codes[count] = bytes[pos];
+				codes[count + 1] = bytes[pos + 1];
+				codes[count + 2] = bytes[pos + 2];
+				codes[count + 3] = bytes[pos + 3];
+				count += 4;
+				pos += 4;
+			}
+			while (pos < length && count < capacity && bytes[pos] < 0x80) {
+				codes[count++] = bytes[pos++];
+			}
+			continue;
+		}
+
+		const size_t start = pos;
+		uint32_t code;
+		uint8_t state = u8_lead(bytes[pos++], &code);
+		while (state > U8_ACCEPT && pos < length) {
+			state = u8_continue(state, bytes[pos++], &code);
+		}
+		if (state == U8_ACCEPT) {
+			codes[count++] = code;
+			continue;
+		}
+
+		// Ill-formed sequence or one truncated by end of buffer, with
+		// U8_INVALID_STOP truncated sequence is left for next call
+		if (policy == U8_INVALID_STOP) {
+			result = state == U8_REJECT ? U8_DECODE_INVALID : U8_DECODE_TRUNCATED;
+			pos = start;
+			break;
+		}
+		// Maximal subpart ends before byte breaking it, that byte starts next
+		// sequence, lone invalid byte is subpart by itself
+		if (state == U8_REJECT && pos - 1 > start) {
+			pos--;
+		}
+		if (policy == U8_INVALID_REPLACE) {
+			codes[count++] = U8_REPLACEMENT_CHARACTER;
+		}
+	}
+
+	if (consumed) {
+		*consumed = pos;
+	}
+	if (status) {
+		*status = result;
+	}
+	return count;
+}
+
+
+u8_line_break_class_t u8_line_break_class(uint32_t ucode) {
+	if (ucode >= U8_LINE_BREAK_FOLDED_START) {
+		const uint32_t plane = ucode >> 16;
+		if (plane != U8_LINE_BREAK_FOLDED_PLANE) {
+			return plane < 4 ? U8_LB_ID : U8_LB_AL;
+		}
+		ucode = U8_LINE_BREAK_FOLDED_START + (ucode & 0xffff);
+	}
+	if (ucode >= U8_LINE_BREAK_LIMIT) {
+		return U8_LB_AL;
+	}
+	const uint32_t block = u8_line_break_stage1[ucode >> U8_LINE_BREAK_SHIFT];
+	return (u8_line_break_class_t)u8_line_break_stage2[(block << U8_LINE_BREAK_SHIFT) | (ucode & ((1 << U8_LINE_BREAK_SHIFT) - 1))];
+}
+
+
+void u8_line_break_init(u8_line_break_t *state) {
+	state->before = U8_LB_SOT;
+	state->previous = U8_LB_SOT;
+	state->regional_count = 0;
+	state->spaces = false;
+	state->hebrew_hyphen = false;
+}
+
+
+// Pair rules LB7 to LB31 come from tables, iterator adds rules which need
+// longer context, LB9 combining marks, LB8a, LB21a and LB30a
+u8_break_t u8_line_break_next(u8_line_break_t *state, uint32_t ucode) {
+	uint8_t after = u8_line_break_class(ucode);
+	const uint8_t previous = state->previous;
+	state->previous = after;
+
+	// LB4, LB5, code after hard line end starts text again
+	if (previous == U8_LB_BK || previous == U8_LB_LF || previous == U8_LB_NL || (previous == U8_LB_CR && after != U8_LB_LF)) {
+		u8_line_break_init(state);
+		u8_line_break_next(state, ucode);
+		return U8_BREAK_MANDATORY;
+	}
+	// LB6, LB7
+	if (after == U8_LB_BK || after == U8_LB_CR || after == U8_LB_LF || after == U8_LB_NL) {
+		state->before = after;
+		state->spaces = false;
+		return U8_BREAK_PROHIBITED;
+	}
+	if (after == U8_LB_SP) {
+		state->spaces = true;
+		return U8_BREAK_PROHIBITED;
+	}
+	const uint8_t before = state->before;
+	if (after == U8_LB_CM || after == U8_LB_ZWJ) {
+		if (before < U8_LB_CM && before != U8_LB_ZW && !state->spaces) {
+			// LB9, mark takes class of its base
+			return U8_BREAK_PROHIBITED;
+		}
+		// LB10
+		after = U8_LB_AL;
+	}
+
+	u8_break_t result;
+	if (before == U8_LB_SOT) {
+		// LB2, spaces at start break like after AL, by LB18 unless LB7 to
+		// LB13 forbid break before after
+		result = state->spaces && (u8_line_break_indirect[U8_LB_AL] >> after) & 1 ? U8_BREAK_ALLOWED : U8_BREAK_PROHIBITED;
+	}
+	else if (previous == U8_LB_ZWJ) {
+		// LB8a
+		result = U8_BREAK_PROHIBITED;
+	}
+	else {
+		const uint32_t allowed = state->spaces ? u8_line_break_indirect[before] : u8_line_break_direct[before];
+		result = (allowed >> after) & 1 ? U8_BREAK_ALLOWED : U8_BREAK_PROHIBITED;
+		if (!state->spaces && before == U8_LB_RI && after == U8_LB_RI) {
+			// LB30a, flags are pairs of regional indicators
+			result = state->regional_count & 1 ? U8_BREAK_PROHIBITED : U8_BREAK_ALLOWED;
+		}
+		if (!state->spaces && state->hebrew_hyphen && after != U8_LB_CB) {
+			// LB21a
+			result = U8_BREAK_PROHIBITED;
+		}
+	}
+
+	state->hebrew_hyphen = !state->spaces && before == U8_LB_HL && (after == U8_LB_HY || after == U8_LB_BA);
+	state->regional_count = after != U8_LB_RI ? 0 : before == U8_LB_RI && !state->spaces ? state->regional_count + 1 : 1;
+	state->before = after;
+	state->spaces = false;
+	return result;
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: MIT
+// Generated by unicode_tables.py from LineBreak-14.0.0.txt, do not edit
+
+#pragma once
+
+#include <stdint.h>
+
+
+#define U8_LINE_BREAK_SHIFT 5
+// Plane 14 follows plane 1, folded code points from limit have class AL
+#define U8_LINE_BREAK_FOLDED_PLANE 14
+#define U8_LINE_BREAK_FOLDED_START 0x20000
+#define U8_LINE_BREAK_LIMIT 0x20200
+#define U8_LINE_BREAK_PAIR_COUNT 31
+
+extern const uint16_t u8_line_break_stage1[4112];
+extern const uint8_t u8_line_break_stage2[11104];
+// Bit of class after is set when break is allowed
+extern const uint32_t u8_line_break_direct[U8_LINE_BREAK_PAIR_COUNT];
+extern const uint32_t u8_line_break_indirect[U8_LINE_BREAK_PAIR_COUNT];
@@ -0,0 +1,216 @@
+#!/usr/bin/env python
+# SPDX-License-Identifier: MIT
+"""Generates unicode_tables.h and unicode_tables.c from LineBreak.txt
+
+usage: unicode_tables.py LineBreak.txt OUTPUT_DIR
+
+Line break classes are resolved by rule LB1 of UAX #14, AI, SG and XX become
+AL, CJ becomes NS and SA becomes CM for marks and AL otherwise. Class of code
+point is found by two-stage table, block size is chosen for smallest tables.
+Planes 2 and 3 are ideographs and only planes 0, 1 and 14 are stored, plane 14
+right after plane 1.
+Pair masks tell for each class before break whether break is allowed before
+class after, without and with spaces between them, rules needing more than
+pair are left to iterator in unicode.c.
+"""
+
+import argparse
+import os
+import re
+import unicodedata
+
+
+# Same order as u8_line_break_class_t, pair classes come first
+PAIR_CLASSES = [
+	'OP', 'CL', 'CP', 'QU', 'GL', 'NS', 'EX', 'SY', 'IS', 'PR', 'PO', 'NU',
+	'AL', 'HL', 'ID', 'IN', 'HY', 'BA', 'BB', 'B2', 'ZW', 'WJ', 'H2', 'H3',
+	'JL', 'JV', 'JT', 'RI', 'EB', 'EM', 'CB',
+]
+CLASSES = PAIR_CLASSES + ['CM', 'ZWJ', 'SP', 'BK', 'CR', 'LF', 'NL']
+DEFAULT_CLASS = 'AL'
+CODE_COUNT = 0x110000
+# Planes 2 and 3 have class ID, other planes from 2 have class AL apart from
+# tags and variation selectors in plane 14
+IDEOGRAPHIC_PLANES = (2, 3)
+FOLDED_PLANE = 14
+FOLDED_START = 0x20000
+
+
+def resolve_class(code, line_break):
+	if line_break in ('AI', 'SG', 'XX'):
+		return 'AL'
+	if line_break == 'CJ':
+		return 'NS'
+	if line_break == 'SA':
+		return 'CM' if unicodedata.category(chr(code)) in ('Mn', 'Mc') else 'AL'
+	return line_break
+
+
+def read_line_break(path):
+	classes = ['XX'] * CODE_COUNT
+	version = None
+	entry = re.compile(r'^([0-9A-F]+)(?:\.\.([0-9A-F]+))?\s*;\s*(\w+)')
+	missing = re.compile(r'^#\s*@missing:\s*([0-9A-F]+)\.\.([0-9A-F]+)\s*;\s*(\w+)')
+	with open(path, encoding='utf-8') as source:
+		for line in source:
+			if version is None:
+				match = re.search(r'LineBreak-([0-9.]+)\.txt', line)
+				if match:
+					version = match.group(1)
+			match = missing.match(line) or entry.match(line)
+			if not match:
+				continue
+			first = int(match.group(1), 16)
+			last = int(match.group(2), 16) if match.group(2) else first
+			for code in range(first, last + 1):
+				classes[code] = match.group(3)
+	return version, [resolve_class(code, line_break) for code, line_break in enumerate(classes)]
+
+
+def break_allowed(before, after, spaces):
+	"""UAX #14 rules LB7 to LB31 for pair of resolved classes"""
+	if after == 'ZW':
+		return False  # LB7
+	if before == 'ZW':
+		return True  # LB8
+	if after == 'WJ' or (before == 'WJ' and not spaces):
+		return False  # LB11
+	if before == 'GL' and not spaces:
+		return False  # LB12
+	if after == 'GL' and not spaces and before not in ('BA', 'HY'):
+		return False  # LB12a
+	if after in ('CL', 'CP', 'EX', 'IS', 'SY'):
+		return False  # LB13
+	if before == 'OP':
+		return False  # LB14
+	if before == 'QU' and after == 'OP':
+		return False  # LB15
+	if before in ('CL', 'CP') and after == 'NS':
+		return False  # LB16
+	if before == 'B2' and after == 'B2':
+		return False  # LB17
+	if spaces:
+		return True  # LB18
+	if before == 'QU' or after == 'QU':
+		return False  # LB19
+	if before == 'CB' or after == 'CB':
+		return True  # LB20
+	if after in ('BA', 'HY', 'NS') or before == 'BB':
+		return False  # LB21
+	if before == 'SY' and after == 'HL':
+		return False  # LB21b
+	if after == 'IN':
+		return False  # LB22
+	if (before, after) in LB23_TO_LB30:
+		return False
+	if before == 'RI' and after == 'RI':
+		return False  # LB30a, pairs are counted by iterator
+	return True  # LB31
+
+
+def pairs(before_classes, after_classes):
+	return {(before, after) for before in before_classes.split() for after in after_classes.split()}
+
+
+LB23_TO_LB30 = set().union(
+	pairs('AL HL', 'NU'), pairs('NU', 'AL HL'),
+	pairs('PR', 'ID EB EM'), pairs('ID EB EM', 'PO'),
+	pairs('PR PO', 'AL HL'), pairs('AL HL', 'PR PO'),
+	# LB25 as pairs
+	pairs('CL CP NU', 'PO PR'), pairs('PO PR', 'OP NU'), pairs('HY IS NU SY', 'NU'),
+	pairs('JL', 'JL JV H2 H3'), pairs('JV H2', 'JV JT'), pairs('JT H3', 'JT'),
+	pairs('JL JV JT H2 H3', 'PO'), pairs('PR', 'JL JV JT H2 H3'),
+	pairs('AL HL', 'AL HL'),
+	pairs('IS', 'AL HL'),
+	# LB30 without East Asian width of OP and CP
+	pairs('AL HL NU', 'OP'), pairs('CP', 'AL HL NU'),
+	pairs('EB', 'EM'),
+)
+
+
+def build_stages(values, shift):
+	block_size = 1 << shift
+	blocks = {}
+	stage1 = []
+	stage2 = []
+	for start in range(0, len(values), block_size):
+		block = tuple(values[start:start + block_size])
+		if block not in blocks:
+			blocks[block] = len(blocks)
+			stage2.extend(block)
+		stage1.append(blocks[block])
+	return stage1, stage2
+
+
+def stage_size(stage1, stage2):
+	return len(stage1) * (1 if max(stage1) < 256 else 2) + len(stage2)
+
+
+def format_array(values, per_line):
+	lines = []
+	for start in range(0, len(values), per_line):
+		lines.append('\t' + ', '.join(str(value) for value in values[start:start + per_line]) + ',')
+	return '\n'.join(lines)
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Generate line break tables')
+	parser.add_argument('line_break', help='LineBreak.txt of Unicode character database')
+	parser.add_argument('output', help='directory of unicode_tables.h and unicode_tables.c')
+	args = parser.parse_args()
+
+	version, classes = read_line_break(args.line_break)
+	values = [CLASSES.index(line_break) for line_break in classes]
+	default = CLASSES.index(DEFAULT_CLASS)
+	ideographic = CLASSES.index('ID')
+	for code in range(FOLDED_START, CODE_COUNT):
+		plane_class = ideographic if code >> 16 in IDEOGRAPHIC_PLANES else default
+		# Noncharacters at end of planes are ignored
+		if values[code] != plane_class and code >> 16 != FOLDED_PLANE and (code & 0xfffe) != 0xfffe:
+			raise SystemExit('U+%04X is not in stored planes' % code)
+	values = values[:FOLDED_START] + values[FOLDED_PLANE << 16:(FOLDED_PLANE + 1) << 16]
+	# Code points after last block which is not default are not stored
+	limit = max(code for code, value in enumerate(values) if value != default) + 1
+
+	best = None
+	for shift in range(4, 11):
+		table_limit = (limit + (1 << shift) - 1) >> shift << shift
+		stage1, stage2 = build_stages(values[:table_limit], shift)
+		if best is None or stage_size(stage1, stage2) < stage_size(*best[1:]):
+			best = (shift, stage1, stage2)
+	shift, stage1, stage2 = best
+	stage1_type = 'uint8_t' if max(stage1) < 256 else 'uint16_t'
+
+	direct = []
+	indirect = []
+	for before in PAIR_CLASSES:
+		direct.append(sum(1 << index for index, after in enumerate(PAIR_CLASSES) if break_allowed(before, after, False)))
+		indirect.append(sum(1 << index for index, after in enumerate(PAIR_CLASSES) if break_allowed(before, after, True)))
+
+	header = '// SPDX-License-Identifier: MIT\n// Generated by unicode_tables.py from LineBreak-%s.txt, do not edit\n' % (version or 'unknown')
+	with open(os.path.join(args.output, 'unicode_tables.h'), 'w') as output:
+		output.write(header)
+		output.write('\n#pragma once\n\n#include <stdint.h>\n\n\n')
+		output.write('#define U8_LINE_BREAK_SHIFT %d\n' % shift)
+		output.write('// Plane 14 follows plane 1, folded code points from limit have class AL\n')
+		output.write('#define U8_LINE_BREAK_FOLDED_PLANE %d\n' % FOLDED_PLANE)
+		output.write('#define U8_LINE_BREAK_FOLDED_START 0x%x\n' % FOLDED_START)
+		output.write('#define U8_LINE_BREAK_LIMIT 0x%x\n' % (len(stage1) << shift))
+		output.write('#define U8_LINE_BREAK_PAIR_COUNT %d\n\n' % len(PAIR_CLASSES))
+		output.write('extern const %s u8_line_break_stage1[%d];\n' % (stage1_type, len(stage1)))
+		output.write('extern const uint8_t u8_line_break_stage2[%d];\n' % len(stage2))
+		output.write('// Bit of class after is set when break is allowed\n')
+		output.write('extern const uint32_t u8_line_break_direct[U8_LINE_BREAK_PAIR_COUNT];\n')
+		output.write('extern const uint32_t u8_line_break_indirect[U8_LINE_BREAK_PAIR_COUNT];\n')
+	with open(os.path.join(args.output, 'unicode_tables.c'), 'w') as output:
+		output.write(header)
+		output.write('\n#include "unicode_tables.h"\n\n\n')
+		output.write('const %s u8_line_break_stage1[%d] = {\n%s\n};\n\n' % (stage1_type, len(stage1), format_array(stage1, 32)))
+		output.write('const uint8_t u8_line_break_stage2[%d] = {\n%s\n};\n\n' % (len(stage2), format_array(stage2, 32)))
+		output.write('const uint32_t u8_line_break_direct[U8_LINE_BREAK_PAIR_COUNT] = {\n%s\n};\n\n' % format_array(['0x%08x' % mask for mask in direct], 4))
+		output.write('const uint32_t u8_line_break_indirect[U8_LINE_BREAK_PAIR_COUNT] = {\n%s\n};\n' % format_array(['0x%08x' % mask for mask in indirect], 4))
+	print('%d + %d bytes, block size %d' % (len(stage1) * (1 if stage1_type == 'uint8_t' else 2), len(stage2), 1 << shift))
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,1348 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "soc/cpu.h"
+
+#include "benchmark.h"
+#include "text_layout.h"
+#include "text_run.h"
+#include "ui_strings.h"
+#include "unicode.h"
+
+
+#define BENCHMARK_BUFFER_LINES 20
+#define BENCHMARK_REPEAT 16
+
+
+static const char *TAG = "benchmark";
+
+// Cycles of reference and optimized code over same work of count units,
+// max_difference of outputs in LSB is negative when they aren't compared
+typedef struct benchmark_result {
+	uint32_t reference_cycles;
+	uint32_t cycles;
+	size_t count;
+	int max_difference;
+} benchmark_result_t;
+
+// Adds cycles spent in statement to counter
+#define BENCHMARK_TIME(cycles, statement) do { \
+	const uint32_t benchmark_start = esp_cpu_get_ccount(); \
+	statement; \
+	(cycles) += esp_cpu_get_ccount() - benchmark_start; \
+} while (0)
+
+extern const uint8_t ttf_start[] asm("_binary_Ubuntu_R_subset_ttf_start");
+extern const uint8_t ttf_end[] asm("_binary_Ubuntu_R_subset_ttf_end");
+extern const uint8_t prerendered_start[] asm("_binary_Ubuntu_R_prerendered_bin_start");
+extern const uint8_t prerendered_end[] asm("_binary_Ubuntu_R_prerendered_bin_end");
+
+
+// Implementation of st7789_draw_gray2_bitmap before SWAR rewrite
+static void reference_draw_gray2_bitmap(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	if (x >= target_w || y >= target_h || x + src_w <= 0 || y + src_h <= 0) {
+		return;
+	}
+
+	const size_t src_size = src_w * src_h;
+	const size_t target_size = target_w * target_h;
+	const size_t line_w = MIN(src_w + x, target_w) - MAX(x, 0);
+	const size_t src_skip = src_w - line_w;
+	const size_t target_skip = target_w - line_w;
+	size_t src_pos = 0;
+	size_t target_pos = 0;
+	size_t x_pos = 0;
+	size_t y_pos = 0;
+
+	if (y < 0) {
+		src_pos = (-y) * src_w;
+	}
+	if (x < 0) {
+		src_pos -= x;
+	}
+	if (y > 0) {
+		target_pos = y * target_w;
+	}
+	if (x > 0) {
+		target_pos += x;
+	}
+
+	while (src_pos < src_size && target_pos < target_size) {
+		uint8_t src_r, src_g, src_b;
+		uint8_t target_r, target_g, target_b;
+		st7789_color_to_rgb(target_buf[target_pos], &src_r, &src_g, &src_b);
+		uint8_t gray2_color = (src_buf[src_pos >> 2] >> ((src_pos & 0x03) << 1)) & 0x03;
+		switch(gray2_color) {
+			case 1:
+				target_r = r >> 1;
+				target_g = g >> 1;
+				target_b = b >> 1;
+				src_r = (src_r >> 1) + target_r;
+				src_g = (src_g >> 1) + target_g;
+				src_b = (src_b >> 1) + target_b;
+				target_buf[target_pos] = st7789_rgb_to_color_dither(src_r, src_g, src_b, x_pos, y_pos);
+				break;
+			case 2:
+				target_r = r >> 2;
+				target_g = g >> 2;
+				target_b = b >> 2;
+				src_r = (src_r >> 2) + target_r + target_r + target_r;
+				src_g = (src_g >> 2) + target_g + target_g + target_g;
+				src_b = (src_b >> 2) + target_b + target_b + target_b;
+				target_buf[target_pos] = st7789_rgb_to_color_dither(src_r, src_g, src_b, x_pos, y_pos);
+				break;
+			case 3:
+				target_buf[target_pos] = st7789_rgb_to_color_dither(r, g, b, x_pos, y_pos);
+				break;
+			default:
+				break;
+		}
+
+		x_pos++;
+
+		if (x_pos == line_w) {
+			x_pos = 0;
+			y_pos++;
+			src_pos += src_skip;
+			target_pos += target_skip;
+		}
+		src_pos++;
+		target_pos++;
+	}
+}
+
+
+// Random dither table and branchy rounding used before ordered dithering
+static uint8_t reference_dither_table[256];
+
+static void reference_randomize_dither_table() {
+	for (size_t i = 0; i < sizeof(reference_dither_table); ++i) {
+		reference_dither_table[i] = rand() & 0xff;
+	}
+}
+
+static st7789_color_t reference_rgb_to_color_dither(uint8_t r, uint8_t g, uint8_t b, uint16_t x, uint16_t y) {
+	const uint8_t pos = ((y << 8) + (y << 3) + x) & 0xff;
+	uint8_t rand_b = reference_dither_table[pos];
+	const uint8_t rand_r = rand_b & 0x07;
+	rand_b >>= 3;
+	const uint8_t rand_g = rand_b & 0x03;
+	rand_b >>= 2;
+
+	if (r < 249) {
+		r = r + rand_r;
+	}
+	if (g < 253) {
+		g = g + rand_g;
+	}
+	if (b < 249) {
+		b = b + rand_b;
+	}
+	return st7789_rgb_to_color(r, g, b);
+}
+
+
+static void fill_test_pattern(st7789_color_t *buffer, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		buffer[i] = (st7789_color_t)(i * 2654435761u >> 16);
+	}
+}
+
+
+static uint8_t max_channel_difference(const st7789_color_t *a, const st7789_color_t *b, size_t size) {
+	uint8_t max_difference = 0;
+	for (size_t i = 0; i < size; ++i) {
+		const uint8_t differences[3] = {
+			abs((a[i] >> 11) - (b[i] >> 11)),
+			abs(((a[i] >> 5) & 0x3f) - ((b[i] >> 5) & 0x3f)),
+			abs((a[i] & 0x1f) - (b[i] & 0x1f)),
+		};
+		for (size_t channel = 0; channel < 3; ++channel) {
+			max_difference = MAX(max_difference, differences[channel]);
+		}
+	}
+	return max_difference;
+}
+
+
+// Prints cycles of reference and optimized code per unit of work and max
+// difference of their outputs when it was measured
+static void benchmark_print(const char *name, const benchmark_result_t *result, const char *unit) {
+	const double reference = (double)result->reference_cycles / MAX(result->count, 1);
+	const double optimized = (double)result->cycles / MAX(result->count, 1);
+	// Fractions matter only for per pixel and per byte costs
+	const int precision = reference < 100 && optimized < 100 ? 2 : 0;
+	printf("%s: %.*f -> %.*f cycles/%s", name, precision, reference, precision, optimized, unit);
+	if (result->max_difference >= 0) {
+		printf(", max difference %d LSB", result->max_difference);
+	}
+	printf("\n");
+}
+
+
+typedef void (*benchmark_coverage_func_t)(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h);
+
+
+static void benchmark_draw_gray2(const uint8_t *src_buf, st7789_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	st7789_draw_gray2_bitmap((uint8_t *)src_buf, target_buf, r, g, b, x, y, src_w, src_h, target_w, target_h);
+}
+
+
+// Glyph centered on display drawn strip by strip over test pattern by
+// reference and optimized blitter, count is number of visible pixels
+static void benchmark_glyph_strips(st7789_driver_t *driver, benchmark_coverage_func_t reference, const uint8_t *reference_bitmap, benchmark_coverage_func_t blitter, const uint8_t *bitmap, int width, int height, st7789_color_t *buffer_a, st7789_color_t *buffer_b, benchmark_result_t *result) {
+	const size_t buffer_size = driver->display_width * BENCHMARK_BUFFER_LINES;
+	const int x = (driver->display_width - width) / 2;
+	for (int y = 0; y < height; y += BENCHMARK_BUFFER_LINES) {
+		result->count += MIN(width, driver->display_width) * MIN(height - y, BENCHMARK_BUFFER_LINES) * BENCHMARK_REPEAT;
+		for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+			fill_test_pattern(buffer_a, buffer_size);
+			fill_test_pattern(buffer_b, buffer_size);
+			BENCHMARK_TIME(result->reference_cycles, reference(reference_bitmap, buffer_a, 255, 200, 100, x, -y, width, height, driver->display_width, BENCHMARK_BUFFER_LINES));
+			BENCHMARK_TIME(result->cycles, blitter(bitmap, buffer_b, 255, 200, 100, x, -y, width, height, driver->display_width, BENCHMARK_BUFFER_LINES));
+			result->max_difference = MAX(result->max_difference, max_channel_difference(buffer_a, buffer_b, buffer_size));
+		}
+	}
+}
+
+
+static void benchmark_gray2_bitmap(st7789_driver_t *driver, font_face_t *face, st7789_color_t *buffer_a, st7789_color_t *buffer_b, font_size_t pixel_size) {
+	font_render_t render = {0};
+	ESP_ERROR_CHECK(font_render_init(&render, face, pixel_size));
+	render.format = FONT_BITMAP_GRAY2;
+	ESP_ERROR_CHECK(font_render_glyph(&render, (uint32_t)'A'));
+
+	benchmark_result_t result = {0};
+	benchmark_glyph_strips(driver, reference_draw_gray2_bitmap, render.bitmap, benchmark_draw_gray2, render.bitmap, render.bitmap_width, render.bitmap_height, buffer_a, buffer_b, &result);
+	char name[32];
+	snprintf(name, sizeof(name), "gray2 bitmap %3dpx", pixel_size);
+	benchmark_print(name, &result, "pixel");
+
+	font_render_destroy(&render);
+}
+
+
+// Same glyph drawn from every shallower coverage depth compared with 8 bit
+// coverage, bytes are size of its bitmap
+static void benchmark_coverage_depth(st7789_driver_t *driver, font_face_t *face, st7789_color_t *buffer_a, st7789_color_t *buffer_b, font_size_t pixel_size) {
+	static const font_bitmap_format_t formats[] = {FONT_BITMAP_GRAY1, FONT_BITMAP_GRAY2, FONT_BITMAP_GRAY4};
+	static const benchmark_coverage_func_t blitters[] = {
+		st7789_draw_gray1_bitmap,
+		benchmark_draw_gray2,
+		st7789_draw_gray4_bitmap,
+	};
+	font_render_t reference = {0};
+	ESP_ERROR_CHECK(font_render_init(&reference, face, pixel_size));
+	reference.format = FONT_BITMAP_GRAY8;
+	ESP_ERROR_CHECK(font_render_glyph(&reference, (uint32_t)'A'));
+	const size_t reference_bytes = (size_t)reference.bitmap_width * reference.bitmap_height;
+
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+		font_render_t render = {0};
+		ESP_ERROR_CHECK(font_render_init(&render, face, pixel_size));
+		render.format = formats[i];
+		ESP_ERROR_CHECK(font_render_glyph(&render, (uint32_t)'A'));
+		if (render.bitmap_width != reference.bitmap_width || render.bitmap_height != reference.bitmap_height) {
+			ESP_LOGE(TAG, "Coverage depth %d bit has different glyph size", font_bitmap_bits(render.bitmap_format));
+			font_render_destroy(&render);
+			continue;
+		}
+
+		benchmark_result_t result = {0};
+		benchmark_glyph_strips(driver, st7789_draw_gray8_bitmap, reference.bitmap, blitters[i], render.bitmap, render.bitmap_width, render.bitmap_height, buffer_a, buffer_b, &result);
+		char name[32];
+		snprintf(name, sizeof(name), "coverage %d bit %3dpx", font_bitmap_bits(render.bitmap_format), pixel_size);
+		benchmark_print(name, &result, "pixel");
+		printf("%s: %zu -> %zu bytes\n", name, reference_bytes, (reference_bytes * font_bitmap_bits(render.bitmap_format) + 7) >> 3);
+
+		font_render_destroy(&render);
+	}
+	font_render_destroy(&reference);
+}
+
+
+static void benchmark_gray2_spans(st7789_driver_t *driver, font_face_t *face, st7789_color_t *buffer_a, st7789_color_t *buffer_b, font_size_t pixel_size) {
+	font_render_t bitmap_render = {0};
+	font_render_t spans_render = {0};
+	ESP_ERROR_CHECK(font_render_init(&bitmap_render, face, pixel_size));
+	ESP_ERROR_CHECK(font_render_init(&spans_render, face, pixel_size));
+	bitmap_render.format = FONT_BITMAP_GRAY2;
+	spans_render.format = FONT_BITMAP_GRAY2_SPANS;
+	ESP_ERROR_CHECK(font_render_glyph(&bitmap_render, (uint32_t)'A'));
+	ESP_ERROR_CHECK(font_render_glyph(&spans_render, (uint32_t)'A'));
+	if (spans_render.bitmap_format != FONT_BITMAP_GRAY2_SPANS) {
+		ESP_LOGE(TAG, "Glyph %dpx not span encoded", pixel_size);
+	}
+
+	benchmark_result_t result = {0};
+	benchmark_glyph_strips(driver, benchmark_draw_gray2, bitmap_render.bitmap, st7789_draw_gray2_spans, spans_render.bitmap, bitmap_render.bitmap_width, bitmap_render.bitmap_height, buffer_a, buffer_b, &result);
+	char name[32];
+	snprintf(name, sizeof(name), "gray2 spans %3dpx", pixel_size);
+	benchmark_print(name, &result, "pixel");
+
+	font_render_destroy(&spans_render);
+	font_render_destroy(&bitmap_render);
+}
+
+
+static void benchmark_blend_glyph(const font_render_t *render, st7789_color_t *buffer, uint8_t color, int x, int y, int target_w) {
+	if (render->bitmap_format == FONT_BITMAP_GRAY2_SPANS) {
+		st7789_draw_gray2_spans(render->bitmap, buffer, color, color, color, x, y, render->bitmap_width, render->bitmap_height, target_w, BENCHMARK_BUFFER_LINES);
+	}
+	else {
+		st7789_draw_gray2_bitmap(render->bitmap, buffer, color, color, color, x, y, render->bitmap_width, render->bitmap_height, target_w, BENCHMARK_BUFFER_LINES);
+	}
+}
+
+
+static void benchmark_palette_glyph(const font_render_t *render, const st7789_gray2_palette_t *palette, st7789_color_t *buffer, int x, int y, int target_w) {
+	if (render->bitmap_format == FONT_BITMAP_GRAY2_SPANS) {
+		st7789_draw_gray2_spans_palette(palette, render->bitmap, buffer, x, y, render->bitmap_width, render->bitmap_height, target_w, BENCHMARK_BUFFER_LINES);
+	}
+	else {
+		st7789_draw_gray2_bitmap_palette(palette, render->bitmap, buffer, x, y, render->bitmap_width, render->bitmap_height, target_w, BENCHMARK_BUFFER_LINES);
+	}
+}
+
+
+// Palette setup is counted to palette blits
+static void benchmark_gray2_palette(st7789_driver_t *driver, font_face_t *face, st7789_color_t *buffer_a, st7789_color_t *buffer_b, font_size_t pixel_size) {
+	static const char text[] = "Perfectly readable even small fonts";
+	const st7789_color_t background = st7789_rgb_to_color(0, 80, 0);
+	font_render_t render = {0};
+	ESP_ERROR_CHECK(font_render_init(&render, face, pixel_size));
+
+	const size_t buffer_size = driver->display_width * BENCHMARK_BUFFER_LINES;
+	benchmark_result_t result = {0};
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		for (size_t i = 0; i < buffer_size; ++i) {
+			buffer_a[i] = background;
+			buffer_b[i] = background;
+		}
+
+		const uint8_t color = repeat * 255 / (BENCHMARK_REPEAT - 1);
+		st7789_gray2_palette_t palette;
+		BENCHMARK_TIME(result.cycles, st7789_gray2_palette_init(&palette, background, color, color, color, true));
+
+		int x = 0;
+		for (const char *c = text; *c; ++c) {
+			ESP_ERROR_CHECK(font_render_glyph(&render, (uint32_t)*c));
+			const int y = render.max_pixel_height - render.origin - render.bitmap_top;
+			result.count += render.bitmap_width * render.bitmap_height;
+			BENCHMARK_TIME(result.reference_cycles, benchmark_blend_glyph(&render, buffer_a, color, x + render.bitmap_left, y, driver->display_width));
+			BENCHMARK_TIME(result.cycles, benchmark_palette_glyph(&render, &palette, buffer_b, x + render.bitmap_left, y, driver->display_width));
+			x += render.advance;
+		}
+
+		result.max_difference = MAX(result.max_difference, max_channel_difference(buffer_a, buffer_b, buffer_size));
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "gray2 palette %3dpx", pixel_size);
+	benchmark_print(name, &result, "pixel");
+
+	font_render_destroy(&render);
+}
+
+
+static void zoom_bitmap(st7789_driver_t *driver, font_render_t *render, font_size_t pixel_size, st7789_color_t *buffer) {
+	ESP_ERROR_CHECK(font_render_set_pixel_size(render, pixel_size));
+	ESP_ERROR_CHECK(font_render_glyph(render, (uint32_t)'A'));
+	st7789_draw_gray2_spans(render->bitmap, buffer, 255, 255, 255, 0, 0, render->bitmap_width, render->bitmap_height, driver->display_width, BENCHMARK_BUFFER_LINES);
+}
+
+
+static void zoom_sdf(st7789_driver_t *driver, font_render_t *render, font_size_t pixel_size, st7789_color_t *buffer) {
+	ESP_ERROR_CHECK(font_render_set_pixel_size(render, pixel_size));
+	ESP_ERROR_CHECK(font_render_glyph(render, (uint32_t)'A'));
+	st7789_draw_sdf(render->bitmap, buffer, 255, 255, 255, 0, 0, render->glyph->bitmap_width, render->glyph->bitmap_height, render->sdf_scale, FONT_SDF_SPREAD, driver->display_width, BENCHMARK_BUFFER_LINES);
+}
+
+
+// Animated zoom of one glyph, every frame has new pixel size
+static void benchmark_sdf_zoom(st7789_driver_t *driver, font_face_t *face, st7789_color_t *buffer) {
+	font_render_t bitmap_render = {0};
+	font_render_t sdf_render = {0};
+	ESP_ERROR_CHECK(font_render_init(&bitmap_render, face, 200));
+	ESP_ERROR_CHECK(font_render_init(&sdf_render, face, 200));
+	sdf_render.format = FONT_BITMAP_SDF;
+	benchmark_result_t result = {.max_difference = -1};
+
+	for (font_size_t pixel_size = 200; pixel_size > 60; pixel_size -= 2) {
+		BENCHMARK_TIME(result.reference_cycles, zoom_bitmap(driver, &bitmap_render, pixel_size, buffer));
+		BENCHMARK_TIME(result.cycles, zoom_sdf(driver, &sdf_render, pixel_size, buffer));
+		result.count++;
+	}
+
+	benchmark_print("sdf zoom", &result, "frame");
+
+	font_render_destroy(&sdf_render);
+	font_render_destroy(&bitmap_render);
+}
+
+
+// Large glyph at changing size over all strips of frame, cached bitmap or
+// outline rasterized directly into each strip
+typedef struct benchmark_span_target {
+	st7789_color_t *buffer;
+	int width;
+	// Visible corner of glyph, origin of dither tile
+	int dither_x;
+	int dither_y;
+	st7789_coverage_color_t color;
+} benchmark_span_target_t;
+
+
+static void benchmark_span(int x, int y, int length, uint8_t coverage, void *user_data) {
+	const benchmark_span_target_t *target = (const benchmark_span_target_t *)user_data;
+	st7789_blend_coverage_span(&target->color, target->buffer + y * target->width + x, coverage, x - target->dither_x, y - target->dither_y, length);
+}
+
+
+static void draw_bitmap_strips(st7789_driver_t *driver, font_render_t *render, font_size_t pixel_size, st7789_color_t *buffer) {
+	ESP_ERROR_CHECK(font_render_set_pixel_size(render, pixel_size));
+	ESP_ERROR_CHECK(font_render_glyph(render, (uint32_t)'A'));
+	for (int y = 0; y < driver->display_height; y += BENCHMARK_BUFFER_LINES) {
+		st7789_draw_gray2_spans(render->bitmap, buffer, 255, 255, 255, 0, -y, render->bitmap_width, render->bitmap_height, driver->display_width, BENCHMARK_BUFFER_LINES);
+	}
+}
+
+
+static void draw_outline_strips(st7789_driver_t *driver, font_render_t *render, font_size_t pixel_size, benchmark_span_target_t *target) {
+	ESP_ERROR_CHECK(font_render_set_pixel_size(render, pixel_size));
+	ESP_ERROR_CHECK(font_render_glyph(render, (uint32_t)'A'));
+	for (int y = 0; y < driver->display_height; y += BENCHMARK_BUFFER_LINES) {
+		ESP_ERROR_CHECK(font_render_draw_spans(render, 0, -y, driver->display_width, BENCHMARK_BUFFER_LINES, benchmark_span, target));
+	}
+}
+
+
+static void benchmark_direct_spans(st7789_driver_t *driver, font_face_t *face, st7789_color_t *buffer) {
+	font_render_t bitmap_render = {0};
+	font_render_t outline_render = {0};
+	ESP_ERROR_CHECK(font_render_init(&bitmap_render, face, 200));
+	ESP_ERROR_CHECK(font_render_init(&outline_render, face, 200));
+	outline_render.format = FONT_BITMAP_OUTLINE;
+	benchmark_span_target_t target = {
+		.buffer = buffer,
+		.width = driver->display_width,
+	};
+	st7789_coverage_color_init(&target.color, 255, 255, 255);
+	benchmark_result_t result = {.max_difference = -1};
+
+	for (font_size_t pixel_size = 200; pixel_size > 120; pixel_size -= 4) {
+		BENCHMARK_TIME(result.reference_cycles, draw_bitmap_strips(driver, &bitmap_render, pixel_size, buffer));
+		BENCHMARK_TIME(result.cycles, draw_outline_strips(driver, &outline_render, pixel_size, &target));
+		result.count++;
+	}
+
+	benchmark_print("direct spans", &result, "frame");
+
+	font_render_destroy(&outline_render);
+	font_render_destroy(&bitmap_render);
+}
+
+
+// Glyph misses at new sizes, loaded by FreeType or scaled from cached outline
+static void benchmark_outline_cache(font_face_t *face) {
+	font_render_t hinted_render = {0};
+	font_render_t outline_render = {0};
+	ESP_ERROR_CHECK(font_render_init(&hinted_render, face, 14));
+	ESP_ERROR_CHECK(font_render_init(&outline_render, face, 14));
+	outline_render.hinting = FONT_HINTING_NONE;
+	benchmark_result_t result = {.max_difference = -1};
+
+	for (font_size_t pixel_size = 14; pixel_size < 46; ++pixel_size) {
+		ESP_ERROR_CHECK(font_render_set_pixel_size(&hinted_render, pixel_size));
+		ESP_ERROR_CHECK(font_render_set_pixel_size(&outline_render, pixel_size));
+		for (uint32_t c = 'A'; c <= 'Z'; ++c) {
+			BENCHMARK_TIME(result.reference_cycles, ESP_ERROR_CHECK(font_render_glyph(&hinted_render, c)));
+			BENCHMARK_TIME(result.cycles, ESP_ERROR_CHECK(font_render_glyph(&outline_render, c)));
+			result.count++;
+		}
+	}
+
+	benchmark_print("outline cache miss", &result, "glyph");
+
+	font_render_destroy(&outline_render);
+	font_render_destroy(&hinted_render);
+}
+
+
+// Rescales shared face on every switch
+static void reference_switch_size(font_face_t *face, font_size_t pixel_size, FT_UInt glyph_index) {
+	FT_Activate_Size(face->ft_size);
+	FT_Set_Pixel_Sizes(face->ft_face, 0, pixel_size);
+	FT_Load_Glyph(face->ft_face, glyph_index, FT_LOAD_DEFAULT);
+	FT_Render_Glyph(face->ft_face->glyph, FT_RENDER_MODE_NORMAL);
+}
+
+
+// Swaps per render size object
+static void switch_size(FT_Size size, FT_UInt glyph_index) {
+	FT_Activate_Size(size);
+	FT_Load_Glyph(size->face, glyph_index, FT_LOAD_DEFAULT);
+	FT_Render_Glyph(size->face->glyph, FT_RENDER_MODE_NORMAL);
+}
+
+
+// Glyph misses alternating between two sizes on one face
+static void benchmark_size_switch(font_face_t *face) {
+	static const char text[] = "Perfectly readable even small fonts";
+	const FT_Face ft_face = face->ft_face;
+	benchmark_result_t result = {.max_difference = -1};
+
+	FT_Size sizes[2];
+	const font_size_t pixel_sizes[2] = {24, 14};
+	for (size_t i = 0; i < 2; ++i) {
+		if (FT_New_Size(ft_face, &sizes[i])) {
+			ESP_LOGE(TAG, "Font size not allocated");
+			if (i > 0) {
+				FT_Done_Size(sizes[0]);
+			}
+			return;
+		}
+		FT_Activate_Size(sizes[i]);
+		FT_Set_Pixel_Sizes(ft_face, 0, pixel_sizes[i]);
+	}
+
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		for (const char *c = text; *c; ++c) {
+			const FT_UInt glyph_index = FT_Get_Char_Index(ft_face, (uint32_t)*c);
+			for (size_t i = 0; i < 2; ++i) {
+				BENCHMARK_TIME(result.reference_cycles, reference_switch_size(face, pixel_sizes[i], glyph_index));
+				BENCHMARK_TIME(result.cycles, switch_size(sizes[i], glyph_index));
+				result.count++;
+			}
+		}
+	}
+	face->pixel_size = 0;
+
+	FT_Done_Size(sizes[1]);
+	FT_Done_Size(sizes[0]);
+
+	benchmark_print("size switch miss", &result, "glyph");
+}
+
+
+static void reference_fill(st7789_color_t *buffer, st7789_color_t color, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		buffer[i] = color;
+	}
+}
+
+
+static void reference_fill_dither(st7789_color_t *buffer, uint8_t value, size_t width) {
+	for (size_t i = 0; i < width * BENCHMARK_BUFFER_LINES; ++i) {
+		buffer[i] = st7789_rgb_to_color_dither(0, value, 0, i % width, i / width);
+	}
+}
+
+
+static void fill_dither_pattern(st7789_color_t *buffer, uint8_t value, size_t width) {
+	st7789_color_t pattern[ST7789_DITHER_PATTERN_SIZE];
+	st7789_dither_pattern_init(pattern, 0, value, 0);
+	for (size_t line = 0; line < BENCHMARK_BUFFER_LINES; ++line) {
+		st7789_fill_span_pattern(buffer + line * width, pattern, 0, line, width);
+	}
+}
+
+
+static void reference_fill_gradient(st7789_color_t *buffer, bool dither, size_t width) {
+	for (size_t i = 0; i < width * BENCHMARK_BUFFER_LINES; ++i) {
+		const uint8_t value = (i % width) * 128 / 256;
+		if (dither) {
+			buffer[i] = st7789_rgb_to_color_dither(value, value, 0, i % width, i / width);
+		}
+		else {
+			buffer[i] = st7789_rgb_to_color(value, value, 0);
+		}
+	}
+}
+
+
+static void fill_gradient(st7789_color_t *buffer, bool dither, size_t width) {
+	st7789_gradient_t gradient;
+	st7789_gradient_init(&gradient, 0, 0, 0, 128, 128, 0, 256);
+	for (size_t line = 0; line < BENCHMARK_BUFFER_LINES; ++line) {
+		if (dither) {
+			st7789_fill_span_gradient_dither(buffer + line * width, &gradient, 0, line, width);
+		}
+		else {
+			st7789_fill_span_gradient(buffer + line * width, &gradient, width);
+		}
+	}
+}
+
+
+// Returns number of filled pixels
+static size_t reference_fill_rect(st7789_color_t *buffer, st7789_color_t color, int x, int y, int w, int h, int width) {
+	size_t pixels = 0;
+	for (int row = MAX(y, 0); row < MIN(y + h, BENCHMARK_BUFFER_LINES); ++row) {
+		for (int col = MAX(x, 0); col < MIN(x + w, width); ++col) {
+			buffer[row * width + col] = color;
+			pixels++;
+		}
+	}
+	return pixels;
+}
+
+
+static void print_fill_result(const char *name, benchmark_result_t *result, const st7789_color_t *buffer_a, const st7789_color_t *buffer_b, size_t buffer_size) {
+	char label[32];
+	snprintf(label, sizeof(label), "fill %-16s", name);
+	result->max_difference = max_channel_difference(buffer_a, buffer_b, buffer_size);
+	benchmark_print(label, result, "pixel");
+}
+
+
+// Outputs of last repeat are compared
+static void benchmark_fill(st7789_driver_t *driver, st7789_color_t *buffer_a, st7789_color_t *buffer_b) {
+	const size_t width = driver->display_width;
+	const size_t buffer_size = width * BENCHMARK_BUFFER_LINES;
+	const size_t pixels = buffer_size * BENCHMARK_REPEAT;
+	const st7789_color_t color = st7789_rgb_to_color(0, 80, 0);
+
+	// Solid fills
+	benchmark_result_t result = {.count = pixels};
+	benchmark_result_t wide_result = {.count = pixels};
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		BENCHMARK_TIME(result.reference_cycles, reference_fill(buffer_a, color, buffer_size));
+		BENCHMARK_TIME(wide_result.cycles, st7789_fill_span_wide(buffer_b, color, buffer_size));
+		BENCHMARK_TIME(result.cycles, st7789_fill_span(buffer_b, color, buffer_size));
+	}
+	wide_result.reference_cycles = result.reference_cycles;
+	print_fill_result("span", &result, buffer_a, buffer_b, buffer_size);
+	print_fill_result("span wide", &wide_result, buffer_a, buffer_b, buffer_size);
+
+	// Dithered solid color
+	result = (benchmark_result_t){.count = pixels};
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		const uint8_t value = repeat * 5;
+		BENCHMARK_TIME(result.reference_cycles, reference_fill_dither(buffer_a, value, width));
+		BENCHMARK_TIME(result.cycles, fill_dither_pattern(buffer_b, value, width));
+	}
+	print_fill_result("dither pattern", &result, buffer_a, buffer_b, buffer_size);
+
+	// Gradients
+	for (size_t dither = 0; dither < 2; ++dither) {
+		result = (benchmark_result_t){.count = pixels};
+		for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+			BENCHMARK_TIME(result.reference_cycles, reference_fill_gradient(buffer_a, dither, width));
+			BENCHMARK_TIME(result.cycles, fill_gradient(buffer_b, dither, width));
+		}
+		print_fill_result(dither ? "gradient dither" : "gradient", &result, buffer_a, buffer_b, buffer_size);
+	}
+
+	// Rectangles partially outside of strip
+	result = (benchmark_result_t){0};
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		const int x = (int)repeat * 7 - 20;
+		const int y = (int)repeat - 5;
+		const int w = 101 + repeat;
+		const int h = 13;
+		fill_test_pattern(buffer_a, buffer_size);
+		fill_test_pattern(buffer_b, buffer_size);
+		BENCHMARK_TIME(result.reference_cycles, result.count += reference_fill_rect(buffer_a, color, x, y, w, h, width));
+		BENCHMARK_TIME(result.cycles, st7789_fill_rect(buffer_b, color, x, y, w, h, width, BENCHMARK_BUFFER_LINES));
+	}
+	print_fill_result("rect", &result, buffer_a, buffer_b, buffer_size);
+}
+
+
+// Strip of RGB line converted with dither table randomized for every frame
+static void reference_dither_rgb(st7789_color_t *buffer, const uint8_t *rgb, size_t width) {
+	reference_randomize_dither_table();
+	for (size_t line = 0; line < BENCHMARK_BUFFER_LINES; ++line) {
+		for (size_t i = 0; i < width; ++i) {
+			const uint8_t *color = rgb + i * 3;
+			buffer[line * width + i] = reference_rgb_to_color_dither(color[0], color[1], color[2], i, line);
+		}
+	}
+}
+
+
+static void dither_rgb(st7789_color_t *buffer, const uint8_t *rgb, size_t width) {
+	st7789_dither_next_frame();
+	for (size_t line = 0; line < BENCHMARK_BUFFER_LINES; ++line) {
+		for (size_t i = 0; i < width; ++i) {
+			const uint8_t *color = rgb + i * 3;
+			buffer[line * width + i] = st7789_rgb_to_color_dither(color[0], color[1], color[2], i, line);
+		}
+	}
+}
+
+
+static void dither_rgb_spans(st7789_color_t *buffer, const uint8_t *rgb, size_t width) {
+	st7789_dither_next_frame();
+	for (size_t line = 0; line < BENCHMARK_BUFFER_LINES; ++line) {
+		st7789_rgb_to_color_dither_span(buffer + line * width, rgb, width, 0, line);
+	}
+}
+
+
+static void benchmark_dither(st7789_driver_t *driver, st7789_color_t *buffer_a, st7789_color_t *buffer_b) {
+	const size_t width = driver->display_width;
+	const size_t buffer_size = width * BENCHMARK_BUFFER_LINES;
+	const size_t pixels = buffer_size * BENCHMARK_REPEAT;
+	uint8_t *rgb = (uint8_t *)heap_caps_malloc(width * 3, MALLOC_CAP_DEFAULT);
+	// Per pixel result, buffer_b is overwritten by span conversion
+	st7789_color_t *pixel_buffer = (st7789_color_t *)heap_caps_malloc(buffer_size * sizeof(st7789_color_t), MALLOC_CAP_DEFAULT);
+	if (!rgb || !pixel_buffer) {
+		ESP_LOGE(TAG, "Dither benchmark buffer not allocated");
+		heap_caps_free(rgb);
+		heap_caps_free(pixel_buffer);
+		return;
+	}
+	for (size_t i = 0; i < width; ++i) {
+		rgb[i * 3] = i;
+		rgb[i * 3 + 1] = 255 - i;
+		rgb[i * 3 + 2] = i * 3;
+	}
+
+	benchmark_result_t pixel_result = {.count = pixels};
+	benchmark_result_t span_result = {.count = pixels};
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		BENCHMARK_TIME(pixel_result.reference_cycles, reference_dither_rgb(buffer_a, rgb, width));
+		BENCHMARK_TIME(pixel_result.cycles, dither_rgb(buffer_b, rgb, width));
+		memcpy(pixel_buffer, buffer_b, buffer_size * sizeof(st7789_color_t));
+		BENCHMARK_TIME(span_result.cycles, dither_rgb_spans(buffer_b, rgb, width));
+	}
+	span_result.reference_cycles = pixel_result.reference_cycles;
+	pixel_result.max_difference = max_channel_difference(buffer_a, pixel_buffer, buffer_size);
+	span_result.max_difference = max_channel_difference(buffer_a, buffer_b, buffer_size);
+	benchmark_print("dither ordered       ", &pixel_result, "pixel");
+	benchmark_print("dither ordered span  ", &span_result, "pixel");
+
+	heap_caps_free(pixel_buffer);
+	heap_caps_free(rgb);
+}
+
+
+static const char *benchmark_lines[] = {
+	"Lorem ipsum dolor sit amet,",
+	"consectetur adipiscing elit.",
+	"Pellentesque tristique quam sit",
+	"amet dolor sagittis lacinia.",
+	"Phasellus non dui sed orci",
+	"vehicula faucibus ut vitae dui.",
+	"Duis pulvinar sem risus, quis",
+	"bibendum elit consequat vel.",
+	"Cras eget fermentum magna.",
+	"Maecenas eu pretium diam,",
+	"sed tempor ex.",
+};
+
+
+// Text decoded and looked up glyph by glyph on every strip
+static void reference_render_text(const char *text, font_render_t *render, st7789_color_t *buffer, int target_w, int src_y, int y) {
+	if (src_y - y >= BENCHMARK_BUFFER_LINES || src_y + (int)render->max_pixel_height - y < 0) {
+		return;
+	}
+	int src_x = 8;
+	while (*text) {
+		uint32_t glyph;
+		text += u8_decode(&glyph, text);
+		font_render_glyph(render, glyph);
+		st7789_draw_gray2_spans(render->bitmap, buffer, 255, 255, 255, src_x + render->bitmap_left, render->max_pixel_height - render->origin - render->bitmap_top + src_y - y, render->bitmap_width, render->bitmap_height, target_w, BENCHMARK_BUFFER_LINES);
+		src_x += render->advance;
+	}
+}
+
+
+static void run_render_text(const char *text, font_render_t *render, st7789_color_t *buffer, int target_w, int src_y, int y) {
+	if (src_y - y >= BENCHMARK_BUFFER_LINES || src_y + (int)render->max_pixel_height - y < 0) {
+		return;
+	}
+	const text_run_t *run = text_run_get(text, render);
+	for (size_t i = 0; i < run->layout.glyph_count; ++i) {
+		const font_string_glyph_t *glyph = &run->layout.glyphs[i];
+		const int glyph_y = src_y + glyph->y - y;
+		if (glyph_y >= BENCHMARK_BUFFER_LINES || glyph_y + glyph->height <= 0) {
+			continue;
+		}
+		font_render_glyph(render, glyph->utf_code);
+		st7789_draw_gray2_spans(render->bitmap, buffer, 255, 255, 255, 8 + glyph->x, glyph_y, render->bitmap_width, render->bitmap_height, target_w, BENCHMARK_BUFFER_LINES);
+	}
+}
+
+
+typedef void (*benchmark_text_func_t)(const char *text, font_render_t *render, st7789_color_t *buffer, int target_w, int src_y, int y);
+
+
+static void draw_text_frame(st7789_driver_t *driver, benchmark_text_func_t render_text, font_render_t *render, st7789_color_t *buffer) {
+	const size_t line_count = sizeof(benchmark_lines) / sizeof(benchmark_lines[0]);
+	for (int y = 0; y < driver->display_height; y += BENCHMARK_BUFFER_LINES) {
+		for (size_t line = 0; line < line_count; ++line) {
+			render_text(benchmark_lines[line], render, buffer, driver->display_width, 8 + line * 20, y);
+		}
+	}
+}
+
+
+// Paragraph of lorem ipsum demo drawn to all strips of frame
+static void benchmark_text_run(st7789_driver_t *driver, font_face_t *face, st7789_color_t *buffer) {
+	font_render_t render = {0};
+	ESP_ERROR_CHECK(font_render_init(&render, face, 14));
+	benchmark_result_t result = {.max_difference = -1};
+
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		BENCHMARK_TIME(result.reference_cycles, draw_text_frame(driver, reference_render_text, &render, buffer));
+		BENCHMARK_TIME(result.cycles, draw_text_frame(driver, run_render_text, &render, buffer));
+		result.count++;
+	}
+
+	benchmark_print("text run", &result, "frame");
+
+	text_run_clear();
+	font_render_destroy(&render);
+}
+
+
+static const font_string_set_t *benchmark_strings[] = {
+	&ui_strings_with_dithering,
+	&ui_strings_without_dithering,
+	&ui_strings_perfectly_readable,
+	&ui_strings_even_small_fonts,
+};
+
+
+static void layout_strings(font_render_t *render) {
+	for (size_t line = 0; line < sizeof(benchmark_strings) / sizeof(benchmark_strings[0]); ++line) {
+		text_run_get(benchmark_strings[line]->text, render);
+	}
+}
+
+
+static void resolve_strings(font_render_t *render) {
+	for (size_t line = 0; line < sizeof(benchmark_strings) / sizeof(benchmark_strings[0]); ++line) {
+		font_render_string(render, benchmark_strings[line]);
+	}
+}
+
+
+// Layout of demo labels on first frame, runs are shaped while precompiled
+// strings are only selected, glyphs are cached before measurement
+static void benchmark_precompiled_strings(font_face_t *face) {
+	font_render_t render = {0};
+	ESP_ERROR_CHECK(font_render_init(&render, face, 14));
+	const size_t line_count = sizeof(benchmark_strings) / sizeof(benchmark_strings[0]);
+	benchmark_result_t result = {.max_difference = -1};
+	size_t mismatches = 0;
+
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		text_run_clear();
+		BENCHMARK_TIME(result.reference_cycles, layout_strings(&render));
+		BENCHMARK_TIME(result.cycles, resolve_strings(&render));
+		result.count++;
+	}
+
+	for (size_t line = 0; line < line_count; ++line) {
+		const font_string_t *string = font_render_string(&render, benchmark_strings[line]);
+		const text_run_t *run = text_run_get(benchmark_strings[line]->text, &render);
+		if (!string || string->glyph_count != run->layout.glyph_count || string->advance != run->layout.advance || memcmp(string->glyphs, run->layout.glyphs, string->glyph_count * sizeof(font_string_glyph_t)) != 0) {
+			mismatches++;
+		}
+	}
+
+	benchmark_print("precompiled strings", &result, "frame");
+	printf("precompiled strings: %zu mismatched\n", mismatches);
+
+	text_run_clear();
+	font_render_destroy(&render);
+}
+
+
+static int reference_measure_text(const char *text, font_render_t *render) {
+	int width = 0;
+	while (*text) {
+		uint32_t glyph;
+		text += u8_decode(&glyph, text);
+		if (font_load_glyph_metrics(render, glyph) == ESP_OK) {
+			width += render->metrics.horiAdvance >> 6;
+		}
+	}
+	return width;
+}
+
+
+static void reference_measure_lines(font_render_t *render) {
+	for (size_t line = 0; line < sizeof(benchmark_lines) / sizeof(benchmark_lines[0]); ++line) {
+		reference_measure_text(benchmark_lines[line], render);
+	}
+}
+
+
+static void measure_lines(font_render_t *render) {
+	for (size_t line = 0; line < sizeof(benchmark_lines) / sizeof(benchmark_lines[0]); ++line) {
+		text_metrics_t metrics;
+		text_measure(benchmark_lines[line], render, &metrics);
+	}
+}
+
+
+// Width of every lorem ipsum line as for alignment on each frame
+static void benchmark_text_measure(font_face_t *face) {
+	font_render_t render = {0};
+	ESP_ERROR_CHECK(font_render_init(&render, face, 14));
+	const size_t line_count = sizeof(benchmark_lines) / sizeof(benchmark_lines[0]);
+	benchmark_result_t result = {.max_difference = -1};
+	size_t mismatches = 0;
+
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		BENCHMARK_TIME(result.reference_cycles, reference_measure_lines(&render));
+		BENCHMARK_TIME(result.cycles, measure_lines(&render));
+		result.count++;
+	}
+
+	for (size_t line = 0; line < line_count; ++line) {
+		text_metrics_t metrics;
+		text_measure(benchmark_lines[line], &render, &metrics);
+		if (metrics.width != reference_measure_text(benchmark_lines[line], &render)) {
+			mismatches++;
+		}
+	}
+
+	benchmark_print("text measure", &result, "frame");
+	printf("text measure: %zu mismatched\n", mismatches);
+
+	font_render_destroy(&render);
+}
+
+
+// Decoder before validation, reads continuation bytes without checking them
+static uint8_t reference_u8_decode(uint32_t *ucode, const uint8_t *str) {
+	*ucode = 0;
+	if (*str == 0) {
+		return 0;
+	}
+	else if (*str < 0x80) {
+		*ucode = *str;
+		return 1;
+	}
+	else if (*str < 0xe0) {
+		*ucode = *str & 0x1f;
+		*ucode = (*ucode << 6) | (*++str & 0x3f);
+		return 2;
+	}
+	else if (*str < 0xf0) {
+		*ucode = *str & 0x0f;
+		*ucode = (*ucode << 6) | (*++str & 0x3f);
+		*ucode = (*ucode << 6) | (*++str & 0x3f);
+		return 3;
+	}
+	else if (*str < 0xf5) {
+		*ucode = *str & 0x07;
+		*ucode = (*ucode << 6) | (*++str & 0x3f);
+		*ucode = (*ucode << 6) | (*++str & 0x3f);
+		*ucode = (*ucode << 6) | (*++str & 0x3f);
+		return 4;
+	}
+	return 0;
+}
+
+
+typedef struct benchmark_corpus {
+	const char *name;
+	const char *text;
+} benchmark_corpus_t;
+
+static const benchmark_corpus_t benchmark_corpora[] = {
+	{"ascii", "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed tempor ex, 12:45 [ok]"},
+	{"latin", "Příliš žluťoučký kůň úpěl ďábelské ódy. Größe, Straße, garçon, señor, smørrebrød."},
+	{"cyrillic", "Съешь же ещё этих мягких французских булок, да выпей чаю. Температура 21 °C"},
+	{"mixed", "Menu: 設定 / Настройки / Ρυθμίσεις / 설정, 42 °C ✓ 🔋 80 %, ready"},
+	{"cjk", "吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。"},
+};
+
+
+static size_t reference_decode_text(uint32_t *codes, size_t max_count, const char *text) {
+	size_t count = 0;
+	for (const uint8_t *pos = (const uint8_t *)text; *pos && count < max_count;) {
+		pos += reference_u8_decode(&codes[count++], pos);
+	}
+	return count;
+}
+
+
+static size_t decode_text(uint32_t *codes, size_t max_count, const char *text) {
+	size_t count = 0;
+	for (const char *pos = text; *pos && count < max_count;) {
+		pos += u8_decode(&codes[count++], pos);
+	}
+	return count;
+}
+
+
+// Per call decoding against bulk decoding to code array on valid texts
+static void benchmark_utf8_decode(void) {
+	uint32_t codes[128];
+	uint32_t reference_codes[128];
+	const size_t max_count = sizeof(codes) / sizeof(codes[0]);
+	for (size_t corpus = 0; corpus < sizeof(benchmark_corpora) / sizeof(benchmark_corpora[0]); ++corpus) {
+		const char *text = benchmark_corpora[corpus].text;
+		const size_t length = strlen(text);
+		// Both share reference of decoder before validation
+		benchmark_result_t per_call = {.max_difference = -1};
+		benchmark_result_t bulk = {.max_difference = -1};
+		size_t reference_count = 0;
+		size_t count = 0;
+
+		for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+			BENCHMARK_TIME(per_call.reference_cycles, reference_count = reference_decode_text(reference_codes, max_count, text));
+			BENCHMARK_TIME(per_call.cycles, count = decode_text(codes, max_count, text));
+			BENCHMARK_TIME(bulk.cycles, count = u8_decode_buffer(codes, max_count, text, length, U8_INVALID_REPLACE, NULL, NULL));
+		}
+		per_call.count = length * BENCHMARK_REPEAT;
+		bulk.reference_cycles = per_call.reference_cycles;
+		bulk.count = per_call.count;
+
+		size_t mismatches = reference_count > count ? reference_count - count : count - reference_count;
+		for (size_t i = 0; i < MIN(count, reference_count); ++i) {
+			mismatches += codes[i] != reference_codes[i];
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "utf8 decode %-8s", benchmark_corpora[corpus].name);
+		benchmark_print(name, &per_call, "byte");
+		snprintf(name, sizeof(name), "utf8 bulk   %-8s", benchmark_corpora[corpus].name);
+		benchmark_print(name, &bulk, "byte");
+		printf("utf8 decode %-8s: %zu mismatched\n", benchmark_corpora[corpus].name, mismatches);
+	}
+}
+
+
+// Breaks after spaces and new lines as layout did before UAX #14 breaking
+static size_t reference_count_breaks(const uint32_t *codes, size_t count) {
+	size_t opportunities = 0;
+	for (size_t i = 1; i < count; ++i) {
+		opportunities += codes[i - 1] == '\n' || (codes[i - 1] == ' ' && codes[i] != ' ');
+	}
+	return opportunities;
+}
+
+
+static size_t count_breaks(const uint32_t *codes, size_t count) {
+	u8_line_break_t breaker;
+	u8_line_break_init(&breaker);
+	size_t opportunities = 0;
+	for (size_t i = 0; i < count; ++i) {
+		opportunities += u8_line_break_next(&breaker, codes[i]) != U8_BREAK_PROHIBITED;
+	}
+	return opportunities;
+}
+
+
+// Break opportunities of decoded texts, as wrapping them on every frame
+static void benchmark_line_break(void) {
+	uint32_t codes[128];
+	for (size_t corpus = 0; corpus < sizeof(benchmark_corpora) / sizeof(benchmark_corpora[0]); ++corpus) {
+		const char *text = benchmark_corpora[corpus].text;
+		const size_t count = u8_decode_buffer(codes, sizeof(codes) / sizeof(codes[0]), text, strlen(text), U8_INVALID_REPLACE, NULL, NULL);
+		benchmark_result_t result = {.max_difference = -1};
+		size_t reference_opportunities = 0;
+		size_t opportunities = 0;
+		for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+			BENCHMARK_TIME(result.reference_cycles, reference_opportunities = reference_count_breaks(codes, count));
+			BENCHMARK_TIME(result.cycles, opportunities = count_breaks(codes, count));
+		}
+		result.count = count * BENCHMARK_REPEAT;
+		char name[32];
+		snprintf(name, sizeof(name), "line break %-8s", benchmark_corpora[corpus].name);
+		benchmark_print(name, &result, "code");
+		printf("%s: %zu -> %zu opportunities in %zu codes\n", name, reference_opportunities, opportunities, count);
+	}
+}
+
+
+static bool benchmark_layout_equal(const text_layout_t *a, const text_layout_t *b) {
+	return a->line_count == b->line_count && memcmp(a->lines, b->lines, a->line_count * sizeof(text_layout_line_t)) == 0;
+}
+
+
+static void layout_text(text_layout_t *layout, font_render_t *render, int width, const char *text) {
+	ESP_ERROR_CHECK(text_layout_init(layout, render, width, 20, TEXT_ALIGN_LEFT));
+	ESP_ERROR_CHECK(text_layout_set_text(layout, text));
+}
+
+
+// Log view of many paragraphs, new message is appended and view is resized,
+// incremental relayout is compared with layout from scratch
+static void benchmark_paragraph_layout(font_face_t *face) {
+	font_render_t render = {0};
+	ESP_ERROR_CHECK(font_render_init(&render, face, 14));
+	const size_t line_count = sizeof(benchmark_lines) / sizeof(benchmark_lines[0]);
+	const size_t repeat_count = 20;
+	size_t length = 0;
+	for (size_t line = 0; line < line_count; ++line) {
+		length += strlen(benchmark_lines[line]) + 1;
+	}
+	char *text = (char *)heap_caps_malloc(length * (repeat_count + 1) + 1, MALLOC_CAP_DEFAULT);
+	char *pos = text;
+	for (size_t repeat = 0; repeat <= repeat_count; ++repeat) {
+		for (size_t line = 0; line < line_count; ++line) {
+			pos += sprintf(pos, "%s%c", benchmark_lines[line], line + 1 == line_count ? '\n' : ' ');
+		}
+	}
+	const size_t log_length = length * repeat_count;
+
+	text_layout_t reference;
+	text_layout_t layout;
+	// Full layout of text is reference for both appending and resizing
+	benchmark_result_t append = {.max_difference = -1};
+	benchmark_result_t resize = {.max_difference = -1};
+	size_t mismatches = 0;
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		const int width = 200 + (int)repeat;
+		text[log_length] = '\0';
+		layout_text(&layout, &render, width, text);
+		text[log_length] = benchmark_lines[0][0];
+
+		BENCHMARK_TIME(append.reference_cycles, layout_text(&reference, &render, width, text));
+		BENCHMARK_TIME(append.cycles, ESP_ERROR_CHECK(text_layout_set_text(&layout, text)));
+		append.count++;
+		mismatches += !benchmark_layout_equal(&layout, &reference);
+		text_layout_destroy(&reference);
+
+		BENCHMARK_TIME(resize.reference_cycles, layout_text(&reference, &render, width - 8, text));
+		BENCHMARK_TIME(resize.cycles, ESP_ERROR_CHECK(text_layout_set_width(&layout, width - 8)));
+		resize.count++;
+		mismatches += !benchmark_layout_equal(&layout, &reference);
+
+		text_layout_destroy(&reference);
+		text_layout_destroy(&layout);
+	}
+
+	benchmark_print("paragraph append", &append, "layout");
+	benchmark_print("paragraph resize", &resize, "layout");
+	printf("paragraph layout: %zu mismatched\n", mismatches);
+
+	heap_caps_free(text);
+	font_render_destroy(&render);
+}
+
+
+// Lines of paragraph decoded and looked up glyph by glyph on every strip
+static void reference_render_paragraph(const text_layout_t *layout, st7789_color_t *buffer, int target_w, int y) {
+	font_render_t *render = layout->render;
+	for (size_t i = 0; i < layout->line_count; ++i) {
+		const int line_y = 8 + (int)i * layout->line_height - y;
+		if (line_y >= BENCHMARK_BUFFER_LINES || line_y + (int)render->max_pixel_height <= 0) {
+			continue;
+		}
+		const text_layout_line_t *line = &layout->lines[i];
+		int x = 8;
+		for (const char *text = layout->text + line->start; text < layout->text + line->end;) {
+			uint32_t utf_code;
+			text += u8_decode(&utf_code, text);
+			if (font_render_glyph(render, utf_code) != ESP_OK) {
+				continue;
+			}
+			st7789_draw_gray2_spans(render->bitmap, buffer, 255, 255, 255, x + render->bitmap_left, line_y + render->max_pixel_height - render->origin - render->bitmap_top, render->bitmap_width, render->bitmap_height, target_w, BENCHMARK_BUFFER_LINES);
+			x += render->advance;
+		}
+	}
+}
+
+
+static void layout_render_paragraph(text_layout_t *layout, st7789_color_t *buffer, int target_w, int y) {
+	font_render_t *render = layout->render;
+	for (size_t i = 0; i < layout->line_count; ++i) {
+		const int line_y = 8 + (int)i * layout->line_height - y;
+		if (line_y >= BENCHMARK_BUFFER_LINES || line_y + (int)render->max_pixel_height <= 0) {
+			continue;
+		}
+		const font_string_glyph_t *glyphs;
+		size_t glyph_count;
+		int pen;
+		ESP_ERROR_CHECK(text_layout_line_glyphs(layout, &layout->lines[i], &glyphs, &glyph_count, &pen));
+		for (size_t j = 0; j < glyph_count; ++j) {
+			const font_string_glyph_t *glyph = &glyphs[j];
+			const int glyph_x = 8 + glyph->x - pen;
+			const int glyph_y = line_y + glyph->y;
+			if (glyph_y >= BENCHMARK_BUFFER_LINES || glyph_y + glyph->height <= 0 || glyph_x >= target_w || glyph_x + glyph->width <= 0) {
+				continue;
+			}
+			if (font_render_glyph(render, glyph->utf_code) != ESP_OK) {
+				continue;
+			}
+			st7789_draw_gray2_spans(render->bitmap, buffer, 255, 255, 255, glyph_x, glyph_y, render->bitmap_width, render->bitmap_height, target_w, BENCHMARK_BUFFER_LINES);
+		}
+	}
+}
+
+
+// Lines of lorem ipsum demo joined by spaces to one paragraph
+static void benchmark_paragraph_text(char *text) {
+	const size_t line_count = sizeof(benchmark_lines) / sizeof(benchmark_lines[0]);
+	for (size_t line = 0; line < line_count; ++line) {
+		text += sprintf(text, line + 1 == line_count ? "%s" : "%s ", benchmark_lines[line]);
+	}
+}
+
+
+// Wrapped paragraph of lorem ipsum demo drawn to all strips of frame, glyphs
+// placed once for whole text are compared with decoding lines on each strip
+static void benchmark_paragraph_draw(st7789_driver_t *driver, font_face_t *face, st7789_color_t *buffer_a, st7789_color_t *buffer_b) {
+	const size_t buffer_size = driver->display_width * BENCHMARK_BUFFER_LINES;
+	font_render_t render = {0};
+	ESP_ERROR_CHECK(font_render_init(&render, face, 14));
+	text_layout_t layout;
+	ESP_ERROR_CHECK(text_layout_init(&layout, &render, driver->display_width - 16, 20, TEXT_ALIGN_LEFT));
+	char text[512];
+	benchmark_paragraph_text(text);
+	ESP_ERROR_CHECK(text_layout_set_text(&layout, text));
+	benchmark_result_t result = {0};
+
+	for (size_t repeat = 0; repeat < BENCHMARK_REPEAT; ++repeat) {
+		for (int y = 0; y < driver->display_height; y += BENCHMARK_BUFFER_LINES) {
+			st7789_fill_span(buffer_a, 0x0000, buffer_size);
+			st7789_fill_span(buffer_b, 0x0000, buffer_size);
+			BENCHMARK_TIME(result.reference_cycles, reference_render_paragraph(&layout, buffer_a, driver->display_width, y));
+			BENCHMARK_TIME(result.cycles, layout_render_paragraph(&layout, buffer_b, driver->display_width, y));
+			result.max_difference = MAX(result.max_difference, max_channel_difference(buffer_a, buffer_b, buffer_size));
+		}
+		result.count++;
+	}
+
+	benchmark_print("paragraph draw", &result, "frame");
+
+	text_layout_destroy(&layout);
+	font_render_destroy(&render);
+}
+
+
+static void first_use(font_face_t *face, font_render_t *render, bool prerendered) {
+	if (prerendered) {
+		ESP_ERROR_CHECK(font_face_init_prerendered(face, prerendered_start, prerendered_end - prerendered_start));
+	}
+	else {
+		ESP_ERROR_CHECK(font_face_init(face, ttf_start, ttf_end - ttf_start));
+	}
+	ESP_ERROR_CHECK(font_render_init(render, face, 14));
+	for (uint32_t c = 0x20; c < 0x7f; ++c) {
+		font_render_glyph(render, c);
+	}
+}
+
+
+// Returns heap used by face and render after first use
+static size_t benchmark_first_use(bool prerendered, uint32_t *cycles) {
+	font_face_t face;
+	font_render_t render = {0};
+	const size_t free_size = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+	BENCHMARK_TIME(*cycles, first_use(&face, &render, prerendered));
+	const size_t heap = free_size - heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+	font_render_destroy(&render);
+	font_face_destroy(&face);
+	return heap;
+}
+
+
+// First use of new face, FreeType loads face and renders every glyph, while
+// prerendered face only looks glyphs up in flash
+static void benchmark_prerendered(void) {
+	benchmark_result_t result = {.count = 1, .max_difference = -1};
+	const size_t freetype_heap = benchmark_first_use(false, &result.reference_cycles);
+	const size_t prerendered_heap = benchmark_first_use(true, &result.cycles);
+	benchmark_print("prerendered first use", &result, "face");
+	printf("prerendered first use: %zu -> %zu bytes\n", freetype_heap, prerendered_heap);
+}
+
+
+// First frame of text at new size, glyphs are loaded in strip callbacks or
+// prefetched before frame by worker on other core, faces are separate, so
+// both start with empty cache
+static void benchmark_prefetch(void) {
+	if (font_prefetch_start(portNUM_PROCESSORS - 1) != ESP_OK) {
+		return;
+	}
+	font_face_t faces[2];
+	font_render_t renders[2] = {0};
+	for (size_t i = 0; i < 2; ++i) {
+		ESP_ERROR_CHECK(font_face_init(&faces[i], ttf_start, ttf_end - ttf_start));
+		ESP_ERROR_CHECK(font_render_init(&renders[i], &faces[i], 18));
+	}
+	renders[1].miss_policy = FONT_MISS_PLACEHOLDER;
+	const size_t line_count = sizeof(benchmark_lines) / sizeof(benchmark_lines[0]);
+
+	// Whole paragraph is one request batch, sorted letters merge to few ranges
+	char text[512];
+	benchmark_paragraph_text(text);
+	const esp_err_t ret = text_prefetch(text, &renders[1]);
+	font_prefetch_wait();
+
+	benchmark_result_t result = {.max_difference = -1};
+	size_t late = 0;
+	for (size_t line = 0; line < line_count && ret == ESP_OK; ++line) {
+		for (const char *text = benchmark_lines[line]; *text;) {
+			uint32_t utf_code;
+			text += u8_decode(&utf_code, text);
+			BENCHMARK_TIME(result.reference_cycles, font_render_glyph(&renders[0], utf_code));
+			BENCHMARK_TIME(result.cycles, late += font_render_glyph(&renders[1], utf_code) == ESP_ERR_NOT_FINISHED);
+		}
+		result.count++;
+	}
+
+	if (ret == ESP_OK) {
+		benchmark_print("glyph prewarm", &result, "line");
+		printf("glyph prewarm: %zu late\n", late);
+	}
+	else {
+		printf("glyph prewarm: not queued, %s\n", esp_err_to_name(ret));
+	}
+
+	for (size_t i = 0; i < 2; ++i) {
+		font_render_destroy(&renders[i]);
+		font_face_destroy(&faces[i]);
+	}
+	font_prefetch_stop();
+}
+
+
+void benchmark_run(st7789_driver_t *driver, font_face_t *face) {
+	const size_t buffer_size = driver->display_width * BENCHMARK_BUFFER_LINES;
+	st7789_color_t *buffer_a = (st7789_color_t *)heap_caps_malloc(buffer_size * sizeof(st7789_color_t), MALLOC_CAP_DEFAULT);
+	st7789_color_t *buffer_b = (st7789_color_t *)heap_caps_malloc(buffer_size * sizeof(st7789_color_t), MALLOC_CAP_DEFAULT);
+	if (!buffer_a || !buffer_b) {
+		ESP_LOGE(TAG, "Benchmark buffers not allocated");
+		heap_caps_free(buffer_a);
+		heap_caps_free(buffer_b);
+		return;
+	}
+
+	st7789_dither_set_mode(ST7789_DITHER_BLUE_NOISE, true);
+	benchmark_dither(driver, buffer_a, buffer_b);
+	st7789_dither_set_mode(ST7789_DITHER_BLUE_NOISE, false);
+	benchmark_fill(driver, buffer_a, buffer_b);
+	benchmark_gray2_bitmap(driver, face, buffer_a, buffer_b, 24);
+	benchmark_gray2_bitmap(driver, face, buffer_a, buffer_b, 200);
+	benchmark_coverage_depth(driver, face, buffer_a, buffer_b, 14);
+	benchmark_coverage_depth(driver, face, buffer_a, buffer_b, 96);
+	benchmark_gray2_spans(driver, face, buffer_a, buffer_b, 24);
+	benchmark_gray2_spans(driver, face, buffer_a, buffer_b, 200);
+	benchmark_gray2_palette(driver, face, buffer_a, buffer_b, 14);
+	benchmark_gray2_palette(driver, face, buffer_a, buffer_b, 16);
+	benchmark_size_switch(face);
+	benchmark_sdf_zoom(driver, face, buffer_a);
+	benchmark_outline_cache(face);
+	benchmark_direct_spans(driver, face, buffer_a);
+	benchmark_prerendered();
+	benchmark_text_run(driver, face, buffer_a);
+	benchmark_precompiled_strings(face);
+	benchmark_utf8_decode();
+	benchmark_line_break();
+	benchmark_text_measure(face);
+	benchmark_paragraph_layout(face);
+	benchmark_paragraph_draw(driver, face, buffer_a, buffer_b);
+	benchmark_prefetch();
+
+	heap_caps_free(buffer_b);
+	heap_caps_free(buffer_a);
+}
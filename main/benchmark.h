@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "font_render.h"
+#include "st7789.h"
+
+
+// Run all benchmarks and print results to console
+void benchmark_run(st7789_driver_t *driver, font_face_t *face);
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: MIT
 
 #include <math.h>
+#include <sys/param.h>
 
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
@@ -9,9 +10,12 @@
 #include "freertos/task.h"
 #include "soc/cpu.h"
 
-#include "unicode.h"
+#include "benchmark.h"
 #include "font_render.h"
 #include "st7789.h"
+#include "text_layout.h"
+#include "text_run.h"
+#include "ui_strings.h"
 
 
 #define ST7789_GPIO_RESET GPIO_NUM_19
@@ -25,12 +29,17 @@
 #define ST7789_BUFFER_SIZE 20
 
 
-extern const uint8_t ttf_start[] asm("_binary_Ubuntu_R_ttf_start");
-extern const uint8_t ttf_end[] asm("_binary_Ubuntu_R_ttf_end");
+extern const uint8_t ttf_start[] asm("_binary_Ubuntu_R_subset_ttf_start");
+extern const uint8_t ttf_end[] asm("_binary_Ubuntu_R_subset_ttf_end");
+extern const uint8_t prerendered_start[] asm("_binary_Ubuntu_R_prerendered_bin_start");
+extern const uint8_t prerendered_end[] asm("_binary_Ubuntu_R_prerendered_bin_end");
 
 static font_render_t font_render;
 static font_render_t font_render2;
 static font_face_t font_face;
+// Fixed size text served from flash without FreeType
+static font_face_t prerendered_face;
+static text_layout_t lorem_ipsum_layout;
 
 
 #define DRAW_EVENT_START 0xfffc
@@ -60,27 +69,182 @@ typedef struct animation_step {
 } animation_step_t;
 
 
-static void render_text(const char *text, font_render_t *render, st7789_driver_t *driver, int src_x, int src_y, int y, uint8_t color_r, uint8_t color_g, uint8_t color_b) {
+typedef struct glyph_span_target {
+	st7789_color_t *buffer;
+	int width;
+	// Visible corner of glyph, origin of dither tile
+	int dither_x;
+	int dither_y;
+	st7789_coverage_color_t color;
+} glyph_span_target_t;
+
+
+static void draw_glyph_span(int x, int y, int length, uint8_t coverage, void *user_data) {
+	const glyph_span_target_t *target = (const glyph_span_target_t *)user_data;
+	st7789_blend_coverage_span(&target->color, target->buffer + y * target->width + x, coverage, x - target->dither_x, y - target->dither_y, length);
+}
+
+
+static void draw_glyph(font_render_t *render, st7789_driver_t *driver, int x, int y, uint8_t color_r, uint8_t color_g, uint8_t color_b) {
+	if (render->bitmap_format == FONT_BITMAP_OUTLINE) {
+		if (y >= ST7789_BUFFER_SIZE || y + (int)render->bitmap_height <= 0) {
+			return;
+		}
+		glyph_span_target_t target = {
+			.buffer = driver->current_buffer,
+			.width = driver->display_width,
+			.dither_x = MAX(x, 0),
+			.dither_y = MAX(y, 0),
+		};
+		st7789_coverage_color_init(&target.color, color_r, color_g, color_b);
+		font_render_draw_spans(render, x, y, driver->display_width, ST7789_BUFFER_SIZE, draw_glyph_span, &target);
+	}
+	else if (render->bitmap_format == FONT_BITMAP_SDF) {
+		st7789_draw_sdf(render->bitmap, driver->current_buffer, color_r, color_g, color_b, x * 256, y * 256, render->glyph->bitmap_width, render->glyph->bitmap_height, render->sdf_scale, FONT_SDF_SPREAD, driver->display_width, ST7789_BUFFER_SIZE);
+	}
+	else if (render->bitmap_format == FONT_BITMAP_GRAY2_SPANS) {
+		st7789_draw_gray2_spans(render->bitmap, driver->current_buffer, color_r, color_g, color_b, x, y, render->bitmap_width, render->bitmap_height, driver->display_width, ST7789_BUFFER_SIZE);
+	}
+	else if (render->bitmap_format == FONT_BITMAP_GRAY1) {
+		st7789_draw_gray1_bitmap(render->bitmap, driver->current_buffer, color_r, color_g, color_b, x, y, render->bitmap_width, render->bitmap_height, driver->display_width, ST7789_BUFFER_SIZE);
+	}
+	else if (render->bitmap_format == FONT_BITMAP_GRAY4) {
+		st7789_draw_gray4_bitmap(render->bitmap, driver->current_buffer, color_r, color_g, color_b, x, y, render->bitmap_width, render->bitmap_height, driver->display_width, ST7789_BUFFER_SIZE);
+	}
+	else if (render->bitmap_format == FONT_BITMAP_GRAY8) {
+		st7789_draw_gray8_bitmap(render->bitmap, driver->current_buffer, color_r, color_g, color_b, x, y, render->bitmap_width, render->bitmap_height, driver->display_width, ST7789_BUFFER_SIZE);
+	}
+	else {
+		st7789_draw_gray2_bitmap(render->bitmap, driver->current_buffer, color_r, color_g, color_b, x, y, render->bitmap_width, render->bitmap_height, driver->display_width, ST7789_BUFFER_SIZE);
+	}
+}
+
+
+// Only gray2 bitmaps and spans have palette blitters
+static void draw_glyph_palette(font_render_t *render, st7789_driver_t *driver, int x, int y, const st7789_gray2_palette_t *palette) {
+	if (render->bitmap_format == FONT_BITMAP_GRAY2_SPANS) {
+		st7789_draw_gray2_spans_palette(palette, render->bitmap, driver->current_buffer, x, y, render->bitmap_width, render->bitmap_height, driver->display_width, ST7789_BUFFER_SIZE);
+	}
+	else {
+		st7789_draw_gray2_bitmap_palette(palette, render->bitmap, driver->current_buffer, x, y, render->bitmap_width, render->bitmap_height, driver->display_width, ST7789_BUFFER_SIZE);
+	}
+}
+
+
+// Layout compiled at build time for render size, other sizes are shaped once
+// into run cache
+static const font_string_t *text_layout(const font_string_set_t *text, font_render_t *render, int src_y, int y) {
 	if (src_y - y >= ST7789_BUFFER_SIZE || src_y + (int)render->max_pixel_height - y < 0) {
+		return NULL;
+	}
+	const font_string_t *layout = font_render_string(render, text);
+	if (!layout) {
+		const text_run_t *run = text_run_get(text->text, render);
+		if (!run) {
+			return NULL;
+		}
+		layout = &run->layout;
+	}
+	if (src_y + layout->top - y >= ST7789_BUFFER_SIZE || src_y + layout->bottom - y <= 0) {
+		return NULL;
+	}
+	return layout;
+}
+
+
+// Glyphs of layout outside of strip are skipped without cache lookup
+static void render_text(const font_string_set_t *text, font_render_t *render, st7789_driver_t *driver, int src_x, int src_y, int y, uint8_t color_r, uint8_t color_g, uint8_t color_b) {
+	const font_string_t *layout = text_layout(text, render, src_y, y);
+	if (!layout) {
+		return;
+	}
+
+	for (size_t i = 0; i < layout->glyph_count; ++i) {
+		const font_string_glyph_t *glyph = &layout->glyphs[i];
+		const int glyph_x = src_x + glyph->x;
+		const int glyph_y = src_y + glyph->y - y;
+		if (glyph_y >= ST7789_BUFFER_SIZE || glyph_y + glyph->height <= 0 || glyph_x >= driver->display_width || glyph_x + glyph->width <= 0) {
+			continue;
+		}
+		if (font_render_glyph(render, glyph->utf_code) != ESP_OK) {
+			continue;
+		}
+		draw_glyph(render, driver, glyph_x, glyph_y, color_r, color_g, color_b);
+	}
+}
+
+
+// Text drawn over solid background color, blending is replaced by palette
+// lookup, pixels where glyph boxes overlap take color of last glyph
+static void render_text_on_color(const font_string_set_t *text, font_render_t *render, st7789_driver_t *driver, int src_x, int src_y, int y, uint8_t color_r, uint8_t color_g, uint8_t color_b, st7789_color_t background) {
+	const font_string_t *layout = text_layout(text, render, src_y, y);
+	if (!layout) {
 		return;
 	}
 
-	while (*text) {
-		uint32_t glyph;
-		text += u8_decode(&glyph, text);
-		font_render_glyph(render, glyph);
-		st7789_draw_gray2_bitmap(render->bitmap, driver->current_buffer, color_r, color_g, color_b, src_x + render->bitmap_left, render->max_pixel_height - render->origin - render->bitmap_top + src_y - y, render->bitmap_width, render->bitmap_height, driver->display_width, ST7789_BUFFER_SIZE);
-		src_x += render->advance;
+	st7789_gray2_palette_t palette;
+	st7789_gray2_palette_init(&palette, background, color_r, color_g, color_b, true);
+
+	for (size_t i = 0; i < layout->glyph_count; ++i) {
+		const font_string_glyph_t *glyph = &layout->glyphs[i];
+		const int glyph_x = src_x + glyph->x;
+		const int glyph_y = src_y + glyph->y - y;
+		if (glyph_y >= ST7789_BUFFER_SIZE || glyph_y + glyph->height <= 0 || glyph_x >= driver->display_width || glyph_x + glyph->width <= 0) {
+			continue;
+		}
+		if (font_render_glyph(render, glyph->utf_code) != ESP_OK) {
+			continue;
+		}
+		draw_glyph_palette(render, driver, glyph_x, glyph_y, &palette);
 	}
 }
 
 
+// Only lines crossing strip are drawn, glyphs come from layout of whole
+// paragraph and those outside of strip are skipped without cache lookup
+static void render_paragraph(text_layout_t *layout, st7789_driver_t *driver, int src_x, int src_y, int y, uint8_t color_r, uint8_t color_g, uint8_t color_b) {
+	font_render_t *render = layout->render;
+	const int first_line = (y - src_y - (int)render->max_pixel_height) / layout->line_height;
+	for (size_t i = first_line > 0 ? first_line : 0; i < layout->line_count; ++i) {
+		const int line_y = src_y + (int)i * layout->line_height - y;
+		if (line_y >= ST7789_BUFFER_SIZE) {
+			break;
+		}
+		if (line_y + (int)render->max_pixel_height <= 0) {
+			continue;
+		}
+
+		const text_layout_line_t *line = &layout->lines[i];
+		const font_string_glyph_t *glyphs;
+		size_t glyph_count;
+		int pen;
+		if (text_layout_line_glyphs(layout, line, &glyphs, &glyph_count, &pen) != ESP_OK) {
+			return;
+		}
+		const int line_x = src_x + text_layout_line_x(layout, line) - pen;
+		for (size_t j = 0; j < glyph_count; ++j) {
+			const font_string_glyph_t *glyph = &glyphs[j];
+			const int glyph_x = line_x + glyph->x;
+			const int glyph_y = line_y + glyph->y;
+			if (glyph_y >= ST7789_BUFFER_SIZE || glyph_y + glyph->height <= 0 || glyph_x >= driver->display_width || glyph_x + glyph->width <= 0) {
+				continue;
+			}
+			// Glyph still loaded by prefetch worker leaves gap in line
+			if (font_render_glyph(render, glyph->utf_code) != ESP_OK) {
+				continue;
+			}
+			draw_glyph(render, driver, glyph_x, glyph_y, color_r, color_g, color_b);
+		}
+	}
+}
+
 #define GREEN_BACKGROUND_COLOR 80
+#define GREEN_BACKGROUND st7789_rgb_to_color(0, GREEN_BACKGROUND_COLOR, 0)
 
 void gradient(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
 	if (y >= DRAW_EVENT_CONTROL) {
 		if (y == DRAW_EVENT_START) {
-			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 24, 16));
+			ESP_ERROR_CHECK(font_render_init(&font_render, &prerendered_face, 24));
 		}
 		else if (y == DRAW_EVENT_END) {
 			font_render_destroy(&font_render);
@@ -88,9 +252,6 @@ void gradient(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
 		return;
 	}
 
-	uint16_t cursor_x = driver->display_width - 1;
-	uint16_t cursor_y = y - 1;
-	int color_val = 0;
 	const bool strips[7][3] = {
 		{1, 1, 1},
 		{1, 0, 0},
@@ -100,39 +261,33 @@ void gradient(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
 		{0, 1, 1},
 		{1, 0, 1},
 	};
-	for (size_t i = 0; i < driver->buffer_size; ++i) {
-		cursor_x++;
-		if (cursor_x == driver->display_width) {
-			cursor_x = 0;
-			cursor_y++;
-		}
-		color_val = cursor_x * driver->display_width / 256;
+	const size_t lines = driver->buffer_size / driver->display_width;
+	const uint8_t color_val = driver->display_width;
+	for (size_t line = 0; line < lines; ++line) {
+		const uint16_t cursor_y = y + line;
 		const bool *strip = strips[cursor_y * 7 / driver->display_width];
-		const uint8_t color_r = strip[0] ? color_val : 0;
-		const uint8_t color_g = strip[1] ? color_val : 0;
-		const uint8_t color_b = strip[2] ? color_val : 0;
+		st7789_color_t *target = driver->current_buffer + line * driver->display_width;
+		st7789_gradient_t color_gradient;
+		st7789_gradient_init(
+			&color_gradient,
+			0, 0, 0,
+			strip[0] ? color_val : 0,
+			strip[1] ? color_val : 0,
+			strip[2] ? color_val : 0,
+			256
+		);
 		if (param->frame > (param->duration >> 1)) {
-			driver->current_buffer[i] = st7789_rgb_to_color_dither(
-				color_r,
-				color_g,
-				color_b,
-				cursor_x,
-				cursor_y
-			);
+			st7789_fill_span_gradient_dither(target, &color_gradient, 0, cursor_y, driver->display_width);
 		}
 		else {
-			driver->current_buffer[i] = st7789_rgb_to_color(
-				color_r,
-				color_g,
-				color_b
-			);
+			st7789_fill_span_gradient(target, &color_gradient, driver->display_width);
 		}
 	}
 	if (param->frame > (param->duration >> 1)) {
-		render_text("With dithering", &font_render, driver, 8, 210, y, 255, 255, 255);
+		render_text(&ui_strings_with_dithering, &font_render, driver, 8, 210, y, 255, 255, 255);
 	}
 	else {
-		render_text("Without dithering", &font_render, driver, 8, 210, y, 255, 255, 255);
+		render_text(&ui_strings_without_dithering, &font_render, driver, 8, 210, y, 255, 255, 255);
 	}
 }
 
@@ -144,15 +299,11 @@ void fade_in_green(st7789_driver_t *driver, uint16_t y, draw_event_param_t *para
 	const int end_color = GREEN_BACKGROUND_COLOR;
 	const float transition_position = ((float)param->frame + 1.0) / (float)param->duration;
 	const int color_value = start_color + (end_color - start_color) * transition_position;
-	uint16_t cursor_x = 0;
-	uint16_t cursor_y = y;
-	for (size_t i = 0; i < driver->buffer_size; ++i) {
-		driver->current_buffer[i] = st7789_rgb_to_color_dither(0, color_value, 0, cursor_x, cursor_y);
-		cursor_x++;
-		if (cursor_x == driver->display_width) {
-			cursor_x = 0;
-			cursor_y++;
-		}
+	st7789_color_t pattern[ST7789_DITHER_PATTERN_SIZE];
+	st7789_dither_pattern_init(pattern, 0, color_value, 0);
+	const size_t lines = driver->buffer_size / driver->display_width;
+	for (size_t line = 0; line < lines; ++line) {
+		st7789_fill_span_pattern(driver->current_buffer + line * driver->display_width, pattern, 0, y + line, driver->display_width);
 	}
 }
 
@@ -161,10 +312,7 @@ void green_background(st7789_driver_t *driver, uint16_t y, draw_event_param_t *p
 	if (y >= DRAW_EVENT_CONTROL) {
 		return;
 	}
-	st7789_color_t color = st7789_rgb_to_color(0, GREEN_BACKGROUND_COLOR, 0);
-	for (size_t i = 0; i < driver->buffer_size; ++i) {
-		driver->current_buffer[i] = color;
-	}
+	st7789_fill_span(driver->current_buffer, GREEN_BACKGROUND, driver->buffer_size);
 }
 
 
@@ -172,32 +320,31 @@ void black_background(st7789_driver_t *driver, uint16_t y, draw_event_param_t *p
 	if (y >= DRAW_EVENT_CONTROL) {
 		return;
 	}
-	memset(driver->current_buffer, 0, driver->buffer_size * sizeof(st7789_color_t));
+	st7789_fill_span(driver->current_buffer, 0x0000, driver->buffer_size);
+}
+
+
+// Paragraph is wrapped once when demo starts, glyph positions come from
+// string laid out at build time
+static void init_lorem_ipsum(st7789_driver_t *driver) {
+	ESP_ERROR_CHECK(text_layout_init(&lorem_ipsum_layout, &font_render2, driver->display_width - 16, 20, TEXT_ALIGN_LEFT));
+	ESP_ERROR_CHECK(text_layout_set_string(&lorem_ipsum_layout, &ui_strings_lorem_ipsum));
 }
 
 
 void draw_lorem_ipsum(st7789_driver_t *driver, uint16_t y, int y_shift) {
-	const int line_height = 20;
-	render_text("Lorem ipsum dolor sit amet,", &font_render2, driver, 8, y_shift, y, 255, 255, 255);
-	render_text("consectetur adipiscing elit.", &font_render2, driver, 8, y_shift + line_height * 1, y, 255, 255, 255);
-	render_text("Pellentesque tristique quam sit", &font_render2, driver, 8, y_shift + line_height * 2, y, 255, 255, 255);
-	render_text("amet dolor sagittis lacinia.", &font_render2, driver, 8, y_shift + line_height * 3, y, 255, 255, 255);
-	render_text("Phasellus non dui sed orci", &font_render2, driver, 8, y_shift + line_height * 4, y, 255, 255, 255);
-	render_text("vehicula faucibus ut vitae dui.", &font_render2, driver, 8, y_shift + line_height * 5, y, 255, 255, 255);
-	render_text("Duis pulvinar sem risus, quis", &font_render2, driver, 8, y_shift + line_height * 6, y, 255, 255, 255);
-	render_text("bibendum elit consequat vel.", &font_render2, driver, 8, y_shift + line_height * 7, y, 255, 255, 255);
-	render_text("Cras eget fermentum magna.", &font_render2, driver, 8, y_shift + line_height * 8, y, 255, 255, 255);
-	render_text("Maecenas eu pretium diam,", &font_render2, driver, 8, y_shift + line_height * 9, y, 255, 255, 255);
-	render_text("sed tempor ex.", &font_render2, driver, 8, y_shift + line_height * 10, y, 255, 255, 255);
+	render_paragraph(&lorem_ipsum_layout, driver, 8, y_shift, y, 255, 255, 255);
 }
 
 
 void lorem_ipsum(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
 	if (y >= DRAW_EVENT_CONTROL) {
 		if (y == DRAW_EVENT_START) {
-			ESP_ERROR_CHECK(font_render_init(&font_render2, &font_face, 14, 32));
+			ESP_ERROR_CHECK(font_render_init(&font_render2, &prerendered_face, 14));
+			init_lorem_ipsum(driver);
 		}
 		else if (y == DRAW_EVENT_END) {
+			text_layout_destroy(&lorem_ipsum_layout);
 			font_render_destroy(&font_render2);
 		}
 		return;
@@ -209,7 +356,7 @@ void lorem_ipsum(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param)
 void fade_in_a(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
 	if (y >= DRAW_EVENT_CONTROL) {
 		if (y == DRAW_EVENT_START) {
-			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 200, 1));
+			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 200));
 			font_render_glyph(&font_render, (uint32_t)'A');
 		}
 		else if (y == DRAW_EVENT_END) {
@@ -224,24 +371,30 @@ void fade_in_a(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
 	const int color_g = GREEN_BACKGROUND_COLOR + 4 + (255 - GREEN_BACKGROUND_COLOR - 4) * transition_position;
 	const int color_b = color_r;
 
-	st7789_draw_gray2_bitmap(
-		font_render.bitmap,
-		driver->current_buffer,
-		color_r, color_g, color_b,
+	st7789_gray2_palette_t palette;
+	st7789_gray2_palette_init(&palette, GREEN_BACKGROUND, color_r, color_g, color_b, true);
+	draw_glyph_palette(
+		&font_render,
+		driver,
 		(driver->display_width - font_render.bitmap_width) / 2,
 		(driver->display_height - font_render.max_pixel_height) / 2 - y - font_render.bitmap_top - font_render.origin + font_render.max_pixel_height,
-		font_render.bitmap_width,
-		font_render.bitmap_height,
-		driver->display_width,
-		ST7789_BUFFER_SIZE
+		&palette
 	);
 }
 
 
 void draw_alphabet(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
+	static uint32_t alphabet_glyph;
 	if (y >= DRAW_EVENT_CONTROL) {
 		if (y == DRAW_EVENT_START) {
-			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 200, 1));
+			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 200));
+			// Size doesn't change, so letters are rasterized at full 200 px
+			// into strips from small cached outlines
+			font_render.format = FONT_BITMAP_OUTLINE;
+			// Outlines are loaded on other core ahead of frames showing them
+			font_render.miss_policy = FONT_MISS_PLACEHOLDER;
+			font_prefetch_range(&font_render, 0x21, 0x7e);
+			alphabet_glyph = 0x21;
 		}
 		else if (y == DRAW_EVENT_END) {
 			font_render_destroy(&font_render);
@@ -253,21 +406,24 @@ void draw_alphabet(st7789_driver_t *driver, uint16_t y, draw_event_param_t *para
 			if (transition_position >= 0.99) {
 				glyph = (uint32_t)'A';
 			}
-			font_render_glyph(&font_render, glyph);
+			// Previous letter stays on screen until outline of next one is ready
+			if (font_render_glyph(&font_render, glyph) == ESP_ERR_NOT_FINISHED) {
+				font_render_glyph(&font_render, alphabet_glyph);
+			}
+			else {
+				alphabet_glyph = glyph;
+			}
 		}
 		return;
 	}
 
-	st7789_draw_gray2_bitmap(
-		font_render.bitmap,
-		driver->current_buffer,
-		255, 255, 255,
+	// Outline has no palette blitter, its spans are blended by draw_glyph
+	draw_glyph(
+		&font_render,
+		driver,
 		(driver->display_width - font_render.bitmap_width) / 2,
 		(driver->display_height - font_render.max_pixel_height) / 2 - y - font_render.bitmap_top - font_render.origin + font_render.max_pixel_height,
-		font_render.bitmap_width,
-		font_render.bitmap_height,
-		driver->display_width,
-		ST7789_BUFFER_SIZE
+		255, 255, 255
 	);
 }
 
@@ -276,28 +432,29 @@ void shrink_a(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
 	float transition_position = ((float)param->frame + 1.0) / (float)param->duration;
 	int vertical_move = transition_position * driver->display_height / 4;
 	if (y >= DRAW_EVENT_CONTROL) {
-		if (y == DRAW_EVENT_FRAME_START) {
+		if (y == DRAW_EVENT_START) {
+			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 200));
+			// Size changes every frame, single distance field is scaled
+			font_render.format = FONT_BITMAP_SDF;
+		}
+		else if (y == DRAW_EVENT_END) {
+			font_render_destroy(&font_render);
+		}
+		else if (y == DRAW_EVENT_FRAME_START) {
 			transition_position = 1.0 - transition_position;
 			transition_position = 1.0 - (transition_position * transition_position);
-			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 200 - 140 * transition_position, 1));
+			ESP_ERROR_CHECK(font_render_set_pixel_size(&font_render, 200 - 140 * transition_position));
 			font_render_glyph(&font_render, (uint32_t)'A');
 		}
-		else if (y == DRAW_EVENT_FRAME_END) {
-			font_render_destroy(&font_render);
-		}
 		return;
 	}
 
-	st7789_draw_gray2_bitmap(
-		font_render.bitmap,
-		driver->current_buffer,
-		255, 255, 255,
+	draw_glyph(
+		&font_render,
+		driver,
 		(driver->display_width - font_render.bitmap_width) / 2,
 		(driver->display_height - font_render.max_pixel_height) / 2 - y - vertical_move - font_render.bitmap_top - font_render.origin + font_render.max_pixel_height,
-		font_render.bitmap_width,
-		font_render.bitmap_height,
-		driver->display_width,
-		ST7789_BUFFER_SIZE
+		255, 255, 255
 	);
 }
 
@@ -307,8 +464,8 @@ void perfect_rendering(st7789_driver_t *driver, uint16_t y, draw_event_param_t *
 
 	if (y >= DRAW_EVENT_CONTROL) {
 		if (y == DRAW_EVENT_START) {
-			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 60, 1));
-			ESP_ERROR_CHECK(font_render_init(&font_render2, &font_face, 16, 32));
+			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 60));
+			ESP_ERROR_CHECK(font_render_init(&font_render2, &prerendered_face, 16));
 			font_render_glyph(&font_render, (uint32_t)'A');
 		}
 		else if (y == DRAW_EVENT_END) {
@@ -336,16 +493,14 @@ void perfect_rendering(st7789_driver_t *driver, uint16_t y, draw_event_param_t *
 
 		int vertical_move = driver->display_height / 4;
 
-		st7789_draw_gray2_bitmap(
-			font_render.bitmap,
-			driver->current_buffer,
-			color_r, color_g, color_b,
+		st7789_gray2_palette_t palette;
+		st7789_gray2_palette_init(&palette, GREEN_BACKGROUND, color_r, color_g, color_b, true);
+		draw_glyph_palette(
+			&font_render,
+			driver,
 			(driver->display_width - font_render.bitmap_width) / 2,
 			(driver->display_height - font_render.max_pixel_height) / 2 - y - vertical_move - font_render.bitmap_top - font_render.origin + font_render.max_pixel_height,
-			font_render.bitmap_width,
-			font_render.bitmap_height,
-			driver->display_width,
-			ST7789_BUFFER_SIZE
+			&palette
 		);
 	}
 
@@ -375,7 +530,7 @@ void perfect_rendering(st7789_driver_t *driver, uint16_t y, draw_event_param_t *
 		const int color_g = GREEN_BACKGROUND_COLOR + 4 + (255 - GREEN_BACKGROUND_COLOR - 4) * transition_position_font1;
 		const int color_b = color_r;
 
-		render_text("Perfectly readable", &font_render2, driver, 30 - (1.0 - transition_position_font2) * 100, 110, y, color_r, color_g, color_b);
+		render_text_on_color(&ui_strings_perfectly_readable, &font_render2, driver, 30 - (1.0 - transition_position_font2) * 100, 110, y, color_r, color_g, color_b, GREEN_BACKGROUND);
 	}
 
 	{
@@ -399,7 +554,7 @@ void perfect_rendering(st7789_driver_t *driver, uint16_t y, draw_event_param_t *
 		const int color_g = GREEN_BACKGROUND_COLOR + 4 + (255 - GREEN_BACKGROUND_COLOR - 4) * transition_position_font1;
 		const int color_b = color_r;
 
-		render_text("even small fonts", &font_render2, driver, 90, 128, y, color_r, color_g, color_b);
+		render_text_on_color(&ui_strings_even_small_fonts, &font_render2, driver, 90, 128, y, color_r, color_g, color_b, GREEN_BACKGROUND);
 	}
 }
 
@@ -412,15 +567,11 @@ void fade_out_green(st7789_driver_t *driver, uint16_t y, draw_event_param_t *par
 	const int end_color = 0;
 	const float transition_position = ((float)param->frame + 1.0) / (float)param->duration;
 	const int color_value = start_color + (end_color - start_color) * transition_position;
-	uint16_t cursor_x = 0;
-	uint16_t cursor_y = y;
-	for (size_t i = 0; i < driver->buffer_size; ++i) {
-		driver->current_buffer[i] = st7789_rgb_to_color_dither(0, color_value, 0, cursor_x, cursor_y);
-		cursor_x++;
-		if (cursor_x == driver->display_width) {
-			cursor_x = 0;
-			cursor_y++;
-		}
+	st7789_color_t pattern[ST7789_DITHER_PATTERN_SIZE];
+	st7789_dither_pattern_init(pattern, 0, color_value, 0);
+	const size_t lines = driver->buffer_size / driver->display_width;
+	for (size_t line = 0; line < lines; ++line) {
+		st7789_fill_span_pattern(driver->current_buffer + line * driver->display_width, pattern, 0, y + line, driver->display_width);
 	}
 }
 
@@ -456,23 +607,25 @@ static inline uint8_t __attribute__((always_inline)) fast_sin(int value) {
 void complex_text_demo(st7789_driver_t *driver, uint16_t y, draw_event_param_t *param) {
 	if (y >= DRAW_EVENT_CONTROL) {
 		if (y == DRAW_EVENT_START) {
-			ESP_ERROR_CHECK(font_render_init(&font_render2, &font_face, 14, 48));
+			ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, 14));
+			ESP_ERROR_CHECK(font_render_init(&font_render2, &prerendered_face, 14));
+			init_lorem_ipsum(driver);
+			// Size changes every frame, large glyph is rasterized from cached
+			// outline straight into strips
+			font_render.format = FONT_BITMAP_OUTLINE;
 		}
 		else if (y == DRAW_EVENT_END) {
+			text_layout_destroy(&lorem_ipsum_layout);
 			font_render_destroy(&font_render2);
+			font_render_destroy(&font_render);
 		}
 		else if (y == DRAW_EVENT_FRAME_START) {
 			if (param->frame > 1200 - 240) {
 				uint32_t glyph = 0x21 + ((param->frame >> 5) % 0x5d);
-				ESP_ERROR_CHECK(font_render_init(&font_render, &font_face, (fast_sin(param->frame << 2) >> 1) + 14, 1));
+				ESP_ERROR_CHECK(font_render_set_pixel_size(&font_render, (fast_sin(param->frame << 2) >> 1) + 14));
 				font_render_glyph(&font_render, glyph);
 			}
 		}
-		else if (y == DRAW_EVENT_FRAME_END) {
-			if (param->frame > 1200 - 240) {
-				font_render_destroy(&font_render);
-			}
-		}
 		return;
 	}
 
@@ -541,16 +694,12 @@ void complex_text_demo(st7789_driver_t *driver, uint16_t y, draw_event_param_t *
 		if (vertical_move < 0) {
 			vertical_move = 0;
 		}
-		st7789_draw_gray2_bitmap(
-			font_render.bitmap,
-			driver->current_buffer,
-			255, 255, 255,
+		draw_glyph(
+			&font_render,
+			driver,
 			(driver->display_width - font_render.bitmap_width) / 2,
 			(driver->display_height - font_render.max_pixel_height) / 2 - y - font_render.bitmap_top - font_render.origin + font_render.max_pixel_height + vertical_move,
-			font_render.bitmap_width,
-			font_render.bitmap_height,
-			driver->display_width,
-			ST7789_BUFFER_SIZE
+			255, 255, 255
 		);
 	}
 }
@@ -572,8 +721,30 @@ void app_main(void)
 
 	ESP_ERROR_CHECK(st7789_init(&display));
 
+#ifdef CONFIG_DEMO_BENCHMARK
+	ESP_ERROR_CHECK(font_face_init(&font_face, ttf_start, ttf_end - ttf_start));
+	benchmark_run(&display, &font_face);
+	font_face_destroy(&font_face);
+#endif
+
+#if defined(CONFIG_DEMO_DITHER_BAYER)
+	const st7789_dither_mode_t dither_mode = ST7789_DITHER_BAYER;
+#elif defined(CONFIG_DEMO_DITHER_BLUE_NOISE)
+	const st7789_dither_mode_t dither_mode = ST7789_DITHER_BLUE_NOISE;
+#else
+	const st7789_dither_mode_t dither_mode = ST7789_DITHER_NONE;
+#endif
+#ifdef CONFIG_DEMO_DITHER_TEMPORAL
+	st7789_dither_set_mode(dither_mode, true);
+#else
+	st7789_dither_set_mode(dither_mode, false);
+#endif
+
+	ESP_ERROR_CHECK(font_face_init_prerendered(&prerendered_face, prerendered_start, prerendered_end - prerendered_start));
+	ESP_ERROR_CHECK(font_prefetch_start(portNUM_PROCESSORS - 1));
+
 	while (1) {
-		ESP_ERROR_CHECK(font_face_init(&font_face, ttf_start, ttf_end - ttf_start - 1));
+		ESP_ERROR_CHECK(font_face_init(&font_face, ttf_start, ttf_end - ttf_start));
 
 		st7789_reset(&display);
 		st7789_lcd_init(&display);
@@ -674,7 +845,7 @@ void app_main(void)
 
 				if (has_render_layer) {
 					uint32_t ticks_before_frame = esp_cpu_get_ccount();
-					st7789_randomize_dither_table();
+					st7789_dither_next_frame();
 					for (size_t block = 0; block < ST7789_DISPLAY_WIDTH; block += ST7789_BUFFER_SIZE) {
 						current_layer = animation_step->draw_elements;
 						while (current_layer->callback) {
@@ -0,0 +1,394 @@
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "text_layout.h"
+#include "text_run.h"
+#include "unicode.h"
+
+
+static const char *TAG = "text_layout";
+
+
+static bool text_layout_reserve(text_layout_line_t **lines, size_t *capacity, size_t count) {
+	if (*capacity >= count) {
+		return true;
+	}
+	const size_t new_capacity = MAX(MAX(count, *capacity * 2), 16);
+	text_layout_line_t *new_lines = (text_layout_line_t *)heap_caps_realloc(*lines, new_capacity * sizeof(text_layout_line_t), MALLOC_CAP_DEFAULT);
+	if (!new_lines) {
+		ESP_LOGE(TAG, "Lines not allocated");
+		return false;
+	}
+	*lines = new_lines;
+	*capacity = new_capacity;
+	return true;
+}
+
+
+static int text_layout_advance(text_layout_t *layout, uint32_t utf_code) {
+	int advance;
+	return font_render_glyph_advance(layout->render, utf_code, &advance) == ESP_OK ? advance : 0;
+}
+
+
+static bool text_layout_is_line_end(uint8_t line_break_class) {
+	return line_break_class == U8_LB_BK || line_break_class == U8_LB_CR || line_break_class == U8_LB_LF || line_break_class == U8_LB_NL;
+}
+
+
+// Greedy line from start, breaks at UAX #14 break opportunities and at line
+// ends, word longer than line is broken between characters, returns start of
+// next line
+static size_t text_layout_break(text_layout_t *layout, size_t start, text_layout_line_t *line) {
+	const char *text = layout->text;
+	size_t pos = start;
+	int pen = 0;
+	size_t visible_end = start;
+	int visible_width = 0;
+	// Last break opportunity, break_next == start when line has none
+	size_t break_next = start;
+	size_t break_end = start;
+	int break_width = 0;
+	u8_line_break_t breaker;
+	u8_line_break_init(&breaker);
+
+	line->start = start;
+	line->fit_width = INT16_MAX;
+	while (pos < layout->length) {
+		uint32_t utf_code;
+		const uint8_t code_length = u8_decode(&utf_code, text + pos);
+		if (code_length == 0) {
+			break;
+		}
+		const u8_break_t opportunity = u8_line_break_next(&breaker, utf_code);
+		if (text_layout_is_line_end(breaker.previous)) {
+			pos += code_length;
+			if (breaker.previous == U8_LB_CR && pos < layout->length && text[pos] == '\n') {
+				pos++;
+			}
+			break;
+		}
+		const int advance = text_layout_advance(layout, utf_code);
+		if (breaker.previous == U8_LB_SP) {
+			// Trailing spaces hang over line end
+			pen += advance;
+			pos += code_length;
+			continue;
+		}
+		if (opportunity == U8_BREAK_ALLOWED && visible_end > start) {
+			break_next = pos;
+			break_end = visible_end;
+			break_width = visible_width;
+		}
+
+		if (pen + advance > layout->width && pos > start) {
+			if (break_next > start) {
+				// Rest of word is measured up to next break opportunity, wider
+				// layout would pull it back
+				int fit_width = pen + advance;
+				int word_pen = fit_width;
+				u8_line_break_t word_breaker = breaker;
+				for (size_t word_pos = pos + code_length; word_pos < layout->length;) {
+					uint32_t word_code;
+					const uint8_t word_length = u8_decode(&word_code, text + word_pos);
+					if (word_length == 0 || u8_line_break_next(&word_breaker, word_code) != U8_BREAK_PROHIBITED || text_layout_is_line_end(word_breaker.previous)) {
+						break;
+					}
+					word_pen += text_layout_advance(layout, word_code);
+					if (word_breaker.previous != U8_LB_SP) {
+						fit_width = word_pen;
+					}
+					word_pos += word_length;
+				}
+				line->end = break_end;
+				line->width = break_width;
+				line->fit_width = MIN(fit_width, INT16_MAX);
+				return break_next;
+			}
+			line->end = pos;
+			line->width = pen;
+			line->fit_width = MIN(pen + advance, INT16_MAX);
+			return pos;
+		}
+
+		pen += advance;
+		pos += code_length;
+		visible_end = pos;
+		visible_width = pen;
+	}
+
+	line->end = visible_end;
+	line->width = MIN(visible_width, INT16_MAX);
+	return pos;
+}
+
+
+// Index of first line from first_line starting at or after offset
+static size_t text_layout_lower_bound(const text_layout_t *layout, size_t first_line, size_t offset) {
+	size_t low = first_line;
+	size_t high = layout->line_count;
+	while (low < high) {
+		const size_t mid = (low + high) >> 1;
+		if (layout->lines[mid].start < offset) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+
+// Index of old line starting at offset, line_count when there is none
+static size_t text_layout_find(const text_layout_t *layout, size_t first_line, size_t start) {
+	const size_t index = text_layout_lower_bound(layout, first_line, start);
+	return index < layout->line_count && layout->lines[index].start == start ? index : layout->line_count;
+}
+
+
+// Lines from first_line are laid out again until new line start at or after
+// reuse_from meets start of old line, old lines are then shifted by delta
+static esp_err_t text_layout_update(text_layout_t *layout, size_t first_line, size_t reuse_from, ptrdiff_t delta) {
+	first_line = MIN(first_line, layout->line_count);
+	size_t start = first_line < layout->line_count ? layout->lines[first_line].start : 0;
+
+	size_t generated = 0;
+	size_t reused = layout->line_count;
+	while (start < layout->length) {
+		if (!text_layout_reserve(&layout->scratch, &layout->scratch_capacity, generated + 1)) {
+			return ESP_ERR_NO_MEM;
+		}
+		start = text_layout_break(layout, start, &layout->scratch[generated++]);
+		if (start >= reuse_from && start < layout->length) {
+			reused = text_layout_find(layout, first_line, start - delta);
+			if (reused < layout->line_count) {
+				break;
+			}
+		}
+	}
+
+	const size_t tail = layout->line_count - reused;
+	const size_t line_count = first_line + generated + tail;
+	if (!text_layout_reserve(&layout->lines, &layout->line_capacity, line_count)) {
+		return ESP_ERR_NO_MEM;
+	}
+	text_layout_line_t *target = layout->lines + first_line + generated;
+	memmove(target, layout->lines + reused, tail * sizeof(text_layout_line_t));
+	if (delta != 0) {
+		for (size_t i = 0; i < tail; ++i) {
+			target[i].start += delta;
+			target[i].end += delta;
+		}
+	}
+	memcpy(layout->lines + first_line, layout->scratch, generated * sizeof(text_layout_line_t));
+	layout->line_count = line_count;
+	return ESP_OK;
+}
+
+
+static void text_layout_clear_glyphs(text_layout_t *layout) {
+	heap_caps_free(layout->shaped_glyphs);
+	heap_caps_free(layout->glyph_positions);
+	layout->glyphs = NULL;
+	layout->shaped_glyphs = NULL;
+	layout->glyph_positions = NULL;
+	layout->glyph_count = 0;
+}
+
+
+// Glyphs come from precompiled string or are shaped, then byte offset and
+// pen of each glyph are found by walking text with same advances as breaks
+static esp_err_t text_layout_place_glyphs(text_layout_t *layout) {
+	const font_string_t *string = layout->string ? font_render_string(layout->render, layout->string) : NULL;
+	size_t glyph_count;
+	if (string) {
+		layout->glyphs = string->glyphs;
+		glyph_count = string->glyph_count;
+	}
+	else {
+		// UTF-8 has at most one code per byte
+		layout->shaped_glyphs = (font_string_glyph_t *)heap_caps_malloc(MAX(layout->length, 1) * sizeof(font_string_glyph_t), MALLOC_CAP_DEFAULT);
+		if (!layout->shaped_glyphs) {
+			ESP_LOGE(TAG, "Glyphs not allocated");
+			return ESP_ERR_NO_MEM;
+		}
+		font_string_t shaped;
+		text_shape(&shaped, layout->shaped_glyphs, layout->text, layout->length, layout->render);
+		layout->glyphs = layout->shaped_glyphs;
+		glyph_count = shaped.glyph_count;
+	}
+
+	layout->glyph_positions = (text_layout_glyph_t *)heap_caps_malloc(MAX(glyph_count, 1) * sizeof(text_layout_glyph_t), MALLOC_CAP_DEFAULT);
+	if (!layout->glyph_positions) {
+		ESP_LOGE(TAG, "Glyphs not allocated");
+		text_layout_clear_glyphs(layout);
+		return ESP_ERR_NO_MEM;
+	}
+	size_t index = 0;
+	int pen = 0;
+	for (size_t pos = 0; pos < layout->length && index < glyph_count;) {
+		uint32_t utf_code;
+		const uint8_t code_length = u8_decode(&utf_code, layout->text + pos);
+		if (code_length == 0) {
+			break;
+		}
+		// Codes without glyph are skipped in glyphs
+		if (layout->glyphs[index].utf_code == utf_code) {
+			layout->glyph_positions[index].offset = pos;
+			layout->glyph_positions[index].pen = pen;
+			index++;
+		}
+		pen += text_layout_advance(layout, utf_code);
+		pos += code_length;
+	}
+	layout->glyph_count = index;
+	return ESP_OK;
+}
+
+
+// Index of first glyph at or after byte offset
+static size_t text_layout_glyph_lower_bound(const text_layout_t *layout, size_t offset) {
+	size_t low = 0;
+	size_t high = layout->glyph_count;
+	while (low < high) {
+		const size_t mid = (low + high) >> 1;
+		if (layout->glyph_positions[mid].offset < offset) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+
+esp_err_t text_layout_init(text_layout_t *layout, font_render_t *render, int width, int line_height, text_align_t align) {
+	memset(layout, 0, sizeof(*layout));
+	layout->render = render;
+	layout->width = width;
+	layout->line_height = line_height;
+	layout->align = align;
+	return ESP_OK;
+}
+
+
+void text_layout_destroy(text_layout_t *layout) {
+	text_layout_clear_glyphs(layout);
+	heap_caps_free(layout->text);
+	heap_caps_free(layout->lines);
+	heap_caps_free(layout->scratch);
+	memset(layout, 0, sizeof(*layout));
+}
+
+
+esp_err_t text_layout_set_text(text_layout_t *layout, const char *text) {
+	const size_t old_length = layout->length;
+	const size_t length = strlen(text);
+
+	// Common head and tail of old and new text
+	const size_t limit = MIN(old_length, length);
+	size_t prefix = 0;
+	while (prefix < limit && layout->text[prefix] == text[prefix]) {
+		prefix++;
+	}
+	if (prefix == length && length == old_length) {
+		return ESP_OK;
+	}
+	size_t suffix = 0;
+	while (suffix < limit - prefix && layout->text[old_length - 1 - suffix] == text[length - 1 - suffix]) {
+		suffix++;
+	}
+
+	char *copy = (char *)heap_caps_realloc(layout->text, length + 1, MALLOC_CAP_DEFAULT);
+	if (!copy) {
+		ESP_LOGE(TAG, "Text not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	memcpy(copy, text, length + 1);
+	layout->text = copy;
+	layout->length = length;
+	layout->string = NULL;
+	text_layout_clear_glyphs(layout);
+
+	// Changed word can move back to previous line and its width is fit_width
+	// of that line, word broken between characters spans several lines, break
+	// opportunity at line start depends on first changed character too
+	size_t first_line = text_layout_lower_bound(layout, 0, prefix);
+	first_line = first_line > 0 ? first_line - 1 : 0;
+	while (first_line > 0 && layout->lines[first_line - 1].end == layout->lines[first_line].start) {
+		first_line--;
+	}
+	first_line = first_line > 0 ? first_line - 1 : 0;
+	return text_layout_update(layout, first_line, length - suffix, (ptrdiff_t)length - (ptrdiff_t)old_length);
+}
+
+
+esp_err_t text_layout_set_string(text_layout_t *layout, const font_string_set_t *string) {
+	const esp_err_t ret = text_layout_set_text(layout, string->text);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	if (layout->string != string) {
+		text_layout_clear_glyphs(layout);
+		layout->string = string;
+	}
+	return ESP_OK;
+}
+
+
+esp_err_t text_layout_set_width(text_layout_t *layout, int width) {
+	if (layout->width == width) {
+		return ESP_OK;
+	}
+	layout->width = width;
+
+	size_t first_affected = layout->line_count;
+	size_t last_affected = 0;
+	for (size_t i = 0; i < layout->line_count; ++i) {
+		const text_layout_line_t *line = &layout->lines[i];
+		if (line->width > width || line->fit_width <= width) {
+			first_affected = MIN(first_affected, i);
+			last_affected = i;
+		}
+	}
+	if (first_affected == layout->line_count) {
+		return ESP_OK;
+	}
+	const size_t reuse_from = last_affected + 1 < layout->line_count ? layout->lines[last_affected + 1].start : layout->length;
+	return text_layout_update(layout, first_affected, reuse_from, 0);
+}
+
+
+int text_layout_line_x(const text_layout_t *layout, const text_layout_line_t *line) {
+	switch (layout->align) {
+		case TEXT_ALIGN_CENTER:
+			return (layout->width - line->width) / 2;
+		case TEXT_ALIGN_RIGHT:
+			return layout->width - line->width;
+		default:
+			return 0;
+	}
+}
+
+
+esp_err_t text_layout_line_glyphs(text_layout_t *layout, const text_layout_line_t *line, const font_string_glyph_t **glyphs, size_t *count, int *pen) {
+	if (!layout->glyph_positions) {
+		const esp_err_t ret = text_layout_place_glyphs(layout);
+		if (ret != ESP_OK) {
+			return ret;
+		}
+	}
+	const size_t first = text_layout_glyph_lower_bound(layout, line->start);
+	const size_t last = text_layout_glyph_lower_bound(layout, line->end);
+	*glyphs = layout->glyphs + first;
+	*count = last - first;
+	*pen = first < layout->glyph_count ? layout->glyph_positions[first].pen : 0;
+	return ESP_OK;
+}
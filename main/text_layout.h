@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "font_render.h"
+
+
+typedef enum text_align {
+	TEXT_ALIGN_LEFT,
+	TEXT_ALIGN_CENTER,
+	TEXT_ALIGN_RIGHT,
+} text_align_t;
+
+
+// Line of paragraph, offsets are bytes of layout text, trailing spaces
+// between end and start of next line are not drawn
+typedef struct text_layout_line {
+	uint32_t start;
+	uint32_t end;
+	int16_t width;
+	// Width needed to pull next word to this line, line breaks stay same for
+	// any layout width from width up to fit_width - 1
+	int16_t fit_width;
+} text_layout_line_t;
+
+// Glyph of paragraph text, pen is sum of advances before its byte
+typedef struct text_layout_glyph {
+	uint32_t offset;
+	int32_t pen;
+} text_layout_glyph_t;
+
+typedef struct text_layout {
+	font_render_t *render;
+	char *text;
+	size_t length;
+	int width;
+	int line_height;
+	text_align_t align;
+	// Line break index
+	text_layout_line_t *lines;
+	size_t line_count;
+	size_t line_capacity;
+	// Lines produced by relayout before they are spliced to index
+	text_layout_line_t *scratch;
+	size_t scratch_capacity;
+	// Glyphs of whole text placed on first draw, precompiled string is used
+	// when it matches render, lines only select range of them
+	const font_string_set_t *string;
+	const font_string_glyph_t *glyphs;
+	font_string_glyph_t *shaped_glyphs;
+	text_layout_glyph_t *glyph_positions;
+	size_t glyph_count;
+} text_layout_t;
+
+
+// Paragraph wrapped to width with cached advances of render, render must stay
+// at same size while layout is used
+esp_err_t text_layout_init(text_layout_t *layout, font_render_t *render, int width, int line_height, text_align_t align);
+void text_layout_destroy(text_layout_t *layout);
+// Text is copied, lines before first changed byte are kept and relayout stops
+// when new line starts meet old ones in unchanged tail
+esp_err_t text_layout_set_text(text_layout_t *layout, const char *text);
+// Text of string laid out at build time, its glyphs are drawn without shaping
+// when string has layout for render
+esp_err_t text_layout_set_string(text_layout_t *layout, const font_string_set_t *string);
+// Relayout starts from first line whose breaks depend on width
+esp_err_t text_layout_set_width(text_layout_t *layout, int width);
+// Horizontal offset of aligned line
+int text_layout_line_x(const text_layout_t *layout, const text_layout_line_t *line);
+// Glyphs of line, their x minus pen is offset from line start, whole text is
+// shaped once on first call after text change
+esp_err_t text_layout_line_glyphs(text_layout_t *layout, const text_layout_line_t *line, const font_string_glyph_t **glyphs, size_t *count, int *pen);
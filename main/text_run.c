@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "text_run.h"
+#include "unicode.h"
+
+
+#ifndef TEXT_RUN_CACHE_SIZE
+#define TEXT_RUN_CACHE_SIZE 16
+#endif
+
+// Codes decoded from text at once
+#ifndef TEXT_DECODE_BATCH
+#define TEXT_DECODE_BATCH 32
+#endif
+
+// Codes queued by one font_prefetch_glyphs call
+#ifndef TEXT_PREFETCH_BATCH
+#define TEXT_PREFETCH_BATCH 32
+#endif
+
+
+static const char *TAG = "text_run";
+
+static text_run_t run_cache[TEXT_RUN_CACHE_SIZE] = {0};
+static uint32_t run_clock = 0;
+
+
+// FNV-1a of string, length is returned too
+static uint32_t text_run_hash(const char *text, size_t *length) {
+	uint32_t hash = 2166136261u;
+	const char *pos = text;
+	while (*pos) {
+		hash = (hash ^ (uint8_t)*pos++) * 16777619u;
+	}
+	*length = pos - text;
+	return hash;
+}
+
+
+static void text_run_free(text_run_t *run) {
+	heap_caps_free((void *)run->layout.glyphs);
+	heap_caps_free(run->text);
+	memset(run, 0, sizeof(*run));
+}
+
+
+static bool text_run_matches(const text_run_t *run, const char *text, size_t length, uint32_t hash, const font_render_t *render) {
+	return run->text &&
+		run->hash == hash &&
+		run->render == render &&
+		run->face == render->font_face &&
+		run->pixel_size == render->pixel_size &&
+		run->format == render->format &&
+		run->hinting == render->hinting &&
+		memcmp(run->text, text, length + 1) == 0;
+}
+
+
+void text_shape(font_string_t *layout, font_string_glyph_t *glyphs, const char *text, size_t length, font_render_t *render) {
+	layout->glyphs = glyphs;
+	layout->glyph_count = 0;
+	layout->pixel_size = render->pixel_size;
+	layout->left = INT16_MAX;
+	layout->top = INT16_MAX;
+	layout->right = INT16_MIN;
+	layout->bottom = INT16_MIN;
+	int pen_x = 0;
+	const font_miss_policy_t miss_policy = render->miss_policy;
+	render->miss_policy = FONT_MISS_RENDER;
+	uint32_t codes[TEXT_DECODE_BATCH];
+	for (size_t pos = 0; pos < length;) {
+		size_t consumed;
+		const size_t count = u8_decode_buffer(codes, TEXT_DECODE_BATCH, text + pos, length - pos, U8_INVALID_REPLACE, &consumed, NULL);
+		pos += consumed;
+		for (size_t i = 0; i < count; ++i) {
+			if (font_render_glyph(render, codes[i]) != ESP_OK) {
+				continue;
+			}
+
+			font_string_glyph_t *glyph = &glyphs[layout->glyph_count++];
+			glyph->utf_code = codes[i];
+			glyph->x = pen_x + render->bitmap_left;
+			glyph->y = render->max_pixel_height - render->origin - render->bitmap_top;
+			glyph->width = render->bitmap_width;
+			glyph->height = render->bitmap_height;
+			pen_x += render->advance;
+
+			if (glyph->width > 0 && glyph->height > 0) {
+				layout->left = MIN(layout->left, glyph->x);
+				layout->top = MIN(layout->top, glyph->y);
+				layout->right = MAX(layout->right, glyph->x + glyph->width);
+				layout->bottom = MAX(layout->bottom, glyph->y + glyph->height);
+			}
+		}
+	}
+	render->miss_policy = miss_policy;
+	layout->advance = pen_x;
+	if (layout->left > layout->right) {
+		layout->left = layout->top = layout->right = layout->bottom = 0;
+	}
+}
+
+
+static bool text_run_shape(text_run_t *run, const char *text, size_t length, font_render_t *render) {
+	run->text = (char *)heap_caps_malloc(length + 1, MALLOC_CAP_DEFAULT);
+	// UTF-8 has at most one code per byte
+	font_string_glyph_t *glyphs = (font_string_glyph_t *)heap_caps_malloc(MAX(length, 1) * sizeof(font_string_glyph_t), MALLOC_CAP_DEFAULT);
+	run->layout.glyphs = glyphs;
+	if (!run->text || !glyphs) {
+		ESP_LOGE(TAG, "Run not allocated");
+		return false;
+	}
+	memcpy(run->text, text, length + 1);
+	text_shape(&run->layout, glyphs, text, length, render);
+	return true;
+}
+
+
+const text_run_t *text_run_get(const char *text, font_render_t *render) {
+	size_t length;
+	const uint32_t hash = text_run_hash(text, &length);
+	run_clock++;
+
+	text_run_t *victim = &run_cache[0];
+	for (size_t i = 0; i < TEXT_RUN_CACHE_SIZE; ++i) {
+		text_run_t *run = &run_cache[i];
+		if (text_run_matches(run, text, length, hash, render)) {
+			run->last_used = run_clock;
+			return run;
+		}
+		if (!run->text || (victim->text && run->last_used < victim->last_used)) {
+			victim = run;
+		}
+	}
+
+	text_run_free(victim);
+	victim->render = render;
+	victim->face = render->font_face;
+	victim->pixel_size = render->pixel_size;
+	victim->format = render->format;
+	victim->hinting = render->hinting;
+	victim->hash = hash;
+	victim->last_used = run_clock;
+	if (!text_run_shape(victim, text, length, render)) {
+		text_run_free(victim);
+		return NULL;
+	}
+	return victim;
+}
+
+
+void text_run_clear(void) {
+	for (size_t i = 0; i < TEXT_RUN_CACHE_SIZE; ++i) {
+		text_run_free(&run_cache[i]);
+	}
+}
+
+
+void text_measure(const char *text, font_render_t *render, text_metrics_t *metrics) {
+	metrics->width = 0;
+	metrics->line_ascent = render->max_pixel_height - render->origin;
+	metrics->line_descent = render->origin;
+	const size_t length = strlen(text);
+	uint32_t codes[TEXT_DECODE_BATCH];
+	for (size_t pos = 0; pos < length;) {
+		size_t consumed;
+		const size_t count = u8_decode_buffer(codes, TEXT_DECODE_BATCH, text + pos, length - pos, U8_INVALID_REPLACE, &consumed, NULL);
+		pos += consumed;
+		for (size_t i = 0; i < count; ++i) {
+			int advance;
+			if (font_render_glyph_advance(render, codes[i], &advance) == ESP_OK) {
+				metrics->width += advance;
+			}
+		}
+	}
+}
+
+
+// Sorted unique codes are queued, so runs of neighbouring letters become
+// single requests
+esp_err_t text_prefetch(const char *text, const font_render_t *render) {
+	uint32_t codes[TEXT_PREFETCH_BATCH];
+	size_t count = 0;
+	while (*text) {
+		uint32_t utf_code;
+		const uint8_t code_length = u8_decode(&utf_code, text);
+		if (code_length == 0) {
+			break;
+		}
+		text += code_length;
+
+		size_t pos = count;
+		while (pos > 0 && codes[pos - 1] > utf_code) {
+			pos--;
+		}
+		if (pos > 0 && codes[pos - 1] == utf_code) {
+			continue;
+		}
+		if (count == TEXT_PREFETCH_BATCH) {
+			const esp_err_t ret = font_prefetch_glyphs(render, codes, count);
+			if (ret != ESP_OK) {
+				return ret;
+			}
+			count = 0;
+			pos = 0;
+		}
+		memmove(codes + pos + 1, codes + pos, (count - pos) * sizeof(uint32_t));
+		codes[pos] = utf_code;
+		count++;
+	}
+	return font_prefetch_glyphs(render, codes, count);
+}
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "font_render.h"
+
+
+typedef struct text_run {
+	// Key, runs are shaped for one render with its size and format
+	const font_render_t *render;
+	const font_face_t *face;
+	font_size_t pixel_size;
+	font_bitmap_format_t format;
+	font_hinting_t hinting;
+	uint32_t hash;
+	char *text;
+	// Shaped glyphs and bounds of their bitmaps
+	font_string_t layout;
+	uint32_t last_used;
+} text_run_t;
+
+// Advance of text and line box used by layouts, line box is same for all text
+// of render, not bounds of glyphs, ascent is baseline distance from top of box
+typedef struct text_metrics {
+	int width;
+	int line_ascent;
+	int line_descent;
+} text_metrics_t;
+
+
+// Returns run of text shaped by render, runs are kept in small LRU cache, so
+// repeated labels are decoded and measured only once
+const text_run_t *text_run_get(const char *text, font_render_t *render);
+// Glyphs of text placed from pen 0, glyphs has room for one glyph per byte,
+// glyphs are loaded even by render with placeholders
+void text_shape(font_string_t *layout, font_string_glyph_t *glyphs, const char *text, size_t length, font_render_t *render);
+// Frees all cached runs, needed when face is reloaded with other font at same
+// address
+void text_run_clear(void);
+// Measures text from per render advance tables, cheap enough for alignment
+// on every frame, hinted render loads each glyph once when its advance is not
+// in table yet, missing glyphs are skipped like in runs
+void text_measure(const char *text, font_render_t *render, text_metrics_t *metrics);
+// Queues glyphs of text to prefetch worker, so strips drawing it later find
+// them in cache
+esp_err_t text_prefetch(const char *text, const font_render_t *render);